@@ -19,38 +19,115 @@
 #ifndef MAIDSAFE_COMMON_ASIO_SERVICE_H_
 #define MAIDSAFE_COMMON_ASIO_SERVICE_H_
 
+#if defined(MAIDSAFE_LINUX) && !defined(MAIDSAFE_BSD)
+#include <sched.h>
+#endif
+
+#include <algorithm>
 #include <atomic>
 #include <cassert>
+#include <chrono>
 #include <cstdint>
 #include <memory>
 #include <mutex>
 #include <thread>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
 #include "asio/io_service.hpp"
 #include "boost/asio/io_service.hpp"
 
 #include "maidsafe/common/error.h"
+#include "maidsafe/common/handler_instrumentation.h"
 #include "maidsafe/common/make_unique.h"
 #include "maidsafe/common/log.h"
 
 namespace maidsafe {
 
+enum class IoServiceMode {
+  // All threads run a single shared io_service.
+  kShared,
+  // Each thread runs its own io_service, so handlers never migrate between threads and the threads
+  // don't contend on a single io_service's internal lock.
+  kServicePerThread
+};
+
+namespace detail {
+
+// Pins the calling thread to the given CPU.  Returns false if this isn't supported or fails.
+inline bool PinThisThreadToCpu(unsigned cpu) {
+#if defined(MAIDSAFE_LINUX) && !defined(MAIDSAFE_BSD)
+  cpu_set_t cpu_set;
+  CPU_ZERO(&cpu_set);
+  CPU_SET(cpu, &cpu_set);
+  return sched_setaffinity(0, sizeof(cpu_set), &cpu_set) == 0;
+#else
+  static_cast<void>(cpu);
+  return false;
+#endif
+}
+
+}  // namespace detail
+
 template <typename IoServiceType>
 class IoService {
  public:
   explicit IoService(size_t thread_count);
+  // In 'kServicePerThread' mode, 'thread_count' io_services are created, each run by one thread.
+  // If 'pin_threads' is true, thread 'i' is pinned to CPU 'i % hardware_concurrency' where the
+  // platform supports it.
+  IoService(size_t thread_count, IoServiceMode mode, bool pin_threads = false);
   ~IoService() { Stop(); }
   void Stop();
-  IoServiceType& service() { return service_; }
+  // Returns the shared io_service, or in 'kServicePerThread' mode, the first one.
+  IoServiceType& service() { return *services_.front(); }
+  IoServiceType& service(size_t index) { return *services_[index % services_.size()]; }
+  // Picks an io_service for a new connection, strand, timer, etc. either round-robin or by hash
+  // (e.g. of a peer's ID), so that related objects always share an io_service.
+  IoServiceType& NextService() { return service(next_service_++); }
+  IoServiceType& ServiceFor(size_t hash) { return service(hash); }
+  size_t ServiceCount() const { return services_.size(); }
   size_t ThreadCount() const { return thread_count_; }
+  IoServiceMode Mode() const { return mode_; }
+
+  // Posts 'handler' to the next io_service.  If instrumentation is enabled, the handler's queue
+  // wait and execution times are recorded under 'name' (which must outlive the handler).  Only
+  // handlers posted here or via 'Spawn' are instrumented.
+  template <typename Handler>
+  void Post(Handler&& handler, const char* name = nullptr);
+  // Starts a stackless coroutine: a copyable function object derived from 'asio::coroutine' (see
+  // "asio/yield.hpp") which is first invoked with no arguments on the next io_service.  It resumes
+  // by passing a copy of itself as the handler of an asynchronous operation, e.g.
+  // 'yield connection->Receive(*this);', so each coroutine costs no more than a callback chain.
+  template <typename Coroutine>
+  void Spawn(Coroutine coroutine, const char* name = "coroutine") {
+    Post(std::move(coroutine), name);
+  }
+  // Instrumentation is disabled by default, in which case 'Post' costs only one extra atomic load.
+  // Enabling it resets all statistics.  Handlers executing for at least 'slow_handler_threshold'
+  // are logged; a zero threshold disables this.
+  void EnableInstrumentation(
+      std::chrono::nanoseconds slow_handler_threshold = std::chrono::milliseconds(10));
+  void DisableInstrumentation() { instrumentation_ = nullptr; }
+  bool InstrumentationEnabled() const { return instrumentation_ != nullptr; }
+  HandlerStatistics InstrumentationStatistics() const {
+    return handler_instrumentation_->Statistics();
+  }
 
  private:
-  std::atomic<size_t> thread_count_;
-  IoServiceType service_;
-  std::unique_ptr<typename IoServiceType::work> work_;
+  void Run(IoServiceType& io_service);
+
+  std::atomic<size_t> thread_count_, next_service_;
+  const IoServiceMode mode_;
+  std::vector<std::unique_ptr<IoServiceType>> services_;
+  std::vector<std::unique_ptr<typename IoServiceType::work>> works_;
   std::vector<std::thread> threads_;
   mutable std::mutex mutex_;
+  // Never destroyed before the IoService, so that handlers queued while instrumentation was
+  // enabled can always report back.
+  std::unique_ptr<HandlerInstrumentation> handler_instrumentation_;
+  std::atomic<HandlerInstrumentation*> instrumentation_;
 };
 
 using AsioService = IoService<asio::io_service>;
@@ -60,39 +137,86 @@ using BoostAsioService = IoService<boost::asio::io_service>;
 
 template <typename IoServiceType>
 IoService<IoServiceType>::IoService(size_t thread_count)
+    : IoService(thread_count, IoServiceMode::kShared) {}
+
+template <typename IoServiceType>
+IoService<IoServiceType>::IoService(size_t thread_count, IoServiceMode mode, bool pin_threads)
     : thread_count_(thread_count),
-      service_(),
-      work_(make_unique<typename IoServiceType::work>(service_)),
+      next_service_(0),
+      mode_(mode),
+      services_(),
+      works_(),
       threads_(),
-      mutex_() {
+      mutex_(),
+      handler_instrumentation_(),
+      instrumentation_(nullptr) {
   if (thread_count == 0)
     BOOST_THROW_EXCEPTION(MakeError(CommonErrors::invalid_argument));
-  for (size_t i(0); i != thread_count; ++i)
-    threads_.emplace_back([&] {
-      try {
-        service_.run();
-      } catch (...) {
-        LOG(kError) << boost::current_exception_diagnostic_information();
-        // Rethrowing here will cause the application to terminate - so flush the log message first.
-        log::Logging::Instance().Flush();
-        assert(0);
-        throw;
-      }
+  const size_t service_count(mode == IoServiceMode::kShared ? 1 : thread_count);
+  for (size_t i(0); i != service_count; ++i) {
+    services_.emplace_back(make_unique<IoServiceType>());
+    works_.emplace_back(make_unique<typename IoServiceType::work>(*services_.back()));
+  }
+  const unsigned cpu_count(std::max(1U, std::thread::hardware_concurrency()));
+  for (size_t i(0); i != thread_count; ++i) {
+    IoServiceType& io_service(service(i));
+    threads_.emplace_back([this, &io_service, i, pin_threads, cpu_count] {
+      if (pin_threads && !detail::PinThisThreadToCpu(static_cast<unsigned>(i % cpu_count)))
+        LOG(kWarning) << "Failed to pin asio thread " << i << " to a CPU.";
+      Run(io_service);
     });
+  }
+  std::vector<std::thread::id> thread_ids;
+  for (const auto& asio_thread : threads_)
+    thread_ids.push_back(asio_thread.get_id());
+  handler_instrumentation_ = make_unique<HandlerInstrumentation>(thread_ids);
+}
+
+template <typename IoServiceType>
+template <typename Handler>
+void IoService<IoServiceType>::Post(Handler&& handler, const char* name) {
+  typedef typename std::decay<Handler>::type HandlerType;
+  HandlerInstrumentation* const instrumentation(instrumentation_.load(std::memory_order_acquire));
+  if (instrumentation) {
+    NextService().post(
+        InstrumentedHandler<HandlerType>(std::forward<Handler>(handler), *instrumentation, name));
+  } else {
+    NextService().post(std::forward<Handler>(handler));
+  }
+}
+
+template <typename IoServiceType>
+void IoService<IoServiceType>::EnableInstrumentation(
+    std::chrono::nanoseconds slow_handler_threshold) {
+  handler_instrumentation_->Reset(slow_handler_threshold);
+  instrumentation_ = handler_instrumentation_.get();
+}
+
+template <typename IoServiceType>
+void IoService<IoServiceType>::Run(IoServiceType& io_service) {
+  try {
+    io_service.run();
+  } catch (...) {
+    LOG(kError) << boost::current_exception_diagnostic_information();
+    // Rethrowing here will cause the application to terminate - so flush the log message first.
+    log::Logging::Instance().Flush();
+    assert(0);
+    throw;
+  }
 }
 
 template <typename IoServiceType>
 void IoService<IoServiceType>::Stop() {
   thread_count_ = 0U;
   std::lock_guard<std::mutex> lock{mutex_};
-  if (!work_)
+  if (works_.empty())
     return;
   for (const auto& asio_thread : threads_) {
     if (std::this_thread::get_id() == asio_thread.get_id())
       BOOST_THROW_EXCEPTION(MakeError(CommonErrors::cannot_invoke_from_this_thread));
   }
 
-  work_.reset();
+  works_.clear();
 
   for (auto& asio_thread : threads_) {
     try {
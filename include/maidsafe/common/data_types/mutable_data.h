@@ -29,6 +29,7 @@
 // We must include all archives which this polymorphic type will be used with *before* the
 // CEREAL_REGISTER_TYPE call below.
 #include "maidsafe/common/serialisation/binary_archive.h"
+#include "maidsafe/common/serialisation/compact_archive.h"
 
 namespace maidsafe {
 
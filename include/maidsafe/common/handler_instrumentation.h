@@ -0,0 +1,185 @@
+/*  Copyright 2015 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#ifndef MAIDSAFE_COMMON_HANDLER_INSTRUMENTATION_H_
+#define MAIDSAFE_COMMON_HANDLER_INSTRUMENTATION_H_
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <thread>
+#include <vector>
+
+namespace maidsafe {
+
+// Lock-free histogram of durations, with one bucket per power of two nanoseconds.
+class DurationHistogram {
+ public:
+  static const std::size_t kBucketCount = 40;  // The last bucket holds everything >= ~9 minutes.
+
+  struct Snapshot {
+    Snapshot();
+    // Returns an upper bound for the given percentile (in the range [0, 100]), accurate to within
+    // a factor of two.
+    std::chrono::nanoseconds Percentile(double percentile) const;
+    std::chrono::nanoseconds Mean() const;
+
+    std::array<std::uint64_t, kBucketCount> buckets;
+    std::uint64_t count;
+    std::chrono::nanoseconds total, max;
+  };
+
+  DurationHistogram();
+  void Add(std::chrono::nanoseconds duration);
+  void Reset();
+  Snapshot GetSnapshot() const;
+
+ private:
+  std::array<std::atomic<std::uint64_t>, kBucketCount> buckets_;
+  std::atomic<std::uint64_t> count_, total_nanoseconds_, max_nanoseconds_;
+};
+
+struct SlowHandler {
+  const char* name;
+  std::thread::id thread_id;
+  std::chrono::system_clock::time_point finished;
+  std::chrono::nanoseconds queue_wait, execution;
+};
+
+struct ThreadUtilisation {
+  double BusyRatio() const;
+
+  std::thread::id thread_id;
+  std::chrono::nanoseconds busy, elapsed;
+};
+
+struct HandlerStatistics {
+  DurationHistogram::Snapshot queue_wait, execution;
+  std::uint64_t queue_depth, max_queue_depth;
+  std::vector<SlowHandler> slow_handlers;  // Oldest first.
+  std::vector<ThreadUtilisation> threads;
+};
+
+std::ostream& operator<<(std::ostream& ostream, const HandlerStatistics& statistics);
+
+// Collects queue wait and execution times for handlers posted to an io_service.  Handlers which
+// take longer than 'slow_handler_threshold' to execute are logged and kept in a bounded list.
+// Busy time is accumulated per thread, so the ratios only account for instrumented handlers (i.e.
+// not for asio's internal completion handlers).  If built with USE_PROFILING, execution times are
+// also passed to the profiler.
+//
+// Only handlers wrapped in an InstrumentedHandler are measured, i.e. those passed to
+// IoService::Post or Spawn.  Handlers posted via a strand or directly to 'service()', and the
+// completion handlers of asynchronous operations, are invisible to it.
+class HandlerInstrumentation {
+ public:
+  typedef std::chrono::steady_clock::time_point TimePoint;
+  static const std::size_t kSlowHandlerLogCapacity = 100;
+
+  explicit HandlerInstrumentation(const std::vector<std::thread::id>& thread_ids);
+  HandlerInstrumentation(const HandlerInstrumentation&) = delete;
+  HandlerInstrumentation(HandlerInstrumentation&&) = delete;
+  HandlerInstrumentation& operator=(HandlerInstrumentation) = delete;
+
+  // Clears all statistics.
+  void Reset(std::chrono::nanoseconds slow_handler_threshold);
+
+  void HandlerQueued();
+  void HandlerCompleted(const char* name, TimePoint queued, TimePoint started, TimePoint finished);
+  // For a queued handler which is destroyed without being invoked, e.g. when its io_service stops.
+  void HandlerDropped();
+
+  HandlerStatistics Statistics() const;
+
+ private:
+  struct ThreadSlot {
+    ThreadSlot() : thread_id(), busy_nanoseconds(0) {}
+    std::thread::id thread_id;
+    std::atomic<std::uint64_t> busy_nanoseconds;
+  };
+
+  DurationHistogram queue_wait_, execution_;
+  std::atomic<std::uint64_t> queue_depth_, max_queue_depth_;
+  std::atomic<std::chrono::nanoseconds::rep> slow_handler_threshold_;
+  std::vector<ThreadSlot> threads_;
+  std::atomic<TimePoint::rep> reset_time_;
+  mutable std::mutex slow_handlers_mutex_;
+  std::deque<SlowHandler> slow_handlers_;
+};
+
+// Wraps a handler so that it reports its queue wait and execution times on completion, or that it
+// was dropped if destroyed without being invoked.  asio may copy a handler before invoking the
+// copy, so all copies share the report: whichever is invoked first reports completion, and if none
+// is, the last to be destroyed reports the drop.  Any copy remains safe to invoke.
+template <typename Handler>
+class InstrumentedHandler {
+ public:
+  InstrumentedHandler(Handler handler, HandlerInstrumentation& instrumentation, const char* name)
+      : handler_(std::move(handler)), report_(std::make_shared<Report>(instrumentation, name)) {}
+
+  void operator()() {
+    if (!report_ || report_->invoked.exchange(true))
+      return handler_();
+    const HandlerInstrumentation::TimePoint started(std::chrono::steady_clock::now());
+    try {
+      handler_();
+    } catch (...) {
+      report_->Completed(started);
+      throw;
+    }
+    report_->Completed(started);
+  }
+
+ private:
+  struct Report {
+    Report(HandlerInstrumentation& instrumentation_in, const char* name_in)
+        : instrumentation(instrumentation_in),
+          name(name_in),
+          queued(std::chrono::steady_clock::now()),
+          invoked(false) {
+      instrumentation.HandlerQueued();
+    }
+    Report(const Report&) = delete;
+    Report(Report&&) = delete;
+    Report& operator=(Report) = delete;
+    ~Report() {
+      if (!invoked)
+        instrumentation.HandlerDropped();
+    }
+    void Completed(HandlerInstrumentation::TimePoint started) {
+      instrumentation.HandlerCompleted(name, queued, started, std::chrono::steady_clock::now());
+    }
+
+    HandlerInstrumentation& instrumentation;
+    const char* const name;
+    const HandlerInstrumentation::TimePoint queued;
+    std::atomic<bool> invoked;
+  };
+
+  Handler handler_;
+  std::shared_ptr<Report> report_;
+};
+
+}  // namespace maidsafe
+
+#endif  // MAIDSAFE_COMMON_HANDLER_INSTRUMENTATION_H_
@@ -33,6 +33,8 @@ class SipHash : public detail::HashAlgorithmBase<SipHash> {
   static const std::size_t kKeySize = 16;
 
  public:
+  static const std::size_t kLanes = 4;
+
   explicit SipHash(const std::array<byte, kKeySize>& seed) MAIDSAFE_NOEXCEPT;
 
   void Update(const byte* in, std::uint64_t inlen) MAIDSAFE_NOEXCEPT;
@@ -41,15 +43,24 @@ class SipHash : public detail::HashAlgorithmBase<SipHash> {
      added and then properly finalized later. */
   std::uint64_t Finalize() const MAIDSAFE_NOEXCEPT;
 
- private:
-  unsigned Compress(const byte* in, std::uint64_t inlen) MAIDSAFE_NOEXCEPT;
+  /* Hashes kLanes independent inputs using the same seed.  Each result is
+     identical to that of a SipHash given the seed and a single Update with the
+     corresponding input.  Where the CPU supports AVX2 the inputs are compressed
+     in parallel, up to the length of the shortest. */
+  static void Hash(const std::array<byte, kKeySize>& seed,
+                   const std::array<const byte*, kLanes>& in,
+                   const std::array<std::uint64_t, kLanes>& inlen,
+                   std::array<std::uint64_t, kLanes>& out) MAIDSAFE_NOEXCEPT;
 
+ private:
   std::uint64_t v0;
   std::uint64_t v1;
   std::uint64_t v2;
   std::uint64_t v3;
   unsigned remainder_length_;
-  std::array<byte, 8> remainder_;
+  // The trailing bytes which don't yet make up a whole word, as the low bytes of a little-endian
+  // word.
+  std::uint64_t remainder_;
   std::uint8_t b;
 };
 
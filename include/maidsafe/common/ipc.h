@@ -19,12 +19,16 @@
 #ifndef MAIDSAFE_COMMON_IPC_H_
 #define MAIDSAFE_COMMON_IPC_H_
 
+#include <cstdint>
 #include <string>
 #include <vector>
 #include <memory>
 
 #include "boost/interprocess/managed_shared_memory.hpp"
 #include "boost/interprocess/containers/string.hpp"
+#include "boost/interprocess/containers/vector.hpp"
+#include "boost/interprocess/offset_ptr.hpp"
+#include "boost/utility/string_ref.hpp"
 
 namespace maidsafe {
 
@@ -51,6 +55,48 @@ void RemoveSharedMemory(std::string name);
 void CreateSharedMemory(std::string name, std::vector<std::string> items);
 std::vector<std::string> ReadSharedMemory(std::string name, int number);
 
+// Unlike the functions above, these store the items as raw bytes (no hex encoding) in a segment
+// sized to fit them, so there's no limit on their total size beyond available memory.
+// 'RemoveSharedMemory' removes these segments too.
+
+// Creates the segment 'name', replacing any existing one, holding a copy of 'items'.
+void WriteSharedMemory(const std::string& name, const std::vector<std::string>& items);
+// Adds 'items' after those already in the segment 'name', growing it as required.  Throws if
+// there's no such segment.  Growing a segment remaps it, so no other process may have it open.
+void AppendSharedMemory(const std::string& name, const std::vector<std::string>& items);
+
+namespace detail {
+
+struct SharedItem {
+  bi::offset_ptr<const char> data;
+  std::uint64_t size;
+};
+typedef bi::allocator<SharedItem, bi::managed_shared_memory::segment_manager> SharedItemAllocator;
+typedef bi::vector<SharedItem, SharedItemAllocator> SharedItems;
+
+}  // namespace detail
+
+// Maps the segment 'name' written by 'WriteSharedMemory' and gives access to its items without
+// copying them.  The returned string_refs point into the shared memory, so they're only valid for
+// the lifetime of this reader.  Throws boost::interprocess::interprocess_exception if there's no
+// such segment.
+class SharedMemoryReader {
+ public:
+  explicit SharedMemoryReader(const std::string& name);
+  SharedMemoryReader(const SharedMemoryReader&) = delete;
+  SharedMemoryReader(SharedMemoryReader&&) = delete;
+  SharedMemoryReader& operator=(SharedMemoryReader) = delete;
+
+  std::size_t Size() const { return items_->size(); }
+  // Throws if 'index' isn't less than 'Size()'.
+  boost::string_ref operator[](std::size_t index) const;
+  std::vector<boost::string_ref> Items() const;
+
+ private:
+  bi::managed_shared_memory segment_;
+  const detail::SharedItems* items_;
+};
+
 
 
 }  // namespace ipc
@@ -0,0 +1,108 @@
+/*  Copyright 2015 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#ifndef MAIDSAFE_COMMON_IPC_CHANNEL_H_
+#define MAIDSAFE_COMMON_IPC_CHANNEL_H_
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "boost/interprocess/managed_shared_memory.hpp"
+
+#include "maidsafe/common/types.h"
+
+namespace maidsafe {
+
+namespace ipc {
+
+namespace detail {
+
+struct ChannelControl;
+
+}  // namespace detail
+
+// A one-way stream of messages between two processes on this host, held in a named shared memory
+// segment.  The messages are raw bytes in a lock-free single-producer, single-consumer ring buffer,
+// so sending or receiving is a copy into or out of the ring with no locking.  A blocked sender or
+// receiver sleeps on a futex (or polls where futexes aren't available), and the other end only
+// makes a system call to wake it if it's actually waiting.
+//
+// Exactly one thread in total may send and one may receive; each end may be in either process.
+// The creator owns the segment and removes it on destruction.
+class Channel {
+ public:
+  // Creates the channel 'name', replacing any existing one, with a ring of at least 'capacity'
+  // bytes (rounded up to a power of two).  Throws unless 'capacity' is between 64 bytes and 1 GiB.
+  Channel(const std::string& name, std::size_t capacity);
+  // Opens the existing channel 'name'.  Throws boost::interprocess::interprocess_exception if
+  // there's no such channel.
+  explicit Channel(const std::string& name);
+  Channel(const Channel&) = delete;
+  Channel(Channel&&) = delete;
+  Channel& operator=(Channel) = delete;
+  ~Channel();
+
+  static void Remove(const std::string& name);
+
+  // Each message occupies a 4 byte size prefix plus its data in the ring.  Throws if 'size'
+  // exceeds 'MaxMessageSize()'.  All return false if the channel is closed.  Otherwise 'TrySend'
+  // returns false if there isn't room for the message right now, while 'Send' waits for room,
+  // returning false only if 'timeout' expires first.
+  bool TrySend(const byte* data, std::size_t size);
+  bool Send(const byte* data, std::size_t size);
+  bool Send(const byte* data, std::size_t size, std::chrono::steady_clock::duration timeout);
+
+  // 'message' is resized to fit, so a reused vector doesn't allocate.  'TryReceive' returns false
+  // if there's no message right now.  'Receive' waits for one, returning false if 'timeout' expires
+  // first, or once the channel has been closed and every message sent before then received.
+  bool TryReceive(std::vector<byte>& message);
+  bool Receive(std::vector<byte>& message);
+  bool Receive(std::vector<byte>& message, std::chrono::steady_clock::duration timeout);
+
+  // Either end may close the channel, waking any blocked sender or receiver.
+  void Close();
+  bool Closed() const;
+
+  std::size_t Capacity() const { return capacity_; }
+  std::size_t MaxMessageSize() const { return capacity_ - sizeof(std::uint32_t); }
+
+ private:
+  bool SendUntil(const byte* data, std::size_t size,
+                 std::chrono::steady_clock::time_point deadline);
+  bool ReceiveUntil(std::vector<byte>& message, std::chrono::steady_clock::time_point deadline);
+  void CopyIn(std::uint64_t position, const byte* data, std::size_t size);
+  void CopyOut(std::uint64_t position, byte* data, std::size_t size) const;
+
+  const std::string kName_;
+  const bool kOwner_;
+  boost::interprocess::managed_shared_memory segment_;
+  detail::ChannelControl* control_;
+  byte* ring_;
+  std::size_t capacity_;
+  // Each end's last view of the other end's position, so it only needs to read the shared one
+  // (and so take the cache miss) when this one suggests the ring is full or empty.
+  std::uint64_t cached_read_position_, cached_write_position_;
+};
+
+}  // namespace ipc
+
+}  // namespace maidsafe
+
+#endif  // MAIDSAFE_COMMON_IPC_CHANNEL_H_
@@ -0,0 +1,114 @@
+/*  Copyright 2015 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#ifndef MAIDSAFE_COMMON_IPC_SHARED_CACHE_H_
+#define MAIDSAFE_COMMON_IPC_SHARED_CACHE_H_
+
+#include <cstdint>
+#include <functional>
+#include <string>
+
+#include "boost/interprocess/managed_shared_memory.hpp"
+#include "boost/utility/string_ref.hpp"
+
+#include "maidsafe/common/types.h"
+#include "maidsafe/common/data_types/data.h"
+
+namespace maidsafe {
+
+namespace ipc {
+
+namespace detail {
+
+struct CacheHeader;
+struct CacheSlot;
+
+}  // namespace detail
+
+// A cache of immutable values shared by every process on this host which opens it by name, so
+// that popular chunks are held once rather than once per process.  It lives in a named shared
+// memory segment which outlasts the processes using it until 'Remove' is called.
+//
+// Values are stored contiguously in a circular arena of 'capacity' bytes, so that readers can use
+// them in place.  When the arena or the index is full, the oldest values are evicted first.  The
+// index is an open-addressing hash table in which each slot is guarded by a seqlock, so readers
+// never block or write to shared memory, and a reader process crashing can't affect anyone else.
+// Writers (from any process) are serialised by a lock recording the holder's process ID.  If the
+// holder dies, the next writer takes the lock over and clears the cache, since the crash may have
+// left it half-modified.  A holder which hasn't yet been reaped by its parent, or whose process ID
+// has been reused, still looks alive, so until then other writers wait.
+class SharedCache {
+ public:
+  using KeyType = Data::NameAndTypeId;
+
+  // Opens the cache 'name', creating it with an arena of 'capacity' bytes if it doesn't exist yet.
+  // An existing cache keeps the capacity it was created with.  The index has room for one value
+  // per 4 KiB of capacity (and at least 64 values).  Throws if 'capacity' is below 4 KiB or above
+  // 64 GiB.
+  SharedCache(const std::string& name, std::uint64_t capacity);
+  SharedCache(const SharedCache&) = delete;
+  SharedCache(SharedCache&&) = delete;
+  SharedCache& operator=(SharedCache) = delete;
+
+  static void Remove(const std::string& name);
+
+  // Does nothing if 'key' is already present.  Evicts the oldest values to make room.  Throws if
+  // 'value' is larger than 'MaxValueSize()' or if 'key.name' is uninitialised.
+  void Store(const KeyType& key, boost::string_ref value);
+
+  // Calls 'reader' with a view of the value held under 'key' in shared memory, without copying it.
+  // Returns false without calling 'reader' if there's no such value.  The value may be evicted
+  // and overwritten by another process while 'reader' is using it, in which case this returns
+  // false and anything 'reader' derived from the view must be discarded.  'reader' mustn't keep
+  // the view once it returns.
+  bool Get(const KeyType& key, const std::function<void(boost::string_ref)>& reader) const;
+  // As above, but copies the value into 'value'.
+  bool Get(const KeyType& key, std::string& value) const;
+
+  void Delete(const KeyType& key);
+
+  std::uint64_t Capacity() const;
+  std::uint64_t MaxValueSize() const;
+  // The number of values held and the arena bytes they (and their headers) take up.
+  std::uint64_t Size() const;
+  std::uint64_t UsedBytes() const;
+
+ private:
+  class WriterLock;
+
+  std::uint64_t Home(const byte* name, std::uint32_t type_id) const;
+  // Returns the index of the slot holding 'key', or 'kNotFound'.  Must hold the writer lock.
+  std::uint64_t Find(const KeyType& key) const;
+  void MakeSpace(std::uint64_t required);
+  void EvictOldest();
+  // Removes the value in slot 'index' from the index, leaving its block to be evicted.
+  void RemoveSlot(std::uint64_t index);
+  void SetBlockSlot(std::uint64_t position, std::uint64_t slot);
+  void Clear();
+
+  boost::interprocess::managed_shared_memory segment_;
+  detail::CacheHeader* header_;
+  detail::CacheSlot* slots_;
+  byte* arena_;
+};
+
+}  // namespace ipc
+
+}  // namespace maidsafe
+
+#endif  // MAIDSAFE_COMMON_IPC_SHARED_CACHE_H_
@@ -19,6 +19,9 @@
 #ifndef MAIDSAFE_COMMON_SERIALISATION_BINARY_ARCHIVE_H_
 #define MAIDSAFE_COMMON_SERIALISATION_BINARY_ARCHIVE_H_
 
+#include <cstdint>
+#include <cstring>
+#include <string>
 #include <vector>
 
 #include "cereal/cereal.hpp"
@@ -37,38 +40,182 @@ using InputVectorStream = boost::interprocess::basic_ivectorstream<SerialisedDat
 
 class BinaryOutputArchive : public cereal::OutputArchive<BinaryOutputArchive> {
  public:
+  // Tag for constructing an archive which writes nothing, but only counts the bytes which would
+  // have been written.  See SerialisedSize() in serialisation.h.
+  struct SizeOnly {};
+
   explicit BinaryOutputArchive(OutputVectorStream& stream)
-      : OutputArchive<BinaryOutputArchive>(this), itsStream(stream) {}
+      : OutputArchive<BinaryOutputArchive>(this),
+        itsSink(Sink::kStream),
+        itsStream(&stream),
+        itsBuffer(nullptr),
+        itsString(nullptr),
+        itsPosition(nullptr),
+        itsEnd(nullptr),
+        itsBytesWritten(0) {}
+
+  // Appends to the caller-owned 'buffer', which grows as needed.
+  explicit BinaryOutputArchive(SerialisedData& buffer)
+      : OutputArchive<BinaryOutputArchive>(this),
+        itsSink(Sink::kVector),
+        itsStream(nullptr),
+        itsBuffer(&buffer),
+        itsString(nullptr),
+        itsPosition(nullptr),
+        itsEnd(nullptr),
+        itsBytesWritten(0) {}
+
+  // Appends to the caller-owned 'buffer', which grows as needed.  See ConvertToString() in
+  // serialisation.h.
+  explicit BinaryOutputArchive(std::string& buffer)
+      : OutputArchive<BinaryOutputArchive>(this),
+        itsSink(Sink::kString),
+        itsStream(nullptr),
+        itsBuffer(nullptr),
+        itsString(&buffer),
+        itsPosition(nullptr),
+        itsEnd(nullptr),
+        itsBytesWritten(0) {}
+
+  // Writes into the caller-owned region [begin, end).  Throws if the region is too small.
+  BinaryOutputArchive(byte* begin, byte* end)
+      : OutputArchive<BinaryOutputArchive>(this),
+        itsSink(Sink::kBuffer),
+        itsStream(nullptr),
+        itsBuffer(nullptr),
+        itsString(nullptr),
+        itsPosition(begin),
+        itsEnd(end),
+        itsBytesWritten(0) {}
+
+  explicit BinaryOutputArchive(SizeOnly)
+      : OutputArchive<BinaryOutputArchive>(this),
+        itsSink(Sink::kSizeOnly),
+        itsStream(nullptr),
+        itsBuffer(nullptr),
+        itsString(nullptr),
+        itsPosition(nullptr),
+        itsEnd(nullptr),
+        itsBytesWritten(0) {}
 
   void saveBinary(const void* data, std::size_t size) {
-    auto const writtenSize = static_cast<std::size_t>(
-        itsStream.rdbuf()->sputn(reinterpret_cast<const unsigned char*>(data), size));
+    switch (itsSink) {
+      case Sink::kStream: {
+        auto const writtenSize = static_cast<std::size_t>(
+            itsStream->rdbuf()->sputn(reinterpret_cast<const unsigned char*>(data), size));
 
-    if (writtenSize != size)
-      throw cereal::Exception("Failed to write " + std::to_string(size) +
-                              " bytes to output stream! Wrote " + std::to_string(writtenSize));
+        if (writtenSize != size)
+          throw cereal::Exception("Failed to write " + std::to_string(size) +
+                                  " bytes to output stream! Wrote " + std::to_string(writtenSize));
+        break;
+      }
+      case Sink::kVector: {
+        auto const bytes = static_cast<const byte*>(data);
+        itsBuffer->insert(itsBuffer->end(), bytes, bytes + size);
+        break;
+      }
+      case Sink::kString:
+        itsString->append(static_cast<const char*>(data), size);
+        break;
+      case Sink::kBuffer: {
+        auto const remaining = static_cast<std::size_t>(itsEnd - itsPosition);
+        if (size > remaining)
+          throw cereal::Exception("Failed to write " + std::to_string(size) +
+                                  " bytes to output buffer! Space for " +
+                                  std::to_string(remaining));
+        if (size != 0) {
+          std::memcpy(itsPosition, data, size);
+          itsPosition += size;
+        }
+        break;
+      }
+      case Sink::kSizeOnly:
+        break;
+    }
+    itsBytesWritten += size;
   }
 
+  std::size_t bytesWritten() const { return itsBytesWritten; }
+
  private:
-  OutputVectorStream& itsStream;
+  enum class Sink : char { kStream, kVector, kString, kBuffer, kSizeOnly };
+
+  const Sink itsSink;
+  OutputVectorStream* const itsStream;
+  SerialisedData* const itsBuffer;
+  std::string* const itsString;
+  byte* itsPosition;
+  byte* const itsEnd;
+  std::size_t itsBytesWritten;
 };
 
 class BinaryInputArchive : public cereal::InputArchive<BinaryInputArchive> {
  public:
   explicit BinaryInputArchive(InputVectorStream& stream)
-      : cereal::InputArchive<BinaryInputArchive>(this), itsStream(stream) {}
+      : cereal::InputArchive<BinaryInputArchive>(this),
+        itsStream(&stream),
+        itsPosition(nullptr),
+        itsEnd(nullptr) {}
+
+  // Reads in place from the caller-owned region [data, data + size), which must outlive the
+  // archive.  Throws if asked to read beyond the end of the region.
+  BinaryInputArchive(const byte* data, std::size_t size)
+      : cereal::InputArchive<BinaryInputArchive>(this),
+        itsStream(nullptr),
+        itsPosition(data),
+        itsEnd(data + size) {}
 
   void loadBinary(void* const data, std::size_t size) {
-    auto const readSize = static_cast<std::size_t>(
-        itsStream.rdbuf()->sgetn(reinterpret_cast<unsigned char*>(data), size));
+    if (itsStream) {
+      auto const readSize = static_cast<std::size_t>(
+          itsStream->rdbuf()->sgetn(reinterpret_cast<unsigned char*>(data), size));
 
-    if (readSize != size)
+      if (readSize != size)
+        throw cereal::Exception("Failed to read " + std::to_string(size) +
+                                " bytes from input stream! Read " + std::to_string(readSize));
+      return;
+    }
+
+    auto const remaining = static_cast<std::size_t>(itsEnd - itsPosition);
+    if (size > remaining)
       throw cereal::Exception("Failed to read " + std::to_string(size) +
-                              " bytes from input stream! Read " + std::to_string(readSize));
+                              " bytes from input buffer! Only " + std::to_string(remaining) +
+                              " remaining");
+    if (size != 0) {
+      std::memcpy(data, itsPosition, size);
+      itsPosition += size;
+    }
+  }
+
+  // Replaces the contents of 'container' (a std::vector or std::basic_string of an arithmetic type)
+  // with 'count' elements read in one go.  When reading from a region, 'count' is checked against
+  // the bytes remaining before anything is allocated, and single-byte elements are copied straight
+  // in rather than into a zero-filled container.
+  template <typename Container>
+  void loadContiguous(Container& container, std::uint64_t count) {
+    using Value = typename Container::value_type;
+    if (!itsStream) {
+      auto const remaining = static_cast<std::size_t>(itsEnd - itsPosition);
+      if (count > remaining / sizeof(Value))
+        throw cereal::Exception("Failed to read " + std::to_string(count) + " elements of " +
+                                std::to_string(sizeof(Value)) + " bytes from input buffer! Only " +
+                                std::to_string(remaining) + " bytes remaining");
+      if (sizeof(Value) == 1) {
+        auto const begin = reinterpret_cast<const Value*>(itsPosition);
+        container.assign(begin, begin + count);
+        itsPosition += count;
+        return;
+      }
+    }
+    container.resize(static_cast<std::size_t>(count));
+    if (count != 0)
+      loadBinary(&container[0], static_cast<std::size_t>(count) * sizeof(Value));
   }
 
  private:
-  InputVectorStream& itsStream;
+  InputVectorStream* const itsStream;
+  const byte* itsPosition;
+  const byte* const itsEnd;
 };
 
 
@@ -87,6 +234,44 @@ inline typename std::enable_if<std::is_arithmetic<T>::value, void>::type CEREAL_
   ar.loadBinary(std::addressof(t), sizeof(t));
 }
 
+// Saving for vectors of POD types to binary.  This matches cereal's own output (a size tag then the
+// raw elements), and so also covers BoundedString and Identity, which serialise their underlying
+// std::vector<byte>.
+template <class T, class A>
+inline typename std::enable_if<std::is_arithmetic<T>::value && !std::is_same<T, bool>::value,
+                               void>::type
+    CEREAL_SAVE_FUNCTION_NAME(BinaryOutputArchive& ar, std::vector<T, A> const& vector) {
+  ar(cereal::make_size_tag(static_cast<cereal::size_type>(vector.size())));
+  ar.saveBinary(vector.data(), vector.size() * sizeof(T));
+}
+
+// Loading for vectors of POD types from binary
+template <class T, class A>
+inline typename std::enable_if<std::is_arithmetic<T>::value && !std::is_same<T, bool>::value,
+                               void>::type
+    CEREAL_LOAD_FUNCTION_NAME(BinaryInputArchive& ar, std::vector<T, A>& vector) {
+  cereal::size_type size;
+  ar(cereal::make_size_tag(size));
+  ar.loadContiguous(vector, size);
+}
+
+// Saving for strings to binary
+template <class CharT, class Traits, class Alloc>
+inline void CEREAL_SAVE_FUNCTION_NAME(BinaryOutputArchive& ar,
+                                      std::basic_string<CharT, Traits, Alloc> const& str) {
+  ar(cereal::make_size_tag(static_cast<cereal::size_type>(str.size())));
+  ar.saveBinary(str.data(), str.size() * sizeof(CharT));
+}
+
+// Loading for strings from binary
+template <class CharT, class Traits, class Alloc>
+inline void CEREAL_LOAD_FUNCTION_NAME(BinaryInputArchive& ar,
+                                      std::basic_string<CharT, Traits, Alloc>& str) {
+  cereal::size_type size;
+  ar(cereal::make_size_tag(size));
+  ar.loadContiguous(str, size);
+}
+
 // Serializing NVP types to binary
 template <class Archive, class T>
 inline CEREAL_ARCHIVE_RESTRICT(BinaryInputArchive, BinaryOutputArchive)
@@ -0,0 +1,219 @@
+/*  Copyright 2015 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#ifndef MAIDSAFE_COMMON_SERIALISATION_COMPACT_ARCHIVE_H_
+#define MAIDSAFE_COMMON_SERIALISATION_COMPACT_ARCHIVE_H_
+
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "cereal/cereal.hpp"
+
+#include "maidsafe/common/types.h"
+
+namespace maidsafe {
+
+using SerialisedData = std::vector<byte>;
+
+// A more compact alternative to BinaryOutputArchive and BinaryInputArchive.  Integers wider than a
+// byte and cereal size tags are written as LEB128 varints (signed integers zigzag-encoded first),
+// so small values take a single byte whatever their type.  Everything else (bools, single-byte
+// types, floating point and binary data) is written exactly as BinaryOutputArchive writes it.  As
+// with the binary archives, the output is not endian-safe.
+
+class CompactOutputArchive : public cereal::OutputArchive<CompactOutputArchive> {
+ public:
+  // Appends to 'buffer', which must outlive the archive.
+  explicit CompactOutputArchive(SerialisedData& buffer)
+      : cereal::OutputArchive<CompactOutputArchive>(this), itsBuffer(buffer) {}
+
+  void saveBinary(const void* data, std::size_t size) {
+    auto const bytes = static_cast<const byte*>(data);
+    itsBuffer.insert(itsBuffer.end(), bytes, bytes + size);
+  }
+
+  void saveVarint(std::uint64_t value) {
+    byte encoded[kMaxVarintSize];
+    std::size_t size = 0;
+    while (value >= 0x80) {
+      encoded[size++] = static_cast<byte>(value | 0x80);
+      value >>= 7;
+    }
+    encoded[size++] = static_cast<byte>(value);
+    saveBinary(encoded, size);
+  }
+
+ private:
+  static const std::size_t kMaxVarintSize = 10;
+
+  SerialisedData& itsBuffer;
+};
+
+class CompactInputArchive : public cereal::InputArchive<CompactInputArchive> {
+ public:
+  // Reads in place from the caller-owned region [data, data + size), which must outlive the
+  // archive.  Throws if asked to read beyond the end of the region.
+  CompactInputArchive(const byte* data, std::size_t size)
+      : cereal::InputArchive<CompactInputArchive>(this), itsPosition(data), itsEnd(data + size) {}
+
+  void loadBinary(void* const data, std::size_t size) {
+    auto const remaining = static_cast<std::size_t>(itsEnd - itsPosition);
+    if (size > remaining)
+      throw cereal::Exception("Failed to read " + std::to_string(size) +
+                              " bytes from input buffer! Only " + std::to_string(remaining) +
+                              " remaining");
+    if (size != 0) {
+      std::memcpy(data, itsPosition, size);
+      itsPosition += size;
+    }
+  }
+
+  std::uint64_t loadVarint() {
+    std::uint64_t value = 0;
+    for (unsigned shift = 0; shift < 64; shift += 7) {
+      if (itsPosition == itsEnd)
+        throw cereal::Exception("Failed to read varint from input buffer! Reached end");
+      const byte next = *itsPosition++;
+      value |= static_cast<std::uint64_t>(next & 0x7F) << shift;
+      if ((next & 0x80) == 0) {
+        if (shift == 63 && next > 1)
+          break;
+        return value;
+      }
+    }
+    throw cereal::Exception("Failed to read varint from input buffer! Value exceeds 64 bits");
+  }
+
+ private:
+  const byte* itsPosition;
+  const byte* const itsEnd;
+};
+
+
+
+namespace detail {
+
+template <typename T>
+struct is_varint : std::integral_constant<bool, std::is_integral<T>::value && (sizeof(T) > 1)> {};
+
+template <typename T>
+std::uint64_t ZigZagEncode(T value) {
+  return (static_cast<std::uint64_t>(value) << 1) ^
+         static_cast<std::uint64_t>(static_cast<std::int64_t>(value) >> 63);
+}
+
+inline std::int64_t ZigZagDecode(std::uint64_t value) {
+  return static_cast<std::int64_t>((value >> 1) ^ (~(value & 1) + 1));
+}
+
+}  // namespace detail
+
+// Saving for unsigned integers as varints
+template <class T>
+inline typename std::enable_if<detail::is_varint<T>::value && std::is_unsigned<T>::value,
+                               void>::type
+    CEREAL_SAVE_FUNCTION_NAME(CompactOutputArchive& ar, T const& t) {
+  ar.saveVarint(t);
+}
+
+// Loading for unsigned integers as varints
+template <class T>
+inline typename std::enable_if<detail::is_varint<T>::value && std::is_unsigned<T>::value,
+                               void>::type
+    CEREAL_LOAD_FUNCTION_NAME(CompactInputArchive& ar, T& t) {
+  const std::uint64_t value = ar.loadVarint();
+  if (value > std::numeric_limits<T>::max())
+    throw cereal::Exception("Varint " + std::to_string(value) + " is out of range for " +
+                            std::to_string(sizeof(T)) + "-byte unsigned type");
+  t = static_cast<T>(value);
+}
+
+// Saving for signed integers as zigzag-encoded varints
+template <class T>
+inline typename std::enable_if<detail::is_varint<T>::value && std::is_signed<T>::value, void>::type
+    CEREAL_SAVE_FUNCTION_NAME(CompactOutputArchive& ar, T const& t) {
+  ar.saveVarint(detail::ZigZagEncode(t));
+}
+
+// Loading for signed integers as zigzag-encoded varints
+template <class T>
+inline typename std::enable_if<detail::is_varint<T>::value && std::is_signed<T>::value, void>::type
+    CEREAL_LOAD_FUNCTION_NAME(CompactInputArchive& ar, T& t) {
+  const std::int64_t value = detail::ZigZagDecode(ar.loadVarint());
+  if (value < std::numeric_limits<T>::min() || value > std::numeric_limits<T>::max())
+    throw cereal::Exception("Varint " + std::to_string(value) + " is out of range for " +
+                            std::to_string(sizeof(T)) + "-byte signed type");
+  t = static_cast<T>(value);
+}
+
+// Saving for other POD types (bool, single-byte and floating point types) to binary
+template <class T>
+inline typename std::enable_if<std::is_arithmetic<T>::value && !detail::is_varint<T>::value,
+                               void>::type
+    CEREAL_SAVE_FUNCTION_NAME(CompactOutputArchive& ar, T const& t) {
+  ar.saveBinary(std::addressof(t), sizeof(t));
+}
+
+// Loading for other POD types (bool, single-byte and floating point types) from binary
+template <class T>
+inline typename std::enable_if<std::is_arithmetic<T>::value && !detail::is_varint<T>::value,
+                               void>::type
+    CEREAL_LOAD_FUNCTION_NAME(CompactInputArchive& ar, T& t) {
+  ar.loadBinary(std::addressof(t), sizeof(t));
+}
+
+// Serializing NVP types
+template <class Archive, class T>
+inline CEREAL_ARCHIVE_RESTRICT(CompactInputArchive, CompactOutputArchive)
+    CEREAL_SERIALIZE_FUNCTION_NAME(Archive& ar, cereal::NameValuePair<T>& t) {
+  ar(t.value);
+}
+
+// Serializing SizeTags as varints
+template <class Archive, class T>
+inline CEREAL_ARCHIVE_RESTRICT(CompactInputArchive, CompactOutputArchive)
+    CEREAL_SERIALIZE_FUNCTION_NAME(Archive& ar, cereal::SizeTag<T>& t) {
+  ar(t.size);
+}
+
+// Saving binary data
+template <class T>
+inline void CEREAL_SAVE_FUNCTION_NAME(CompactOutputArchive& ar, cereal::BinaryData<T> const& bd) {
+  ar.saveBinary(bd.data, static_cast<std::size_t>(bd.size));
+}
+
+// Loading binary data
+template <class T>
+inline void CEREAL_LOAD_FUNCTION_NAME(CompactInputArchive& ar, cereal::BinaryData<T>& bd) {
+  ar.loadBinary(bd.data, static_cast<std::size_t>(bd.size));
+}
+
+}  // namespace maidsafe
+
+// Register archives for polymorphic support
+CEREAL_REGISTER_ARCHIVE(maidsafe::CompactOutputArchive)
+CEREAL_REGISTER_ARCHIVE(maidsafe::CompactInputArchive)
+
+// tie input and output archives together
+CEREAL_SETUP_ARCHIVE_TRAITS(maidsafe::CompactInputArchive, maidsafe::CompactOutputArchive)
+
+#endif  // MAIDSAFE_COMMON_SERIALISATION_COMPACT_ARCHIVE_H_
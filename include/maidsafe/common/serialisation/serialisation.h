@@ -19,15 +19,16 @@
 
 /*
  * There two flavours of serialization and de-serialization functions here. One that works on
- * strings and the other that works on streams. This is because the string ones create
- * stringstreams as local variables and stringstreams being locale aware have poor contruction
- * speed. Thus if the client code wants to provide streams himself so that he can cache and reuse
- * the streams, the functions which directly operate on streams can be used.
+ * strings and the other that works on streams. The string ones write straight into the returned
+ * string and parse the source string in place, avoiding std::stringstream, which being locale aware
+ * has poor construction speed. The functions which directly operate on streams remain for client
+ * code which already has a stream to work with.
  */
 
 #ifndef MAIDSAFE_COMMON_SERIALISATION_SERIALISATION_H_
 #define MAIDSAFE_COMMON_SERIALISATION_SERIALISATION_H_
 
+#include <cstddef>
 #include <string>
 #include <vector>
 
@@ -39,6 +40,7 @@
 
 #include "maidsafe/common/types.h"
 #include "maidsafe/common/serialisation/binary_archive.h"
+#include "maidsafe/common/serialisation/compact_archive.h"
 
 namespace maidsafe {
 
@@ -59,10 +61,53 @@ SerialisedData Serialise(OutputVectorStream& binary_output_stream,
                                std::forward<TypesToSerialise>(objects_to_serialise)...).vector();
 }
 
+// Returns the exact number of bytes which Serialise would produce for the given objects.  Nothing
+// is written out, but each object's save function still runs in full, so this only saves the cost
+// of copying the output.  For types whose save does real work (e.g. asymm::Keys, which DER-encodes
+// its keys) it costs nearly as much as serialising.
+template <typename... TypesToSerialise>
+std::size_t SerialisedSize(const TypesToSerialise&... objects_to_serialise) {
+  BinaryOutputArchive size_archive{BinaryOutputArchive::SizeOnly{}};
+  size_archive(objects_to_serialise...);
+  return size_archive.bytesWritten();
+}
+
+namespace detail {
+
+// Serialises into the 'size' bytes at 'data', where 'size' was given by SerialisedSize.
+template <typename... TypesToSerialise>
+void SerialiseInPlace(byte* data, std::size_t size,
+                      const TypesToSerialise&... objects_to_serialise) {
+  BinaryOutputArchive binary_output_archive(data, data + size);
+  binary_output_archive(objects_to_serialise...);
+  if (binary_output_archive.bytesWritten() != size)
+    throw cereal::Exception("Serialised " + std::to_string(binary_output_archive.bytesWritten()) +
+                            " bytes, but expected " + std::to_string(size));
+}
+
+}  // namespace detail
+
+// Serialises into the caller-owned 'buffer', replacing its contents.  The exact size is computed
+// first, so 'buffer' is resized at most once and then written in place.  Reusing the same buffer
+// across calls avoids allocating at all once its capacity is large enough.  Each object's save
+// function runs twice, once for each pass, so for types whose save is expensive 'Serialise' can
+// be the cheaper choice.
+template <typename... TypesToSerialise>
+void SerialiseInto(SerialisedData& buffer, const TypesToSerialise&... objects_to_serialise) {
+  buffer.resize(SerialisedSize(objects_to_serialise...));
+  detail::SerialiseInPlace(buffer.data(), buffer.size(), objects_to_serialise...);
+}
+
+// Serialises in a single pass, appending to a vector which grows as needed, so each object's save
+// function runs only once.
 template <typename... TypesToSerialise>
 SerialisedData Serialise(TypesToSerialise&&... objects_to_serialise) {
-  OutputVectorStream binary_output_stream;
-  return Serialise(binary_output_stream, std::forward<TypesToSerialise>(objects_to_serialise)...);
+  SerialisedData serialised_data;
+  {
+    BinaryOutputArchive binary_output_archive(serialised_data);
+    binary_output_archive(std::forward<TypesToSerialise>(objects_to_serialise)...);
+  }
+  return serialised_data;
 }
 
 template <typename ParsedType>
@@ -75,10 +120,21 @@ ParsedType Parse(InputVectorStream& binary_input_stream) {
   return parsed;
 }
 
+// Parses in place from the 'size' bytes at 'data', e.g. a slice of a larger buffer or a mapped file
+// region, without copying them first.
+template <typename ParsedType>
+ParsedType Parse(const byte* data, std::size_t size) {
+  ParsedType parsed;
+  {
+    BinaryInputArchive binary_input_archive(data, size);
+    binary_input_archive(parsed);
+  }
+  return parsed;
+}
+
 template <typename ParsedType>
 ParsedType Parse(const SerialisedData& serialised_data) {
-  InputVectorStream binary_input_stream{serialised_data};
-  return Parse<ParsedType>(binary_input_stream);
+  return Parse<ParsedType>(serialised_data.data(), serialised_data.size());
 }
 
 template <typename... TypesToParse>
@@ -87,10 +143,56 @@ void Parse(InputVectorStream& binary_input_stream, TypesToParse&... objects_to_p
   binary_input_archive(objects_to_parse...);
 }
 
+template <typename... TypesToParse>
+void Parse(const byte* data, std::size_t size, TypesToParse&... objects_to_parse) {
+  BinaryInputArchive binary_input_archive(data, size);
+  binary_input_archive(objects_to_parse...);
+}
+
 template <typename... TypesToParse>
 void Parse(const SerialisedData& serialised_data, TypesToParse&... objects_to_parse) {
-  InputVectorStream binary_input_stream{serialised_data};
-  Parse(binary_input_stream, objects_to_parse...);
+  Parse(serialised_data.data(), serialised_data.size(), objects_to_parse...);
+}
+
+
+
+// Equivalents of Serialise and Parse using CompactOutputArchive and CompactInputArchive.  The
+// output is usually much smaller for types dominated by small integers and size tags, but is not
+// compatible with that of Serialise.
+template <typename... TypesToSerialise>
+SerialisedData SerialiseCompact(const TypesToSerialise&... objects_to_serialise) {
+  SerialisedData serialised_data;
+  {
+    CompactOutputArchive compact_output_archive(serialised_data);
+    compact_output_archive(objects_to_serialise...);
+  }
+  return serialised_data;
+}
+
+template <typename ParsedType>
+ParsedType ParseCompact(const byte* data, std::size_t size) {
+  ParsedType parsed;
+  {
+    CompactInputArchive compact_input_archive(data, size);
+    compact_input_archive(parsed);
+  }
+  return parsed;
+}
+
+template <typename ParsedType>
+ParsedType ParseCompact(const SerialisedData& serialised_data) {
+  return ParseCompact<ParsedType>(serialised_data.data(), serialised_data.size());
+}
+
+template <typename... TypesToParse>
+void ParseCompact(const byte* data, std::size_t size, TypesToParse&... objects_to_parse) {
+  CompactInputArchive compact_input_archive(data, size);
+  compact_input_archive(objects_to_parse...);
+}
+
+template <typename... TypesToParse>
+void ParseCompact(const SerialisedData& serialised_data, TypesToParse&... objects_to_parse) {
+  ParseCompact(serialised_data.data(), serialised_data.size(), objects_to_parse...);
 }
 
 
@@ -111,10 +213,16 @@ inline std::string ConvertToString(std::stringstream& ref_dest_stream,
       .str();
 }
 
+// Unlike the stream-based overload above, this appends straight to the returned string via
+// BinaryOutputArchive in a single pass.  The output is identical.
 template <typename... TypesToSerialise>
 inline std::string ConvertToString(TypesToSerialise&&... ref_source_objs) {
-  std::stringstream str_stream;
-  return ConvertToString(str_stream, std::forward<TypesToSerialise>(ref_source_objs)...);
+  std::string serialised;
+  {
+    BinaryOutputArchive binary_output_archive(serialised);
+    binary_output_archive(std::forward<TypesToSerialise>(ref_source_objs)...);
+  }
+  return serialised;
 }
 
 template <typename... DeSerialiseToTypes>
@@ -140,24 +248,26 @@ inline DeSerialiseToType ConvertFromStream(std::istream& ref_source_stream) {
   return dest_obj;
 }
 
+// The ConvertFromString functions parse the string in place via BinaryInputArchive.
 template <typename... DeSerialiseToTypes>
 inline void ConvertFromString(const std::string& ref_source_string,
                               DeSerialiseToTypes&... ref_dest_objs) {
-  std::stringstream str_stream{ref_source_string};
-  ConvertFromStream(str_stream, ref_dest_objs...);
+  Parse(reinterpret_cast<const byte*>(ref_source_string.data()), ref_source_string.size(),
+        ref_dest_objs...);
 }
 
 template <typename DeSerialiseToType>
 inline DeSerialiseToType& ConvertFromString(const std::string& ref_source_string,
                                             DeSerialiseToType& ref_dest_obj) {
-  std::stringstream str_stream{ref_source_string};
-  return ConvertFromStream(str_stream, ref_dest_obj);
+  Parse(reinterpret_cast<const byte*>(ref_source_string.data()), ref_source_string.size(),
+        ref_dest_obj);
+  return ref_dest_obj;
 }
 
 template <typename DeSerialiseToType>
 inline DeSerialiseToType ConvertFromString(const std::string& ref_source_string) {
-  std::stringstream str_stream{ref_source_string};
-  return ConvertFromStream<DeSerialiseToType>(str_stream);
+  return Parse<DeSerialiseToType>(reinterpret_cast<const byte*>(ref_source_string.data()),
+                                  ref_source_string.size());
 }
 
 }  // namespace maidsafe
@@ -0,0 +1,61 @@
+/*  Copyright 2015 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#ifndef MAIDSAFE_COMMON_TCP_BUFFER_POOL_H_
+#define MAIDSAFE_COMMON_TCP_BUFFER_POOL_H_
+
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+#include "maidsafe/common/types.h"
+
+namespace maidsafe {
+
+namespace tcp {
+
+// A small, thread-safe cache of message buffers, so that a steady stream of messages doesn't
+// allocate once buffers have been recycled.  At most 'max_buffers' buffers are kept, with a total
+// capacity of at most 'max_bytes'.
+class BufferPool {
+ public:
+  BufferPool(std::size_t max_buffers, std::size_t max_bytes);
+  BufferPool(const BufferPool&) = delete;
+  BufferPool(BufferPool&&) = delete;
+  BufferPool& operator=(BufferPool) = delete;
+
+  // Returns a buffer of 'size' bytes, reusing the smallest cached one with enough capacity if there
+  // is one.  The contents are unspecified.
+  Message Acquire(std::size_t size);
+  void Recycle(Message buffer);
+  std::size_t Size() const;
+  // The total capacity of the cached buffers.
+  std::size_t Bytes() const;
+
+ private:
+  const std::size_t kMaxBuffers_, kMaxBytes_;
+  std::vector<Message> buffers_;
+  std::size_t bytes_;
+  mutable std::mutex mutex_;
+};
+
+}  // namespace tcp
+
+}  // namespace maidsafe
+
+#endif  // MAIDSAFE_COMMON_TCP_BUFFER_POOL_H_
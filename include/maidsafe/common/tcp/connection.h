@@ -20,20 +20,27 @@
 #define MAIDSAFE_COMMON_TCP_CONNECTION_H_
 
 #include <array>
+#include <atomic>
+#include <chrono>
 #include <cstdint>
 #include <deque>
 #include <future>
+#include <list>
 #include <memory>
 #include <mutex>
+#include <type_traits>
 #include <vector>
 
 #include "asio/buffer.hpp"
 #include "asio/io_service.hpp"
 #include "asio/strand.hpp"
 #include "asio/ip/tcp.hpp"
+#include "asio/local/stream_protocol.hpp"
+#include "boost/filesystem/path.hpp"
 
 #include "maidsafe/common/error.h"
 #include "maidsafe/common/types.h"
+#include "maidsafe/common/tcp/buffer_pool.h"
 
 namespace maidsafe {
 
@@ -46,52 +53,249 @@ class Connection : public std::enable_shared_from_this<Connection> {
   Connection(const Connection&) = delete;
   Connection(Connection&&) = delete;
   Connection& operator=(Connection) = delete;
+  ~Connection();
 
   // Used when accepting an incoming connection.
   static ConnectionPtr MakeShared(asio::io_service::strand& strand);
   // Used to attempt to connect to 'remote_port' on loopback address.
   static ConnectionPtr MakeShared(asio::io_service::strand& strand, Port remote_port);
+#ifndef MAIDSAFE_WIN32
+  // Used to attempt to connect to a local listener's Unix domain socket at 'socket_path'.  Local
+  // connections avoid the TCP stack but otherwise behave identically, and can also pass file
+  // descriptors.
+  static ConnectionPtr MakeShared(asio::io_service::strand& strand,
+                                  const boost::filesystem::path& socket_path);
+#endif
 
   void Start(MessageReceivedFunctor on_message_received,
              ConnectionClosedFunctor on_connection_closed);
 
   void Close();
 
+  // Messages are moved, never copied, between the caller and the socket.
   void Send(Message data);
 
+  // Pull-style alternatives to 'Start' and 'Send', e.g. for stackless coroutines (see
+  // AsioService::Spawn), which can pass themselves as the handler.  'Receive' reads the next
+  // message and passes it to 'handler'; it may be called again before earlier calls complete, and
+  // messages are delivered in call order.  A connection must not use both 'Start' and 'Receive'.
+  // 'Send' invokes 'handler' once the message has been written to the socket.  If the connection
+  // is or becomes closed, pending handlers are invoked with 'asio::error::operation_aborted'.
+  // Handlers are invoked on the connection's strand, and never from within the call which passed
+  // them in.
+  void Receive(ReceiveHandler handler);
+  void Send(Message data, SendHandler handler);
+
+  // Queued messages are sent in a single gathered write of up to 'max_messages' messages or
+  // 'max_bytes' bytes, whichever limit is reached first (a larger message is still sent on its
+  // own).  Setting 'max_messages' to 1 sends each message with a separate write.
+  void SetWriteCoalescingLimits(size_t max_messages, size_t max_bytes);
+  static const size_t kDefaultMaxCoalescedMessages = 64;
+  static const size_t kDefaultMaxCoalescedBytes = 256 * 1024;
+
+  // Messages larger than 'MaxMessageSize()' can be streamed as a sequence of chunks, each of at
+  // most 'MaxMessageSize()' bytes, with 'last_chunk' set on the final one.  The chunks of one
+  // message mustn't be interleaved with any other sends on this connection.  Waiting for each
+  // chunk's 'handler' before sending the next bounds the sender's memory use by the chunks in
+  // flight rather than by the message size.
+  void SendChunk(Message chunk, bool last_chunk, SendHandler handler = nullptr);
+
+  // An alternative to 'Start' which passes each received chunk to 'on_chunk_received' as it
+  // arrives, along with whether it's the last of its message (an ordinary message is a single,
+  // last chunk), so memory use is bounded by the chunk size rather than the message size.
+  void StartStreaming(ChunkReceivedFunctor on_chunk_received,
+                      ConnectionClosedFunctor on_connection_closed);
+
+  // When not streaming, chunked messages are reassembled before being delivered.  A reassembled
+  // message larger than 'max_bytes' (by default 'MaxMessageSize()') closes the connection.
+  void SetReassemblyLimit(size_t max_bytes);
+
+  // Flow control for producers which may outpace the peer.  Once the bytes queued for sending
+  // reach 'high_watermark', 'TrySend' returns false without queueing the message, until the queue
+  // has drained to 'low_watermark' bytes, at which point 'on_writable' is invoked on the
+  // connection's strand.  'Send' and 'SendChunk' always queue.  Concurrent calls to 'TrySend' may
+  // overshoot the high watermark by a message each.  By default there's no high watermark.
+  // Throws if 'low_watermark' isn't less than 'high_watermark'.
+  void SetSendWatermarks(size_t high_watermark, size_t low_watermark,
+                         WritableFunctor on_writable);
+  bool TrySend(Message data);
+
+#ifndef MAIDSAFE_WIN32
+  // Local connections only: sends a duplicate of 'descriptor' along with 'data', e.g. a memory
+  // file holding a payload too large to copy through the socket.  The caller keeps ownership of
+  // 'descriptor'.  On receipt, both are passed to 'on_descriptor_received', which then owns the
+  // descriptor; if none has been set, the descriptor is closed and 'data' is delivered as an
+  // ordinary message.  Throws if the connection isn't local.
+  void SendWithDescriptor(Message data, int descriptor, SendHandler handler = nullptr);
+  void SetDescriptorReceivedFunctor(DescriptorReceivedFunctor on_descriptor_received);
+#endif
+  // Bytes queued for sending (including frame headers) but not yet written to the socket, and the
+  // largest that figure has been.
+  size_t QueuedBytes() const { return queued_bytes_; }
+  size_t PeakQueuedBytes() const { return peak_queued_bytes_; }
+
+  // Once both ends have called this, each compresses the body of every frame of 'threshold' bytes
+  // or more with a fast LZ codec before sending it, marking it with a flag in the frame header.
+  // If that doesn't save at least an eighth of the body, the frame is sent uncompressed.  Calling
+  // this sends the peer an empty frame announcing it; until the peer's announcement arrives, frames
+  // are sent uncompressed.  A peer built before compression was supported treats the announcement
+  // as an oversized frame and closes the connection, so only call this once both ends have been
+  // upgraded.  Throws if 'threshold' is below 'kMinCompressionThreshold'.
+  void EnableCompression(size_t threshold = kDefaultCompressionThreshold);
+  static const size_t kDefaultCompressionThreshold = 512;
+  static const size_t kMinCompressionThreshold = 16;
+  struct CompressionStats {
+    // Frames sent compressed, and frames sent uncompressed because of a poor ratio.
+    std::uint64_t compressed_frames, skipped_frames;
+    // Body bytes saved by the compressed frames, including their uncompressed size prefix.
+    std::uint64_t bytes_saved;
+    // Time spent compressing (including failed attempts) and decompressing.
+    std::chrono::nanoseconds compression_time, decompression_time;
+  };
+  CompressionStats GetCompressionStats() const;
+
+  // Received messages' buffers are taken from a small per-connection pool, which is refilled with
+  // the buffers of sent messages and any passed here once the application has finished with them
+  // (e.g. after parsing a received message), so that a steady stream of messages doesn't allocate.
+  // The pool keeps at most 'kBufferPoolSize' buffers holding 'kBufferPoolBytes' in total.
+  void RecycleBuffer(Message buffer);
+
+  // Incoming data is read in chunks of up to 'kReadBufferSize' bytes, and every complete message
+  // in a chunk is handled before reading again.  A message body of 'kDirectReadThreshold' bytes or
+  // more is instead read straight into its own buffer.  This returns the number of read
+  // operations issued so far, e.g. to measure how many messages each read yields.
+  std::uint64_t ReadOperationCount() const { return read_operation_count_; }
+  static const size_t kReadBufferSize = 64 * 1024;
+  static const size_t kDirectReadThreshold = 16 * 1024;
+
   asio::ip::tcp::socket& Socket() { return socket_; }
+#ifndef MAIDSAFE_WIN32
+  // The Unix domain socket which a local connection uses instead of 'Socket()'.
+  asio::local::stream_protocol::socket& LocalSocket() { return local_socket_; }
+#endif
+  bool IsLocal() const { return local_; }
 
   static size_t MaxMessageSize() { return 1024 * 1024; }  // bytes
 
  private:
-  explicit Connection(asio::io_service::strand& strand);
+  // Room for two buffers of 'MaxMessageSize()' bytes, enough for a connection echoing or streaming
+  // messages of any size to run without allocating, or for several smaller ones.
+  static const size_t kBufferPoolSize = 8;
+  static const size_t kBufferPoolBytes = 2 * 1024 * 1024;
+  // Set in a frame's size field on every chunk of a chunked message except the last.
+  static const DataSize kMoreChunksFlag = 0x80000000;
+  // Set in a frame's size field if a file descriptor was sent along with its first byte.
+  static const DataSize kDescriptorFlag = 0x40000000;
+  // Set in a frame's size field if its body is compressed.  The body is then the 4 byte size of
+  // the uncompressed data followed by the compressed data.  An empty compressed frame announces
+  // that the peer has enabled compression.
+  static const DataSize kCompressedFlag = 0x20000000;
+
+  friend class Listener;
+
+  Connection(asio::io_service::strand& strand, bool local);
   Connection(asio::io_service::strand& strand, Port remote_port);
+#ifndef MAIDSAFE_WIN32
+  Connection(asio::io_service::strand& strand, const boost::filesystem::path& socket_path);
+#endif
 
-  struct ReceivingMessage {
-    std::array<unsigned char, 4> size_buffer;
-    Message data_buffer;
+  // Memory for the handler of a connection's single outstanding read or write, reused so that
+  // starting one doesn't allocate.  If it's already in use, or too small, the heap is used instead.
+  class HandlerMemory {
+   public:
+    HandlerMemory() : storage_(), in_use_(false) {}
+    HandlerMemory(const HandlerMemory&) = delete;
+    HandlerMemory& operator=(const HandlerMemory&) = delete;
+    void* Allocate(size_t size);
+    void Deallocate(void* pointer);
+
+   private:
+    std::aligned_storage<512>::type storage_;
+    bool in_use_;
   };
+  template <typename Handler>
+  class AllocatingHandler;
+  template <typename Handler>
+  static AllocatingHandler<Handler> AllocateFrom(HandlerMemory& memory, Handler handler);
+  // Start an 'asio::async_read' or 'asio::async_write' on whichever socket the connection uses.
+  template <typename Buffers, typename Handler>
+  void AsyncRead(const Buffers& buffers, Handler handler);
+  template <typename Buffers, typename Handler>
+  void AsyncWrite(const Buffers& buffers, Handler handler);
 
   struct SendingMessage {
+    SendingMessage() : size_buffer(), data(), on_sent(), descriptor(-1) {}
     std::array<unsigned char, 4> size_buffer;
     Message data;
+    SendHandler on_sent;
+    int descriptor;
   };
 
   void DoClose();
+  void AbortPendingHandlers();
 
-  void ReadSize();
-  void ReadData();
+  bool WantsMessages() const;
+  void ProcessReadBuffer();
+  void ReadSome();
+  void ReadBody(size_t bytes_already_read, bool last_chunk, bool compressed);
+  bool TakeReceivedDescriptor(DataSize size_field, int& descriptor);
+  void HandleChunk(Message chunk, bool last_chunk, bool compressed, int descriptor);
+  void Deliver(Message data);
 
+  void QueueSend(SendingMessage message);
+  void FlushPendingSends();
   void DoSend();
-  SendingMessage EncodeData(Message data) const;
+  void HandleSent(size_t total_size);
+  void Dequeued(size_t bytes);
+#ifndef MAIDSAFE_WIN32
+  // Reads whatever is available without blocking, collecting any descriptors.  Returns false if
+  // nothing was read; 'ec' is set on error or if the peer has closed the connection.
+  bool ReceiveWithDescriptors(std::error_code& ec);
+  void DoSendWithDescriptor();
+#endif
+  SendingMessage EncodeData(Message data, bool last_chunk = true);
+  bool CompressBody(Message& data);
+  bool DecompressBody(Message& data);
 
   asio::io_service::strand& strand_;
   std::once_flag start_flag_, socket_close_flag_;
   asio::ip::tcp::socket socket_;
+#ifndef MAIDSAFE_WIN32
+  asio::local::stream_protocol::socket local_socket_;
+#endif
+  const bool local_;
   MessageReceivedFunctor on_message_received_;
+  ChunkReceivedFunctor on_chunk_received_;
+  DescriptorReceivedFunctor on_descriptor_received_;
   ConnectionClosedFunctor on_connection_closed_;
-  ReceivingMessage receiving_message_;
-  std::deque<SendingMessage> send_queue_;
+  Message read_buffer_, body_buffer_;
+  size_t read_begin_, read_end_;
+  bool reading_, parsing_;
+  std::atomic<std::uint64_t> read_operation_count_;
+  std::deque<int> received_descriptors_;
+  int body_descriptor_;
+  Message reassembly_buffer_;
+  size_t reassembly_limit_;
+  bool reassembling_;
+  std::deque<ReceiveHandler> receive_handlers_;
+  BufferPool buffer_pool_;
+  std::mutex pending_sends_mutex_;
+  std::vector<SendingMessage> pending_sends_, flushing_sends_;
+  // A list, since an in-flight write refers to its messages' size buffers.  The nodes of sent
+  // messages are kept in 'spare_sends_' (up to 'kDefaultMaxCoalescedMessages' of them) for reuse.
+  std::list<SendingMessage> send_queue_, spare_sends_;
+  std::vector<asio::const_buffer> send_buffers_;
+  HandlerMemory read_handler_memory_, write_handler_memory_;
+  size_t sending_count_, max_coalesced_messages_, max_coalesced_bytes_;
+  std::atomic<size_t> queued_bytes_, peak_queued_bytes_, high_watermark_, low_watermark_;
+  std::atomic<bool> above_high_watermark_;
+  WritableFunctor on_writable_;
+  std::once_flag compression_flag_;
+  std::atomic<size_t> compression_threshold_;
+  std::atomic<bool> peer_accepts_compression_;
+  std::atomic<std::uint64_t> compressed_frames_, skipped_frames_, bytes_saved_,
+      compression_nanoseconds_, decompression_nanoseconds_;
+  bool closed_;
 };
 
 }  // namespace tcp
@@ -22,10 +22,13 @@
 #include <functional>
 #include <memory>
 #include <mutex>
+#include <vector>
 
 #include "asio/ip/tcp.hpp"
 #include "asio/io_service.hpp"
+#include "asio/local/stream_protocol.hpp"
 #include "asio/strand.hpp"
+#include "boost/filesystem/path.hpp"
 
 #include "maidsafe/common/types.h"
 
@@ -35,27 +38,76 @@ namespace tcp {
 
 class Listener : public std::enable_shared_from_this<Listener> {
  public:
+  // Returns the strand on which the next accepted connection will run.
+  typedef std::function<asio::io_service::strand&()> StrandPicker;
+  typedef std::vector<std::reference_wrapper<asio::io_service::strand>> AcceptorStrands;
+
   Listener(const Listener&) = delete;
   Listener(Listener&&) = delete;
   Listener& operator=(Listener) = delete;
 
   static ListenerPtr MakeShared(asio::io_service::strand& strand,
                                 NewConnectionFunctor on_new_connection, Port desired_port);
+  // Accepted connections are spread across the strands returned by 'connection_strand_picker'
+  // (e.g. one strand per io_service of an AsioService in 'kServicePerThread' mode) rather than all
+  // running on the listener's own strand.
+  static ListenerPtr MakeShared(asio::io_service::strand& strand,
+                                NewConnectionFunctor on_new_connection, Port desired_port,
+                                StrandPicker connection_strand_picker);
+  // Opens one acceptor per strand in 'acceptor_strands' (e.g. one per io_service of an AsioService
+  // in 'kServicePerThread' mode), all listening on the same port with SO_REUSEPORT, so that the
+  // kernel spreads incoming connections across them rather than every accept being serialised
+  // through one strand.  A port already held by any other socket is skipped as usual.  Each
+  // accepted connection runs on the strand of the acceptor which accepted it, and
+  // 'on_new_connection' may be invoked concurrently from different strands.
+  // Throws if 'acceptor_strands' is empty, or if SO_REUSEPORT isn't supported and it holds more
+  // than one strand.
+  static ListenerPtr MakeShared(const AcceptorStrands& acceptor_strands,
+                                NewConnectionFunctor on_new_connection, Port desired_port);
+#ifndef MAIDSAFE_WIN32
+  // Listens on a Unix domain socket at 'socket_path' (replacing any stale socket file there, and
+  // removing it once stopped) rather than a loopback TCP port.  Throws if the path is taken by
+  // anything else, including a socket on which another listener is still listening.  Accepted
+  // connections are local; see 'Connection::MakeShared'.
+  static ListenerPtr MakeShared(asio::io_service::strand& strand,
+                                NewConnectionFunctor on_new_connection,
+                                const boost::filesystem::path& socket_path);
+#endif
+  // Returns 0 for a local listener.
   Port ListeningPort() const;
   void StopListening();
 
  private:
-  Listener(asio::io_service::strand& strand, NewConnectionFunctor on_new_connection);
+  struct Acceptor {
+    Acceptor(asio::io_service::strand& strand_in, StrandPicker connection_strand_picker_in);
+    asio::io_service::strand& strand;
+    StrandPicker connection_strand_picker;
+    bool IsOpen() const;
+#ifndef MAIDSAFE_WIN32
+    // Used instead of 'acceptor' by a local listener.
+    asio::local::stream_protocol::acceptor local_acceptor;
+#endif
+    asio::ip::tcp::acceptor acceptor;
+  };
+
+  explicit Listener(NewConnectionFunctor on_new_connection);
 
   void StartListening(Port desired_port);
   void DoStartListening(Port port);
-  void HandleAccept(ConnectionPtr accepted_connection, const std::error_code& ec);
-  void DoStopListening();
+  void OpenAcceptor(Acceptor& acceptor, asio::ip::tcp::endpoint& endpoint, bool reuse_port);
+#ifndef MAIDSAFE_WIN32
+  void StartListeningLocally();
+#endif
+  void StartAccept(Acceptor& acceptor);
+  void HandleAccept(Acceptor& acceptor, ConnectionPtr accepted_connection,
+                    const std::error_code& ec);
+  void DoStopListening(Acceptor& acceptor);
 
-  asio::io_service::strand& strand_;
   std::once_flag stop_listening_flag_;
   NewConnectionFunctor on_new_connection_;
-  asio::ip::tcp::acceptor acceptor_;
+  std::vector<std::unique_ptr<Acceptor>> acceptors_;
+  Port port_;
+  boost::filesystem::path socket_path_;
 };
 
 }  // namespace tcp
@@ -0,0 +1,120 @@
+/*  Copyright 2015 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#ifndef MAIDSAFE_COMMON_TCP_RPC_CHANNEL_H_
+#define MAIDSAFE_COMMON_TCP_RPC_CHANNEL_H_
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+#include "maidsafe/common/timer_wheel.h"
+#include "maidsafe/common/types.h"
+
+namespace maidsafe {
+
+namespace tcp {
+
+// Multiplexes requests and responses over a single connection.  Each request carries a
+// correlation id, so any number can be in flight at once (pipelined through the connection's send
+// queue) and their responses can arrive in any order.  Either end may issue requests; incoming
+// ones are passed to 'on_request' along with a 'Responder' to send the reply, which may be invoked
+// later and from any thread.
+//
+// The id and a kind byte are appended to each message as a 'kTrailerSize' byte trailer rather than
+// prepended, so the receiver strips it without copying the payload.  The sender only copies the
+// payload if the message lacks 'kTrailerSize' bytes of spare capacity, so callers which care can
+// reserve them.  A received request always has that spare capacity, so a response built in its
+// buffer isn't copied either.
+//
+// Per-request timeouts are scheduled on 'timer_wheel', which may be shared between channels.  A
+// request's handler is invoked exactly once: with the response, or with 'asio::error::timed_out',
+// or with 'asio::error::operation_aborted' if the channel closes first.
+class RpcChannel : public std::enable_shared_from_this<RpcChannel> {
+ public:
+  using Responder = std::function<void(Message)>;
+  using RequestFunctor = std::function<void(Message, Responder)>;
+
+  RpcChannel(const RpcChannel&) = delete;
+  RpcChannel(RpcChannel&&) = delete;
+  RpcChannel& operator=(RpcChannel) = delete;
+  // Closes the connection, aborting any outstanding requests.
+  ~RpcChannel();
+
+  // Takes over 'connection', which must not have been started.  'on_channel_closed' is invoked
+  // once the connection closes, after any outstanding requests have been aborted.
+  static RpcChannelPtr MakeShared(ConnectionPtr connection,
+                                  std::shared_ptr<TimerWheel> timer_wheel,
+                                  RequestFunctor on_request,
+                                  ConnectionClosedFunctor on_channel_closed);
+
+  // A zero 'timeout' means the request never times out.  'handler' is invoked on the connection's
+  // strand for responses and aborts, or on the timer wheel's io_service for timeouts; if the
+  // channel has already closed, it's invoked before 'Call' returns.  Requests and responses can be
+  // at most 'MaxMessageSize()' bytes.
+  void Call(Message request, std::chrono::steady_clock::duration timeout,
+            ReceiveHandler handler);
+  // As above, but the returned future holds the response or throws a 'maidsafe_error' holding
+  // the error code.
+  std::future<Message> Call(Message request, std::chrono::steady_clock::duration timeout);
+
+  void Close();
+  std::size_t InFlight() const;
+  static std::size_t MaxMessageSize();
+
+  static const std::size_t kTrailerSize = 5;
+
+ private:
+  using CorrelationId = std::uint32_t;
+  enum class Kind : byte { kRequest = 0, kResponse = 1 };
+
+  struct PendingCall {
+    ReceiveHandler handler;
+    TimerWheel::TimerId timer_id;
+  };
+
+  RpcChannel(ConnectionPtr connection, std::shared_ptr<TimerWheel> timer_wheel,
+             RequestFunctor on_request, ConnectionClosedFunctor on_channel_closed);
+
+  void Start();
+  void HandleMessage(Message message);
+  void HandleTimeout(CorrelationId id);
+  void HandleClosed();
+  void AbortPendingCalls();
+  void CheckSize(const Message& message) const;
+  void Send(Message message, CorrelationId id, Kind kind);
+
+  const ConnectionPtr connection_;
+  const std::shared_ptr<TimerWheel> timer_wheel_;
+  const RequestFunctor on_request_;
+  const ConnectionClosedFunctor on_channel_closed_;
+  mutable std::mutex mutex_;
+  CorrelationId next_id_;
+  bool closed_;
+  std::unordered_map<CorrelationId, PendingCall> pending_calls_;
+};
+
+}  // namespace tcp
+
+}  // namespace maidsafe
+
+#endif  // MAIDSAFE_COMMON_TCP_RPC_CHANNEL_H_
@@ -0,0 +1,281 @@
+/*  Copyright 2015 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#ifndef MAIDSAFE_COMMON_THREAD_POOL_H_
+#define MAIDSAFE_COMMON_THREAD_POOL_H_
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "asio/execution_context.hpp"
+#include "boost/thread/tss.hpp"
+
+#include "maidsafe/common/config.h"
+
+namespace maidsafe {
+
+namespace detail {
+
+// A move-only, type-erased nullary functor.  Unlike std::function, this can hold move-only types
+// such as std::packaged_task and asio completion handlers.
+class PoolTask {
+ public:
+  PoolTask() : impl_() {}
+
+  template <typename Functor,
+            typename = typename std::enable_if<
+                !std::is_same<typename std::decay<Functor>::type, PoolTask>::value>::type>
+  explicit PoolTask(Functor&& functor)
+      : impl_(new Impl<typename std::decay<Functor>::type>(std::forward<Functor>(functor))) {}
+
+  PoolTask(PoolTask&& other) MAIDSAFE_NOEXCEPT : impl_(std::move(other.impl_)) {}
+  PoolTask& operator=(PoolTask&& other) MAIDSAFE_NOEXCEPT {
+    impl_ = std::move(other.impl_);
+    return *this;
+  }
+  PoolTask(const PoolTask&) = delete;
+  PoolTask& operator=(const PoolTask&) = delete;
+
+  void operator()() { impl_->Run(); }
+  explicit operator bool() const { return static_cast<bool>(impl_); }
+
+ private:
+  struct Base {
+    virtual ~Base() {}
+    virtual void Run() = 0;
+  };
+
+  template <typename Functor>
+  struct Impl : Base {
+    template <typename F>
+    explicit Impl(F&& functor_in) : functor(std::forward<F>(functor_in)) {}
+    void Run() override { functor(); }
+    Functor functor;
+  };
+
+  std::unique_ptr<Base> impl_;
+};
+
+}  // namespace detail
+
+// A fixed-size pool of threads intended for short, CPU-bound tasks (hashing, signing, parsing,
+// etc.).  Each worker owns a deque of tasks; tasks posted from a worker go to the back of its own
+// deque and are popped LIFO, while tasks posted from other threads are distributed round-robin.
+// An idle worker steals from the front of the other workers' deques, starting at a random victim.
+//
+// The pool is also an asio execution context, so 'get_executor()' can be passed to 'asio::post',
+// 'asio::dispatch' and 'asio::defer'.
+class ThreadPool : public asio::execution_context {
+ public:
+  class Executor;
+  typedef Executor executor_type;
+
+  explicit ThreadPool(std::size_t thread_count);
+  ~ThreadPool();
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool(ThreadPool&&) = delete;
+  ThreadPool& operator=(ThreadPool) = delete;
+
+  // Finishes all queued tasks, then joins the worker threads.  Tasks posted after this has been
+  // called are discarded.  Throws if called from one of the pool's own threads.
+  void Stop();
+
+  std::size_t ThreadCount() const { return thread_count_; }
+  bool RunningInThisThread() const {
+    return current_worker_.get() != nullptr && current_worker_->pool == this;
+  }
+
+  executor_type get_executor() MAIDSAFE_NOEXCEPT;
+
+  template <typename Functor>
+  void Post(Functor&& functor) {
+    Push(detail::PoolTask{std::forward<Functor>(functor)});
+  }
+
+  template <typename Functor>
+  std::future<typename std::result_of<typename std::decay<Functor>::type()>::type> Async(
+      Functor&& functor) {
+    typedef typename std::result_of<typename std::decay<Functor>::type()>::type Result;
+    std::packaged_task<Result()> task{std::forward<Functor>(functor)};
+    std::future<Result> result{task.get_future()};
+    Post(std::move(task));
+    return result;
+  }
+
+  // Invokes 'functor(index)' for each index in ['begin', 'end').  The range is split into chunks of
+  // 'grain_size' indices (chosen automatically if 0) which are claimed by the pool's threads and by
+  // the calling thread, so it is safe to call this from a task already running in the pool.
+  // Blocks until every index has been processed, then rethrows the first exception (if any)
+  // thrown by 'functor'.
+  template <typename Functor>
+  void ParallelFor(std::size_t begin, std::size_t end, Functor functor,
+                   std::size_t grain_size = 0);
+
+ private:
+  struct Worker {
+    Worker(ThreadPool* pool_in, std::size_t index_in)
+        : pool(pool_in), index(index_in), random_state(index_in + 1), mutex(), tasks() {}
+    ThreadPool* const pool;
+    const std::size_t index;
+    std::uint32_t random_state;
+    std::mutex mutex;
+    std::deque<detail::PoolTask> tasks;
+  };
+
+  template <typename Functor>
+  struct ParallelForState {
+    ParallelForState(std::size_t begin_in, std::size_t end_in, std::size_t grain_size_in,
+                     Functor functor_in)
+        : begin(begin_in),
+          end(end_in),
+          grain_size(grain_size_in),
+          chunk_count((end_in - begin_in + grain_size_in - 1) / grain_size_in),
+          functor(std::move(functor_in)),
+          next_chunk(0),
+          completed_chunks(0),
+          exception(),
+          mutex(),
+          condition() {}
+
+    // Processes chunks until there are none left to claim.
+    void Run() {
+      for (std::size_t chunk(next_chunk++); chunk < chunk_count; chunk = next_chunk++) {
+        const std::size_t chunk_begin(begin + chunk * grain_size);
+        const std::size_t chunk_end(std::min(end, chunk_begin + grain_size));
+        try {
+          for (std::size_t index(chunk_begin); index != chunk_end; ++index)
+            functor(index);
+        } catch (...) {
+          std::lock_guard<std::mutex> lock(mutex);
+          if (!exception)
+            exception = std::current_exception();
+        }
+        if (++completed_chunks == chunk_count) {
+          { std::lock_guard<std::mutex> lock(mutex); }
+          condition.notify_all();
+        }
+      }
+    }
+
+    const std::size_t begin, end, grain_size, chunk_count;
+    Functor functor;
+    std::atomic<std::size_t> next_chunk, completed_chunks;
+    std::exception_ptr exception;
+    std::mutex mutex;
+    std::condition_variable condition;
+  };
+
+  static void NoCleanup(Worker*) {}
+
+  void Push(detail::PoolTask task);
+  bool TryPop(Worker& worker, detail::PoolTask& task);
+  bool TrySteal(Worker& thief, detail::PoolTask& task);
+  void Run(Worker& worker);
+
+  const std::size_t thread_count_;
+  std::vector<std::unique_ptr<Worker>> workers_;
+  std::vector<std::thread> threads_;
+  boost::thread_specific_ptr<Worker> current_worker_;
+  std::atomic<std::size_t> next_worker_, pending_, idle_;
+  std::atomic<bool> stopped_;
+  std::mutex mutex_, stop_mutex_;
+  std::condition_variable condition_;
+};
+
+class ThreadPool::Executor {
+ public:
+  ThreadPool& context() const MAIDSAFE_NOEXCEPT { return *pool_; }
+
+  // The pool's threads run until 'Stop()' is called, so outstanding work needn't be tracked.
+  void on_work_started() const MAIDSAFE_NOEXCEPT {}
+  void on_work_finished() const MAIDSAFE_NOEXCEPT {}
+
+  template <typename Functor, typename Allocator>
+  void dispatch(Functor&& functor, const Allocator&) const {
+    if (pool_->RunningInThisThread()) {
+      typename std::decay<Functor>::type local_functor(std::forward<Functor>(functor));
+      local_functor();
+    } else {
+      pool_->Post(std::forward<Functor>(functor));
+    }
+  }
+
+  template <typename Functor, typename Allocator>
+  void post(Functor&& functor, const Allocator&) const {
+    pool_->Post(std::forward<Functor>(functor));
+  }
+
+  template <typename Functor, typename Allocator>
+  void defer(Functor&& functor, const Allocator&) const {
+    pool_->Post(std::forward<Functor>(functor));
+  }
+
+  bool running_in_this_thread() const MAIDSAFE_NOEXCEPT { return pool_->RunningInThisThread(); }
+
+  friend bool operator==(const Executor& lhs, const Executor& rhs) MAIDSAFE_NOEXCEPT {
+    return lhs.pool_ == rhs.pool_;
+  }
+  friend bool operator!=(const Executor& lhs, const Executor& rhs) MAIDSAFE_NOEXCEPT {
+    return lhs.pool_ != rhs.pool_;
+  }
+
+ private:
+  friend class ThreadPool;
+  explicit Executor(ThreadPool& pool) : pool_(&pool) {}
+  ThreadPool* pool_;
+};
+
+inline ThreadPool::executor_type ThreadPool::get_executor() MAIDSAFE_NOEXCEPT {
+  return Executor{*this};
+}
+
+template <typename Functor>
+void ThreadPool::ParallelFor(std::size_t begin, std::size_t end, Functor functor,
+                             std::size_t grain_size) {
+  if (end <= begin)
+    return;
+  if (grain_size == 0)
+    grain_size = std::max<std::size_t>(1, (end - begin) / (thread_count_ * 8));
+
+  auto state(std::make_shared<ParallelForState<Functor>>(begin, end, grain_size,
+                                                         std::move(functor)));
+  const std::size_t helper_count(std::min(thread_count_, state->chunk_count - 1));
+  for (std::size_t i(0); i != helper_count; ++i)
+    Post([state] { state->Run(); });
+
+  state->Run();
+  std::unique_lock<std::mutex> lock(state->mutex);
+  state->condition.wait(lock, [&] { return state->completed_chunks == state->chunk_count; });
+  if (state->exception)
+    std::rethrow_exception(state->exception);
+}
+
+}  // namespace maidsafe
+
+#endif  // MAIDSAFE_COMMON_THREAD_POOL_H_
@@ -0,0 +1,112 @@
+/*  Copyright 2015 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#ifndef MAIDSAFE_COMMON_TIMER_WHEEL_H_
+#define MAIDSAFE_COMMON_TIMER_WHEEL_H_
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "asio/io_service.hpp"
+#include "asio/steady_timer.hpp"
+
+#include "maidsafe/common/asio_service.h"
+
+namespace maidsafe {
+
+// A hierarchical timer wheel for large numbers of coarse timeouts (e.g. one per outstanding
+// request).  Scheduling and cancelling are O(1) and don't touch asio's timer queue; the wheel only
+// keeps a single asio timer, which runs once per tick while any timeouts are pending.
+//
+// Timeouts have a resolution of one tick: handlers are never invoked early, but may be invoked up
+// to one tick late.  A handler is invoked exactly once unless it is cancelled first.  By default
+// each expired handler is posted to the io_service separately; with 'batch_expirations' all the
+// handlers expiring in a tick are invoked in sequence from the tick handler, which is cheaper but
+// serialises them.
+class TimerWheel : public std::enable_shared_from_this<TimerWheel> {
+ public:
+  typedef std::function<void()> Handler;
+  // A default-constructed (zero) TimerId never refers to a scheduled timeout.
+  typedef std::uint64_t TimerId;
+
+  TimerWheel(const TimerWheel&) = delete;
+  TimerWheel(TimerWheel&&) = delete;
+  TimerWheel& operator=(TimerWheel) = delete;
+
+  static std::shared_ptr<TimerWheel> MakeShared(
+      AsioService& asio_service,
+      std::chrono::steady_clock::duration tick = std::chrono::milliseconds(10),
+      bool batch_expirations = false);
+
+  TimerId Schedule(std::chrono::steady_clock::duration timeout, Handler handler);
+  // Returns true if the timeout was cancelled before its handler was invoked.
+  bool Cancel(TimerId timer_id);
+  // Cancels all pending timeouts without invoking their handlers.
+  void CancelAll();
+  std::size_t Size() const;
+  std::chrono::steady_clock::duration Tick() const { return tick_; }
+
+ private:
+  typedef std::uint64_t TickCount;
+  static const std::uint32_t kNoNode = 0xffffffff;
+  static const unsigned kRootBits = 8, kLevelBits = 6, kLevelCount = 5;
+
+  struct Node {
+    Node() : handler(), expiry(0), generation(1), previous(kNoNode), next(kNoNode), slot(kNoNode) {}
+    Handler handler;
+    TickCount expiry;
+    std::uint32_t generation, previous, next, slot;
+  };
+
+  TimerWheel(asio::io_service& io_service, std::chrono::steady_clock::duration tick,
+             bool batch_expirations);
+
+  TickCount NowTick() const;
+  std::uint32_t AllocateNode();
+  void FreeNode(std::uint32_t index);
+  void Link(std::uint32_t index);
+  void Unlink(std::uint32_t index);
+  bool Cascade(unsigned level, unsigned slot);
+  void Advance(std::vector<Handler>& expired);
+  void StartTicking();
+  void HandleTick(const std::error_code& ec);
+
+  asio::io_service& io_service_;
+  const std::chrono::steady_clock::duration tick_;
+  const bool batch_expirations_;
+  const std::chrono::steady_clock::time_point start_;
+  mutable std::mutex mutex_;
+  asio::steady_timer timer_;
+  bool ticking_;
+  TickCount next_tick_;
+  std::size_t size_;
+  std::vector<Node> nodes_;
+  std::uint32_t free_list_;
+  // Heads of each slot's doubly-linked list of nodes.  The root level has 2^kRootBits slots and
+  // each higher level has 2^kLevelBits, covering 2^32 ticks in total.
+  std::vector<std::uint32_t> slots_;
+};
+
+}  // namespace maidsafe
+
+#endif  // MAIDSAFE_COMMON_TIMER_WHEEL_H_
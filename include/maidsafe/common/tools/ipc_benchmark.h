@@ -0,0 +1,61 @@
+/*  Copyright 2015 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#ifndef MAIDSAFE_COMMON_TOOLS_IPC_BENCHMARK_H_
+#define MAIDSAFE_COMMON_TOOLS_IPC_BENCHMARK_H_
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+namespace maidsafe {
+
+namespace benchmark {
+
+// Compares ipc::Channel with loopback tcp::Connection for streaming messages one way and for
+// request/response round trips.
+class IpcBenchmark {
+ public:
+  IpcBenchmark();
+  void Run();
+
+ private:
+  // A sender streams 'message_count' messages of 'message_size' bytes to a receiver on another
+  // thread.  Returns the time until the receiver has them all.
+  std::chrono::steady_clock::duration ChannelStream(std::size_t message_size,
+                                                    std::size_t message_count);
+  std::chrono::steady_clock::duration TcpStream(std::size_t message_size,
+                                                std::size_t message_count);
+
+  // A client sends a message of 'message_size' bytes to an echo server and waits for it to come
+  // back, 'round_trips' times.  Returns the total time taken.
+  std::chrono::steady_clock::duration ChannelEcho(std::size_t message_size,
+                                                  std::size_t round_trips);
+  std::chrono::steady_clock::duration TcpEcho(std::size_t message_size, std::size_t round_trips);
+
+  void Report(const std::string& name, std::size_t message_count, std::size_t message_size,
+              std::chrono::steady_clock::duration duration) const;
+
+  const std::size_t message_count_, round_trips_;
+};
+
+}  // namespace benchmark
+
+}  // namespace maidsafe
+
+#endif  // MAIDSAFE_COMMON_TOOLS_IPC_BENCHMARK_H_
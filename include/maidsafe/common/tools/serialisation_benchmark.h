@@ -0,0 +1,84 @@
+/*  Copyright 2015 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#ifndef MAIDSAFE_COMMON_TOOLS_SERIALISATION_BENCHMARK_H_
+#define MAIDSAFE_COMMON_TOOLS_SERIALISATION_BENCHMARK_H_
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+namespace maidsafe {
+
+namespace benchmark {
+
+// Measures serialising and parsing ImmutableData, StructuredDataVersions and contiguous payloads of
+// 1 KiB to 1 MiB.  Serialising compares a new OutputVectorStream per call with Serialise and with
+// SerialiseInto a reused buffer; parsing compares an InputVectorStream, which copies its input,
+// with parsing the bytes in place.  The string conversions are compared with their
+// std::stringstream equivalents.  Also compares the size and speed of the binary and compact
+// archives on small-integer-heavy types.
+class SerialisationBenchmark {
+ public:
+  SerialisationBenchmark();
+  void Run();
+
+  // Measures Serialise, SerialiseInto a reused buffer and Parse for each of Identity,
+  // Data::NameAndTypeId, ImmutableData, MutableData, StructuredDataVersions, asymm::Keys and some
+  // nested STL containers.  Writes one line of JSON per type to 'output', holding the type name,
+  // the serialised size in bytes and, for each operation, the iteration count, nanoseconds per
+  // call, throughput ("mb_per_second", in units of 10^6 bytes) and allocations per call.  The
+  // allocation counts are null unless 'allocation_counter' is set.
+  void RunSuite(std::ostream& output);
+
+  // If set, this must be incremented on every call to the global operator new.  The
+  // serialisation_benchmark tool does this by replacing operator new.
+  static std::atomic<std::uint64_t>* allocation_counter;
+
+ private:
+  void ImmutableDataRoundTrips();
+  void StructuredDataVersionsRoundTrips();
+  void ContiguousPayloads();
+  void CompactArchives();
+
+  // Serialises and parses 'object' 'iterations' times using each of the approaches, reporting each.
+  template <typename T>
+  void RoundTrips(const T& object, std::size_t iterations);
+
+  // Compares the encoded size and the speed of the binary and compact archives for 'object'.
+  template <typename T>
+  void CompareArchives(const std::string& type_name, const T& object, std::size_t iterations);
+
+  // Measures 'object' as described for 'RunSuite' and writes its line of JSON to 'output'.
+  template <typename T>
+  void Measure(const std::string& type_name, const T& object, std::size_t iterations,
+               std::ostream& output);
+
+  void Report(const std::string& name, std::size_t iterations, std::size_t serialised_size,
+              std::chrono::steady_clock::duration duration) const;
+
+  std::size_t checksum_;
+};
+
+}  // namespace benchmark
+
+}  // namespace maidsafe
+
+#endif  // MAIDSAFE_COMMON_TOOLS_SERIALISATION_BENCHMARK_H_
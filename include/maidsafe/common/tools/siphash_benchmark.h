@@ -0,0 +1,49 @@
+/*  Copyright 2015 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#ifndef MAIDSAFE_COMMON_TOOLS_SIPHASH_BENCHMARK_H_
+#define MAIDSAFE_COMMON_TOOLS_SIPHASH_BENCHMARK_H_
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+namespace maidsafe {
+
+namespace benchmark {
+
+// Measures SipHash throughput for inputs of 8 B to 64 KiB, hashing each input with a single
+// Update, in 8-byte Updates as HashAppend does for a sequence of integers, and four inputs at a
+// time with SipHash::Hash.
+class SipHashBenchmark {
+ public:
+  SipHashBenchmark();
+  void Run();
+
+ private:
+  void Report(const std::string& name, std::size_t input_size, std::size_t hash_count,
+              std::chrono::steady_clock::duration duration) const;
+
+  std::uint64_t checksum_;
+};
+
+}  // namespace benchmark
+
+}  // namespace maidsafe
+
+#endif  // MAIDSAFE_COMMON_TOOLS_SIPHASH_BENCHMARK_H_
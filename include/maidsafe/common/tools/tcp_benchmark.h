@@ -0,0 +1,119 @@
+/*  Copyright 2015 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#ifndef MAIDSAFE_COMMON_TOOLS_TCP_BENCHMARK_H_
+#define MAIDSAFE_COMMON_TOOLS_TCP_BENCHMARK_H_
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+#include "maidsafe/common/asio_service.h"
+
+namespace maidsafe {
+
+namespace benchmark {
+
+// Measures tcp::Connection echo round trips over loopback.
+class TcpBenchmark {
+ public:
+  // Parameters for 'RunLoad'.  Defaults to a single connection with one message in flight.
+  struct LoadConfig {
+    LoadConfig();
+    std::size_t message_size, connection_count, in_flight, thread_count, round_trips;
+  };
+
+  TcpBenchmark();
+  void Run();
+
+  // Opens 'connection_count' client connections to an echo server, each keeping 'in_flight'
+  // messages of 'message_size' bytes outstanding until it has completed 'round_trips' round
+  // trips, all on an AsioService with 'thread_count' threads.  Writes a single line of JSON to
+  // 'output' holding the config, the round trips per second ("messages_per_second"), the payload
+  // bytes per second in both directions ("mb_per_second", in units of 10^6 bytes) and the p50,
+  // p99 and p999 round trip latencies in microseconds.  Throws if 'message_size' is too small to
+  // hold a timestamp or too large to send, or if any other count is zero.
+  void RunLoad(const LoadConfig& config, std::ostream& output) const;
+
+  // If set, this must be incremented on every call to the global operator new.  The tcp_benchmark
+  // tool does this by replacing operator new.
+  static std::atomic<std::uint64_t>* allocation_counter;
+
+ private:
+  void CompareServiceModes();
+  void CompareCallbacksAndCoroutines();
+  void CompareWriteCoalescing();
+  void MeasureLargeMessageThroughput();
+  void MeasureReadBatching();
+  void CompareAcceptors();
+  void CompareTransports();
+  void MeasureRpcPipelining();
+
+  // Whether the connections under test run over loopback TCP or a Unix domain socket.
+  enum class Transport { kTcp, kLocal };
+
+  // Each of 'connection_count' clients sends a message of 'message_size' bytes to an echo server
+  // and waits for it to come back, 'round_trips' times.  The clients are driven either by
+  // 'Connection::Start' callbacks or by coroutines using 'Connection::Receive'.  Returns the total
+  // time taken.  Over 'Transport::kLocal' all server connections share the listener's strand.  If
+  // 'allocations' is non-null and 'allocation_counter' is set, it's set to the number of
+  // allocations made while the round trips ran.
+  std::chrono::steady_clock::duration Echo(AsioService& asio_service,
+                                           std::size_t connection_count,
+                                           std::size_t message_size, std::size_t round_trips,
+                                           bool use_coroutines = false,
+                                           Transport transport = Transport::kTcp,
+                                           std::uint64_t* allocations = nullptr);
+
+  // A client sends 'message_count' messages of 'message_size' bytes in a burst, with at most
+  // 'max_coalesced_messages' per write.  Returns the time until the server has received them all.
+  // If 'server_read_operations' is non-null, it's set to the number of reads the server issued.
+  std::chrono::steady_clock::duration Stream(AsioService& asio_service, std::size_t message_size,
+                                             std::size_t message_count,
+                                             std::size_t max_coalesced_messages,
+                                             std::uint64_t* server_read_operations = nullptr,
+                                             Transport transport = Transport::kTcp);
+
+  // 'client_thread_count' threads each open and immediately reset 'connections_per_thread'
+  // connections to a listener with 'acceptor_count' acceptors, one per io_service.  Returns the
+  // time until all have been accepted.
+  std::chrono::steady_clock::duration ConnectionStorm(std::size_t acceptor_count,
+                                                      std::size_t client_thread_count,
+                                                      std::size_t connections_per_thread);
+
+  // A client keeps 'in_flight' requests of 'message_size' bytes outstanding on a tcp::RpcChannel
+  // to an echoing server until 'request_count' have been answered.  Returns the time taken.
+  std::chrono::steady_clock::duration RpcRoundTrips(AsioService& asio_service,
+                                                    std::size_t in_flight,
+                                                    std::size_t message_size,
+                                                    std::size_t request_count);
+
+  void Report(const std::string& name, std::size_t message_count,
+              std::chrono::steady_clock::duration duration,
+              const std::string& unit = "round trips") const;
+
+  const std::size_t thread_count_;
+};
+
+}  // namespace benchmark
+
+}  // namespace maidsafe
+
+#endif  // MAIDSAFE_COMMON_TOOLS_TCP_BENCHMARK_H_
@@ -0,0 +1,53 @@
+/*  Copyright 2015 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#ifndef MAIDSAFE_COMMON_TOOLS_THREAD_POOL_BENCHMARK_H_
+#define MAIDSAFE_COMMON_TOOLS_THREAD_POOL_BENCHMARK_H_
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace maidsafe {
+
+namespace benchmark {
+
+// Compares the scaling of AsioService and ThreadPool on a workload of many tiny CPU-bound tasks.
+class ThreadPoolBenchmark {
+ public:
+  ThreadPoolBenchmark();
+  void Run();
+
+ private:
+  std::chrono::steady_clock::duration AsioServicePost(std::size_t thread_count);
+  std::chrono::steady_clock::duration ThreadPoolPost(std::size_t thread_count);
+  std::chrono::steady_clock::duration ThreadPoolParallelFor(std::size_t thread_count);
+
+  void Report(const std::string& name, std::size_t thread_count,
+              std::chrono::steady_clock::duration duration,
+              std::chrono::steady_clock::duration single_thread_duration) const;
+
+  std::vector<std::uint64_t> results_;
+};
+
+}  // namespace benchmark
+
+}  // namespace maidsafe
+
+#endif  // MAIDSAFE_COMMON_TOOLS_THREAD_POOL_BENCHMARK_H_
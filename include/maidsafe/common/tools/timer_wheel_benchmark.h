@@ -0,0 +1,54 @@
+/*  Copyright 2015 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#ifndef MAIDSAFE_COMMON_TOOLS_TIMER_WHEEL_BENCHMARK_H_
+#define MAIDSAFE_COMMON_TOOLS_TIMER_WHEEL_BENCHMARK_H_
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+namespace maidsafe {
+
+namespace benchmark {
+
+// Compares TimerWheel against one asio::steady_timer per timeout.
+class TimerWheelBenchmark {
+ public:
+  TimerWheelBenchmark();
+  void Run();
+
+ private:
+  // Schedules 'timer_count_' timeouts then cancels them all.  Returns the time taken by the
+  // scheduling and cancelling calls, excluding running asio's aborted handlers.
+  std::chrono::steady_clock::duration AsioTimersScheduleAndCancel();
+  std::chrono::steady_clock::duration TimerWheelScheduleAndCancel();
+  // Schedules 'timer_count_' short timeouts and waits for them all to expire.
+  std::chrono::steady_clock::duration AsioTimersExpire();
+  std::chrono::steady_clock::duration TimerWheelExpire(bool batch_expirations);
+
+  void Report(const std::string& name, std::chrono::steady_clock::duration duration) const;
+
+  const std::size_t timer_count_, thread_count_;
+};
+
+}  // namespace benchmark
+
+}  // namespace maidsafe
+
+#endif  // MAIDSAFE_COMMON_TOOLS_TIMER_WHEEL_BENCHMARK_H_
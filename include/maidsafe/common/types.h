@@ -23,6 +23,7 @@
 #include <functional>
 #include <memory>
 #include <string>
+#include <system_error>
 #include <type_traits>
 #include <utility>
 #include <vector>
@@ -60,13 +61,20 @@ namespace tcp {
 
 class Connection;
 class Listener;
+class RpcChannel;
 
 using Message = std::vector<byte>;
 using ConnectionPtr = std::shared_ptr<Connection>;
 using ListenerPtr = std::shared_ptr<Listener>;
+using RpcChannelPtr = std::shared_ptr<RpcChannel>;
 using MessageReceivedFunctor = std::function<void(Message)>;
+using ChunkReceivedFunctor = std::function<void(Message, bool)>;
+using DescriptorReceivedFunctor = std::function<void(Message, int)>;
 using ConnectionClosedFunctor = std::function<void()>;
+using WritableFunctor = std::function<void()>;
 using NewConnectionFunctor = std::function<void(ConnectionPtr)>;
+using ReceiveHandler = std::function<void(std::error_code, Message)>;
+using SendHandler = std::function<void(std::error_code)>;
 using Port = std::uint16_t;
 
 }  // namespace tcp
@@ -0,0 +1,232 @@
+/*  Copyright 2015 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#include "maidsafe/common/handler_instrumentation.h"
+
+#include <algorithm>
+#include <iomanip>
+
+#include "maidsafe/common/log.h"
+#include "maidsafe/common/profiler.h"
+
+namespace maidsafe {
+
+namespace {
+
+std::size_t BucketIndex(std::uint64_t nanoseconds) {
+  std::size_t index(0);
+  while (nanoseconds > 1 && index < DurationHistogram::kBucketCount - 1) {
+    nanoseconds >>= 1;
+    ++index;
+  }
+  return index;
+}
+
+void UpdateMax(std::atomic<std::uint64_t>& current_max, std::uint64_t value) {
+  std::uint64_t previous(current_max.load(std::memory_order_relaxed));
+  while (previous < value &&
+         !current_max.compare_exchange_weak(previous, value, std::memory_order_relaxed)) {
+  }
+}
+
+std::uint64_t ToNanoseconds(HandlerInstrumentation::TimePoint::duration duration) {
+  const auto count(std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count());
+  return count < 0 ? 0 : static_cast<std::uint64_t>(count);
+}
+
+std::ostream& operator<<(std::ostream& ostream, const DurationHistogram::Snapshot& snapshot) {
+  ostream << "count " << snapshot.count << ", mean " << snapshot.Mean().count() << " ns, p50 <= "
+          << snapshot.Percentile(50.0).count() << " ns, p99 <= "
+          << snapshot.Percentile(99.0).count() << " ns, max " << snapshot.max.count() << " ns";
+  return ostream;
+}
+
+}  // unnamed namespace
+
+DurationHistogram::Snapshot::Snapshot()
+    : buckets(), count(0), total(std::chrono::nanoseconds(0)), max(std::chrono::nanoseconds(0)) {
+  buckets.fill(0);
+}
+
+std::chrono::nanoseconds DurationHistogram::Snapshot::Percentile(double percentile) const {
+  if (count == 0)
+    return std::chrono::nanoseconds(0);
+  const double target(std::min(100.0, std::max(0.0, percentile)) * static_cast<double>(count) /
+                      100.0);
+  std::uint64_t cumulative(0);
+  for (std::size_t i(0); i != kBucketCount; ++i) {
+    cumulative += buckets[i];
+    if (cumulative != 0 && static_cast<double>(cumulative) >= target) {
+      if (i == kBucketCount - 1)
+        return max;
+      return std::min(max, std::chrono::nanoseconds((std::uint64_t(1) << (i + 1)) - 1));
+    }
+  }
+  return max;
+}
+
+std::chrono::nanoseconds DurationHistogram::Snapshot::Mean() const {
+  return count == 0 ? std::chrono::nanoseconds(0)
+                    : total / static_cast<std::chrono::nanoseconds::rep>(count);
+}
+
+DurationHistogram::DurationHistogram()
+    : buckets_(), count_(0), total_nanoseconds_(0), max_nanoseconds_(0) {
+  for (auto& bucket : buckets_)
+    bucket = 0;
+}
+
+void DurationHistogram::Add(std::chrono::nanoseconds duration) {
+  const std::uint64_t nanoseconds(
+      duration.count() < 0 ? 0 : static_cast<std::uint64_t>(duration.count()));
+  buckets_[BucketIndex(nanoseconds)].fetch_add(1, std::memory_order_relaxed);
+  count_.fetch_add(1, std::memory_order_relaxed);
+  total_nanoseconds_.fetch_add(nanoseconds, std::memory_order_relaxed);
+  UpdateMax(max_nanoseconds_, nanoseconds);
+}
+
+void DurationHistogram::Reset() {
+  for (auto& bucket : buckets_)
+    bucket.store(0, std::memory_order_relaxed);
+  count_ = 0;
+  total_nanoseconds_ = 0;
+  max_nanoseconds_ = 0;
+}
+
+DurationHistogram::Snapshot DurationHistogram::GetSnapshot() const {
+  // The fields are read individually, so a snapshot taken while handlers are completing may be
+  // very slightly inconsistent.  'count' is derived from the buckets so that percentiles are sane.
+  Snapshot snapshot;
+  for (std::size_t i(0); i != kBucketCount; ++i) {
+    snapshot.buckets[i] = buckets_[i].load(std::memory_order_relaxed);
+    snapshot.count += snapshot.buckets[i];
+  }
+  snapshot.total = std::chrono::nanoseconds(total_nanoseconds_.load(std::memory_order_relaxed));
+  snapshot.max = std::chrono::nanoseconds(max_nanoseconds_.load(std::memory_order_relaxed));
+  return snapshot;
+}
+
+double ThreadUtilisation::BusyRatio() const {
+  return elapsed.count() <= 0 ? 0.0 : static_cast<double>(busy.count()) /
+                                          static_cast<double>(elapsed.count());
+}
+
+HandlerInstrumentation::HandlerInstrumentation(const std::vector<std::thread::id>& thread_ids)
+    : queue_wait_(),
+      execution_(),
+      queue_depth_(0),
+      max_queue_depth_(0),
+      slow_handler_threshold_(0),
+      threads_(thread_ids.size()),
+      reset_time_(std::chrono::steady_clock::now().time_since_epoch().count()),
+      slow_handlers_mutex_(),
+      slow_handlers_() {
+  for (std::size_t i(0); i != thread_ids.size(); ++i)
+    threads_[i].thread_id = thread_ids[i];
+}
+
+void HandlerInstrumentation::Reset(std::chrono::nanoseconds slow_handler_threshold) {
+  queue_wait_.Reset();
+  execution_.Reset();
+  // 'queue_depth_' is deliberately not reset, since handlers posted before now are still queued.
+  max_queue_depth_ = queue_depth_.load();
+  slow_handler_threshold_ = slow_handler_threshold.count();
+  for (auto& thread : threads_)
+    thread.busy_nanoseconds = 0;
+  reset_time_ = std::chrono::steady_clock::now().time_since_epoch().count();
+  std::lock_guard<std::mutex> lock(slow_handlers_mutex_);
+  slow_handlers_.clear();
+}
+
+void HandlerInstrumentation::HandlerQueued() {
+  UpdateMax(max_queue_depth_, queue_depth_.fetch_add(1, std::memory_order_relaxed) + 1);
+}
+
+void HandlerInstrumentation::HandlerDropped() {
+  queue_depth_.fetch_sub(1, std::memory_order_relaxed);
+}
+
+void HandlerInstrumentation::HandlerCompleted(const char* name, TimePoint queued,
+                                              TimePoint started, TimePoint finished) {
+  queue_depth_.fetch_sub(1, std::memory_order_relaxed);
+  const std::uint64_t queue_wait(ToNanoseconds(started - queued));
+  const std::uint64_t execution(ToNanoseconds(finished - started));
+  queue_wait_.Add(std::chrono::nanoseconds(queue_wait));
+  execution_.Add(std::chrono::nanoseconds(execution));
+
+  const std::thread::id this_thread_id(std::this_thread::get_id());
+  auto itr(std::find_if(std::begin(threads_), std::end(threads_),
+                        [&](const ThreadSlot& slot) { return slot.thread_id == this_thread_id; }));
+  if (itr != std::end(threads_))
+    itr->busy_nanoseconds.fetch_add(execution, std::memory_order_relaxed);
+
+#ifdef USE_PROFILING
+  profile::Profiler::Instance().AddEntry(
+      profile::ProfileEntry::Location("AsioService handler", 0, name ? name : "unnamed"),
+      finished - started);
+#endif
+
+  const auto threshold(slow_handler_threshold_.load(std::memory_order_relaxed));
+  if (threshold <= 0 || execution < static_cast<std::uint64_t>(threshold))
+    return;
+  SlowHandler slow_handler{name, this_thread_id, std::chrono::system_clock::now(),
+                           std::chrono::nanoseconds(queue_wait),
+                           std::chrono::nanoseconds(execution)};
+  LOG(kWarning) << "Slow asio handler " << (name ? name : "(unnamed)") << " took "
+                << execution / 1000 << " us (queued for " << queue_wait / 1000 << " us)";
+  std::lock_guard<std::mutex> lock(slow_handlers_mutex_);
+  if (slow_handlers_.size() == kSlowHandlerLogCapacity)
+    slow_handlers_.pop_front();
+  slow_handlers_.push_back(slow_handler);
+}
+
+HandlerStatistics HandlerInstrumentation::Statistics() const {
+  HandlerStatistics statistics;
+  statistics.queue_wait = queue_wait_.GetSnapshot();
+  statistics.execution = execution_.GetSnapshot();
+  statistics.queue_depth = queue_depth_;
+  statistics.max_queue_depth = max_queue_depth_;
+  const auto elapsed(std::chrono::nanoseconds(ToNanoseconds(
+      std::chrono::steady_clock::now() - TimePoint(TimePoint::duration(reset_time_.load())))));
+  for (const auto& thread : threads_) {
+    statistics.threads.push_back(ThreadUtilisation{
+        thread.thread_id, std::chrono::nanoseconds(thread.busy_nanoseconds.load()), elapsed});
+  }
+  std::lock_guard<std::mutex> lock(slow_handlers_mutex_);
+  statistics.slow_handlers.assign(std::begin(slow_handlers_), std::end(slow_handlers_));
+  return statistics;
+}
+
+std::ostream& operator<<(std::ostream& ostream, const HandlerStatistics& statistics) {
+  ostream << "Queue wait: " << statistics.queue_wait << '\n'
+          << "Execution:  " << statistics.execution << '\n'
+          << "Queue depth " << statistics.queue_depth << " (max " << statistics.max_queue_depth
+          << ")\n";
+  for (const auto& thread : statistics.threads) {
+    ostream << "Thread " << thread.thread_id << " busy " << std::fixed << std::setprecision(1)
+            << thread.BusyRatio() * 100.0 << "%\n";
+  }
+  ostream << statistics.slow_handlers.size() << " slow handler(s)\n";
+  for (const auto& slow_handler : statistics.slow_handlers) {
+    ostream << "  " << (slow_handler.name ? slow_handler.name : "(unnamed)") << " on thread "
+            << slow_handler.thread_id << ": " << slow_handler.execution.count() / 1000 << " us\n";
+  }
+  return ostream;
+}
+
+}  // namespace maidsafe
@@ -31,11 +31,13 @@
 
 // Note: The reference version was modified to separate the finalize stage, allowing
 // for non-contiguous bytes. The original document describing SipHash was used to
-// ensure accuracy.
+// ensure accuracy.  Whole words are loaded directly where the target is little-endian, and a
+// four-lane AVX2 compression is used by SipHash::Hash where the CPU supports it.
 
 #include "maidsafe/common/hash/algorithms/siphash.h"
 
 #include <algorithm>
+#include <cassert>
 #include <cstring>
 
 // Visual studio warns about the do {} while (0) loop in the macro from SipHash.
@@ -45,10 +47,23 @@
 #endif
 
 #if defined(ROTL) || defined(U32TO8_LE) || defined(U64TO8_LE) || defined(U8TO64_LE) || \
-    defined(SIPROUND)
+    defined(SIPROUND) || defined(MAIDSAFE_SIPHASH_LITTLE_ENDIAN) ||                     \
+    defined(MAIDSAFE_SIPHASH_AVX2)
 #error Previous definition for these macros not expected
 #endif
 
+#if (defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__) || \
+    defined(_M_IX86) || defined(_M_X64)
+#define MAIDSAFE_SIPHASH_LITTLE_ENDIAN
+#endif
+
+// The AVX2 code is compiled for that target regardless of the flags used for the rest of the
+// library, and is only called once the CPU has been checked.
+#if (defined(__GNUC__) || defined(__clang__)) && defined(__x86_64__)
+#define MAIDSAFE_SIPHASH_AVX2 __attribute__((target("avx2")))
+#include <immintrin.h>
+#endif
+
 #define ROTL(x, b) static_cast<uint64_t>(((x) << (b)) | ((x) >> (64 - (b)))) /*NOLINT*/
 
 #define U32TO8_LE(p, v)                     \
@@ -96,35 +111,59 @@ namespace {
 const unsigned cRounds = 2;
 const unsigned dRounds = 4;
 
-std::uint64_t FinalizeInternal(std::uint64_t v0, std::uint64_t v1, std::uint64_t v2,
-                               std::uint64_t v3, std::uint8_t b_in, const byte* in,
-                               unsigned inlen) MAIDSAFE_NOEXCEPT {
-  assert(inlen < 8);
+// Reads the little-endian word at 'in', which needn't be aligned.
+inline std::uint64_t LoadWord(const byte* in) MAIDSAFE_NOEXCEPT {
+#ifdef MAIDSAFE_SIPHASH_LITTLE_ENDIAN
+  std::uint64_t word;
+  std::memcpy(&word, in, sizeof(word));
+  return word;
+#else
+  return U8TO64_LE(in);
+#endif
+}
+
+// Reads 'length' (fewer than 8) bytes at 'in' as the low bytes of a little-endian word.
+inline std::uint64_t LoadPartialWord(const byte* in, unsigned length) MAIDSAFE_NOEXCEPT {
+  assert(length < 8);
+  std::uint64_t word = 0;
+  for (unsigned i = 0; i < length; ++i)
+    word |= static_cast<std::uint64_t>(in[i]) << (8 * i);
+  return word;
+}
+
+inline void CompressWord(std::uint64_t m, std::uint64_t& v0, std::uint64_t& v1, std::uint64_t& v2,
+                         std::uint64_t& v3) MAIDSAFE_NOEXCEPT {
+  v3 ^= m;
+
+  for (unsigned i = 0; i < cRounds; ++i)
+    SIPROUND;
+
+  v0 ^= m;
+}
+
+// Compresses each word in [in, end).  The state is worked on in locals, since 'in' could alias it
+// and the compiler would otherwise have to load and store it around every round.
+void CompressWords(const byte* in, const byte* const end, std::uint64_t& state0,
+                   std::uint64_t& state1, std::uint64_t& state2,
+                   std::uint64_t& state3) MAIDSAFE_NOEXCEPT {
+  std::uint64_t v0 = state0, v1 = state1, v2 = state2, v3 = state3;
 
+  for (; in != end; in += 8)
+    CompressWord(LoadWord(in), v0, v1, v2, v3);
+
+  state0 = v0;
+  state1 = v1;
+  state2 = v2;
+  state3 = v3;
+}
+
+std::uint64_t FinalizeInternal(std::uint64_t v0, std::uint64_t v1, std::uint64_t v2,
+                               std::uint64_t v3, std::uint8_t b_in,
+                               std::uint64_t remainder) MAIDSAFE_NOEXCEPT {
   //
   // Compress remainder bytes
   //
-  std::uint64_t b = (static_cast<std::uint64_t>(b_in + inlen)) << 56;
-
-  switch (inlen & 7) {
-    case 7:
-      b |= static_cast<std::uint64_t>(in[6]) << 48;
-    case 6:
-      b |= static_cast<std::uint64_t>(in[5]) << 40;
-    case 5:
-      b |= static_cast<std::uint64_t>(in[4]) << 32;
-    case 4:
-      b |= static_cast<std::uint64_t>(in[3]) << 24;
-    case 3:
-      b |= static_cast<std::uint64_t>(in[2]) << 16;
-    case 2:
-      b |= static_cast<std::uint64_t>(in[1]) << 8;
-    case 1:
-      b |= static_cast<std::uint64_t>(in[0]);
-      break;
-    case 0:
-      break;
-  }
+  const std::uint64_t b = (static_cast<std::uint64_t>(b_in) << 56) | remainder;
 
   v3 ^= b;
 
@@ -144,6 +183,89 @@ std::uint64_t FinalizeInternal(std::uint64_t v0, std::uint64_t v1, std::uint64_t
   return std::uint64_t(v0 ^ v1 ^ v2 ^ v3);
 }
 
+#ifdef MAIDSAFE_SIPHASH_AVX2
+
+bool Avx2Supported() {
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("avx2") != 0;
+}
+
+// AVX2 has no 64-bit rotate; rotations by 16 and 32 bits are done as byte shuffles.
+template <int Bits>
+MAIDSAFE_SIPHASH_AVX2 inline __m256i RotateLeft(__m256i x) {
+  return _mm256_or_si256(_mm256_slli_epi64(x, Bits), _mm256_srli_epi64(x, 64 - Bits));
+}
+
+MAIDSAFE_SIPHASH_AVX2 inline __m256i RotateLeft16(__m256i x) {
+  return _mm256_shuffle_epi8(x, _mm256_setr_epi8(6, 7, 0, 1, 2, 3, 4, 5, 14, 15, 8, 9, 10, 11, 12,
+                                                 13, 6, 7, 0, 1, 2, 3, 4, 5, 14, 15, 8, 9, 10, 11,
+                                                 12, 13));
+}
+
+MAIDSAFE_SIPHASH_AVX2 inline __m256i RotateLeft32(__m256i x) {
+  return _mm256_shuffle_epi32(x, _MM_SHUFFLE(2, 3, 0, 1));
+}
+
+MAIDSAFE_SIPHASH_AVX2 inline void SipRound(__m256i& v0, __m256i& v1, __m256i& v2, __m256i& v3) {
+  v0 = _mm256_add_epi64(v0, v1);
+  v1 = RotateLeft<13>(v1);
+  v1 = _mm256_xor_si256(v1, v0);
+  v0 = RotateLeft32(v0);
+  v2 = _mm256_add_epi64(v2, v3);
+  v3 = RotateLeft16(v3);
+  v3 = _mm256_xor_si256(v3, v2);
+  v0 = _mm256_add_epi64(v0, v3);
+  v3 = RotateLeft<21>(v3);
+  v3 = _mm256_xor_si256(v3, v0);
+  v2 = _mm256_add_epi64(v2, v1);
+  v1 = RotateLeft<17>(v1);
+  v1 = _mm256_xor_si256(v1, v2);
+  v2 = RotateLeft32(v2);
+}
+
+MAIDSAFE_SIPHASH_AVX2 inline __m256i LoadLanes(
+    const std::array<std::uint64_t, SipHash::kLanes>& lanes) {
+  return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(lanes.data()));
+}
+
+MAIDSAFE_SIPHASH_AVX2 inline void StoreLanes(__m256i value,
+                                             std::array<std::uint64_t, SipHash::kLanes>& lanes) {
+  _mm256_storeu_si256(reinterpret_cast<__m256i*>(lanes.data()), value);
+}
+
+// Compresses the first 'length' bytes (a multiple of 8) of each of the four inputs, one lane each.
+MAIDSAFE_SIPHASH_AVX2 void CompressLanes(const std::array<const byte*, SipHash::kLanes>& in,
+                                         std::uint64_t length,
+                                         std::array<std::uint64_t, SipHash::kLanes>& state0,
+                                         std::array<std::uint64_t, SipHash::kLanes>& state1,
+                                         std::array<std::uint64_t, SipHash::kLanes>& state2,
+                                         std::array<std::uint64_t, SipHash::kLanes>& state3) {
+  static_assert(SipHash::kLanes == 4, "Expected four 64-bit lanes per AVX2 register");
+  __m256i v0 = LoadLanes(state0), v1 = LoadLanes(state1), v2 = LoadLanes(state2),
+          v3 = LoadLanes(state3);
+
+  for (std::uint64_t offset = 0; offset != length; offset += 8) {
+    const __m256i m = _mm256_set_epi64x(
+        static_cast<long long>(LoadWord(in[3] + offset)),  // NOLINT
+        static_cast<long long>(LoadWord(in[2] + offset)),  // NOLINT
+        static_cast<long long>(LoadWord(in[1] + offset)),  // NOLINT
+        static_cast<long long>(LoadWord(in[0] + offset)));  // NOLINT
+    v3 = _mm256_xor_si256(v3, m);
+
+    for (unsigned i = 0; i < cRounds; ++i)
+      SipRound(v0, v1, v2, v3);
+
+    v0 = _mm256_xor_si256(v0, m);
+  }
+
+  StoreLanes(v0, state0);
+  StoreLanes(v1, state1);
+  StoreLanes(v2, state2);
+  StoreLanes(v3, state3);
+}
+
+#endif  // MAIDSAFE_SIPHASH_AVX2
+
 }  // namespace
 
 SipHash::SipHash(const std::array<byte, kKeySize>& seed) MAIDSAFE_NOEXCEPT
@@ -153,7 +275,7 @@ SipHash::SipHash(const std::array<byte, kKeySize>& seed) MAIDSAFE_NOEXCEPT
       v2(0x6c7967656e657261ULL),
       v3(0x7465646279746573ULL),
       remainder_length_(0),
-      remainder_(),
+      remainder_(0),
       b(0) {
   const std::uint64_t k0 = U8TO64_LE(seed.data());
   const std::uint64_t k1 = U8TO64_LE(seed.data() + sizeof(k0));
@@ -164,55 +286,78 @@ SipHash::SipHash(const std::array<byte, kKeySize>& seed) MAIDSAFE_NOEXCEPT
   v0 ^= k0;
 }
 
-unsigned SipHash::Compress(const byte* in, std::uint64_t inlen) MAIDSAFE_NOEXCEPT {
-  const uint8_t* const end = in + inlen - (inlen % sizeof(uint64_t));
-  const unsigned left = inlen & 7;
-
-  for (; in != end; in += 8) {
-    const std::uint64_t m = U8TO64_LE(in);
-    v3 ^= m;
-
-    for (unsigned i = 0; i < cRounds; ++i)
-      SIPROUND;
-
-    v0 ^= m;
-  }
-
-  return left;
-}
-
 void SipHash::Update(const byte* in, std::uint64_t inlen) MAIDSAFE_NOEXCEPT {
-  assert(remainder_length_ < remainder_.size());
+  assert(remainder_length_ < 8);
+  b = std::uint8_t(b + inlen);
 
   if (remainder_length_ > 0) {
-    const std::uint64_t copy_length =
-        std::min<std::uint64_t>(inlen, remainder_.size() - remainder_length_);
+    const unsigned copy_length =
+        unsigned(std::min<std::uint64_t>(inlen, 8 - remainder_length_));
+
+    remainder_ |= LoadPartialWord(in, copy_length) << (8 * remainder_length_);
+    remainder_length_ += copy_length;
 
-    std::copy(in, in + copy_length, remainder_.data() + remainder_length_);
+    if (remainder_length_ < 8)
+      return;
 
     in += copy_length;
     inlen -= copy_length;
 
-    remainder_length_ = unsigned(remainder_length_ + copy_length);
-    b = std::uint8_t(b + copy_length);
-
-    remainder_length_ = Compress(remainder_.data(), remainder_length_);
+    CompressWord(remainder_, v0, v1, v2, v3);
+    remainder_length_ = 0;
+    remainder_ = 0;
   }
 
-  const unsigned left = Compress(in, inlen);
-
-  assert(left <= inlen);
-  assert(remainder_length_ + left < remainder_.size());
-  std::copy(in + (inlen - left), in + inlen, remainder_.data() + remainder_length_);
+  const byte* const end = in + (inlen - (inlen % sizeof(std::uint64_t)));
+  CompressWords(in, end, v0, v1, v2, v3);
 
-  remainder_length_ += left;
-  b = std::uint8_t(b + inlen);
+  remainder_length_ = unsigned(inlen & 7);
+  remainder_ = LoadPartialWord(end, remainder_length_);
 }
 
 std::uint64_t SipHash::Finalize() const MAIDSAFE_NOEXCEPT {
   // Copy state, so this object isn't actually finalized
-  assert(remainder_length_ < remainder_.size());
-  return FinalizeInternal(v0, v1, v2, v3, b, remainder_.data(), remainder_length_);
+  assert(remainder_length_ < 8);
+  return FinalizeInternal(v0, v1, v2, v3, b, remainder_);
+}
+
+void SipHash::Hash(const std::array<byte, kKeySize>& seed,
+                   const std::array<const byte*, kLanes>& in,
+                   const std::array<std::uint64_t, kLanes>& inlen,
+                   std::array<std::uint64_t, kLanes>& out) MAIDSAFE_NOEXCEPT {
+  const SipHash initial(seed);
+  std::array<std::uint64_t, kLanes> state0, state1, state2, state3;
+  state0.fill(initial.v0);
+  state1.fill(initial.v1);
+  state2.fill(initial.v2);
+  state3.fill(initial.v3);
+
+  // The number of leading bytes of every input compressed in parallel.
+  std::uint64_t common_length = 0;
+#ifdef MAIDSAFE_SIPHASH_AVX2
+  static const bool avx2_supported(Avx2Supported());
+  if (avx2_supported) {
+    common_length = *std::min_element(inlen.begin(), inlen.end());
+    common_length -= common_length % sizeof(std::uint64_t);
+    // For shorter inputs, moving the state in and out of the vector registers costs more than
+    // compressing the few words in parallel saves.
+    if (common_length >= 32)
+      CompressLanes(in, common_length, state0, state1, state2, state3);
+    else
+      common_length = 0;
+  }
+#endif
+
+  for (std::size_t lane = 0; lane < kLanes; ++lane) {
+    SipHash hash(initial);
+    hash.v0 = state0[lane];
+    hash.v1 = state1[lane];
+    hash.v2 = state2[lane];
+    hash.v3 = state3[lane];
+    hash.b = std::uint8_t(common_length);
+    hash.Update(in[lane] + common_length, inlen[lane] - common_length);
+    out[lane] = hash.Finalize();
+  }
 }
 
 }  // namespace maidsafe
@@ -275,6 +275,66 @@ TEST(SipHash, BEH_RandomString) {
   }
 }
 
+TEST(SipHash, BEH_AllLengths) {
+  // Covers every length of trailing bytes and every alignment of the input
+  const std::string test_string(RandomString(300));
+  const auto random_seed(GetRandomSeed());
+
+  for (unsigned offset = 0; offset < 8; ++offset) {
+    for (unsigned length = 0; length <= test_string.size() - offset; ++length) {
+      const char* const in = test_string.data() + offset;
+      const auto reference_hash(SiphashReference(random_seed, in, length));
+
+      maidsafe::SipHash hash(random_seed);
+      hash.Update(reinterpret_cast<const byte*>(in), length);
+      EXPECT_EQ(reference_hash, hash.Finalize()) << "Failed on offset " << offset << ", length "
+                                                 << length;
+
+      maidsafe::SipHash split_hash(random_seed);
+      const unsigned split = length / 3;
+      split_hash.Update(reinterpret_cast<const byte*>(in), split);
+      split_hash.Update(reinterpret_cast<const byte*>(in) + split, length - split);
+      EXPECT_EQ(reference_hash, split_hash.Finalize()) << "Failed on offset " << offset
+                                                       << ", length " << length;
+    }
+  }
+}
+
+TEST(SipHash, BEH_MultipleInputs) {
+  const std::string test_string(RandomString(5000));
+  const auto random_seed(GetRandomSeed());
+
+  const auto check([&](const std::array<const byte*, SipHash::kLanes>& in,
+                       const std::array<std::uint64_t, SipHash::kLanes>& inlen) {
+    std::array<std::uint64_t, SipHash::kLanes> out{{}};
+    SipHash::Hash(random_seed, in, inlen, out);
+    for (std::size_t lane = 0; lane < SipHash::kLanes; ++lane) {
+      EXPECT_EQ(
+          SiphashReference(random_seed, reinterpret_cast<const char*>(in[lane]), inlen[lane]),
+          out[lane]) << "Failed on lane " << lane << " with length " << inlen[lane];
+    }
+  });
+
+  const byte* const data = reinterpret_cast<const byte*>(test_string.data());
+  // Equal lengths, including those too short to be compressed in parallel
+  for (std::uint64_t length : {0, 1, 8, 31, 32, 33, 64, 1000, 4096}) {
+    check({{data, data + 1, data + 2, data + 3}}, {{length, length, length, length}});
+    // The same input in every lane
+    check({{data, data, data, data}}, {{length, length, length, length}});
+  }
+
+  // Random lengths and alignments
+  for (int i = 0; i < 200; ++i) {
+    std::array<const byte*, SipHash::kLanes> in;
+    std::array<std::uint64_t, SipHash::kLanes> inlen;
+    for (std::size_t lane = 0; lane < SipHash::kLanes; ++lane) {
+      in[lane] = data + RandomUint32() % 8;
+      inlen[lane] = RandomUint32() % (i < 100 ? 100 : 4000);
+    }
+    check(in, inlen);
+  }
+}
+
 }  // namespace test
 
 }  // namespace maidsafe
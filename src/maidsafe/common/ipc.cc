@@ -18,13 +18,55 @@
 
 #include "maidsafe/common/ipc.h"
 
+#include <algorithm>
+#include <cstring>
+
 #include "maidsafe/common/encode.h"
+#include "maidsafe/common/error.h"
 #include "maidsafe/common/utils.h"
 
 namespace maidsafe {
 
 namespace ipc {
 
+namespace {
+
+const char kSharedItemsName[] = "items";
+// Space for the segment manager and its index of named objects.
+const std::size_t kSegmentOverhead = 1024;
+// The upper bound of each allocation's header and alignment padding.
+const std::size_t kAllocationOverhead = 32;
+
+// The space needed to add 'items' to a segment which will then hold 'total_count' items.  The
+// index is reallocated to fit them all while its old allocation is still held.
+std::size_t RequiredSpace(const std::vector<std::string>& items, std::size_t total_count) {
+  std::size_t required(2 * (total_count * sizeof(detail::SharedItem) + kAllocationOverhead));
+  for (const auto& item : items)
+    required += item.size() + kAllocationOverhead;
+  return required;
+}
+
+void AddItems(bi::managed_shared_memory& segment, detail::SharedItems& shared_items,
+              const std::vector<std::string>& items) {
+  shared_items.reserve(shared_items.size() + items.size());
+  for (const auto& item : items) {
+    char* const data(static_cast<char*>(segment.allocate(std::max<std::size_t>(item.size(), 1))));
+    if (!item.empty())
+      std::memcpy(data, item.data(), item.size());
+    shared_items.push_back(detail::SharedItem{data, item.size()});
+  }
+}
+
+detail::SharedItems* FindItems(bi::managed_shared_memory& segment) {
+  detail::SharedItems* const shared_items(
+      segment.find<detail::SharedItems>(kSharedItemsName).first);
+  if (!shared_items)
+    BOOST_THROW_EXCEPTION(MakeError(CommonErrors::no_such_element));
+  return shared_items;
+}
+
+}  // unnamed namespace
+
 void RemoveSharedMemory(std::string name_in) {
   std::string name(hex::Encode(name_in));
   boost::interprocess::shared_memory_object::remove(name.c_str());
@@ -58,6 +100,54 @@ std::vector<std::string> ReadSharedMemory(std::string name_in, int number) {
   return ret_vec;
 }
 
+void WriteSharedMemory(const std::string& name_in, const std::vector<std::string>& items) {
+  RemoveSharedMemory(name_in);
+  const std::string name(hex::Encode(name_in));
+  {
+    bi::managed_shared_memory segment(bi::create_only, name.c_str(),
+                                      kSegmentOverhead + RequiredSpace(items, items.size()));
+    detail::SharedItems* const shared_items(segment.construct<detail::SharedItems>(
+        kSharedItemsName)(detail::SharedItemAllocator(segment.get_segment_manager())));
+    AddItems(segment, *shared_items, items);
+  }
+  // Give back whatever the estimate overshot by.
+  bi::managed_shared_memory::shrink_to_fit(name.c_str());
+}
+
+void AppendSharedMemory(const std::string& name_in, const std::vector<std::string>& items) {
+  const std::string name(hex::Encode(name_in));
+  std::size_t required, free;
+  {
+    bi::managed_shared_memory segment(bi::open_only, name.c_str());
+    required = RequiredSpace(items, FindItems(segment)->size() + items.size());
+    free = segment.get_free_memory();
+  }
+  if (free < required)
+    bi::managed_shared_memory::grow(name.c_str(), required - free);
+  {
+    bi::managed_shared_memory segment(bi::open_only, name.c_str());
+    AddItems(segment, *FindItems(segment), items);
+  }
+  bi::managed_shared_memory::shrink_to_fit(name.c_str());
+}
+
+SharedMemoryReader::SharedMemoryReader(const std::string& name)
+    : segment_(bi::open_only, hex::Encode(name).c_str()), items_(FindItems(segment_)) {}
+
+boost::string_ref SharedMemoryReader::operator[](std::size_t index) const {
+  if (index >= items_->size())
+    BOOST_THROW_EXCEPTION(MakeError(CommonErrors::outside_of_bounds));
+  const detail::SharedItem& item((*items_)[index]);
+  return boost::string_ref(item.data.get(), static_cast<std::size_t>(item.size));
+}
+
+std::vector<boost::string_ref> SharedMemoryReader::Items() const {
+  std::vector<boost::string_ref> items;
+  items.reserve(items_->size());
+  for (const auto& item : *items_)
+    items.emplace_back(item.data.get(), static_cast<std::size_t>(item.size));
+  return items;
+}
 
 }  // namespace ipc
 
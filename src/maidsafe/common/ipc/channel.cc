@@ -0,0 +1,324 @@
+/*  Copyright 2015 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#include "maidsafe/common/ipc/channel.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <limits>
+#include <thread>
+
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+
+#include "maidsafe/common/encode.h"
+#include "maidsafe/common/error.h"
+
+namespace bi = boost::interprocess;
+
+namespace maidsafe {
+
+namespace ipc {
+
+namespace detail {
+
+static_assert(ATOMIC_INT_LOCK_FREE == 2 && ATOMIC_LLONG_LOCK_FREE == 2,
+              "Shared memory synchronisation requires address-free lock-free atomics.");
+
+// Lives at the start of the shared segment.  Positions only ever increase; the index into the ring
+// is a position modulo the capacity.  The producer's fields, the consumer's fields and the rarely
+// written ones are kept on separate cache lines so that the two ends don't contend.
+struct ChannelControl {
+  explicit ChannelControl(std::uint64_t capacity_in)
+      : write_position(0),
+        data_sequence(0),
+        receiver_waiting(0),
+        producer_padding(),
+        read_position(0),
+        space_sequence(0),
+        sender_waiting(0),
+        consumer_padding(),
+        closed(0),
+        capacity(capacity_in) {}
+
+  // 'data_sequence' and 'space_sequence' are the futex words which a blocked receiver or sender
+  // sleeps on.  They're only bumped when the matching '..._waiting' flag is set.
+  std::atomic<std::uint64_t> write_position;
+  std::atomic<std::uint32_t> data_sequence, receiver_waiting;
+  char producer_padding[64 - 16];
+  std::atomic<std::uint64_t> read_position;
+  std::atomic<std::uint32_t> space_sequence, sender_waiting;
+  char consumer_padding[64 - 16];
+  std::atomic<std::uint32_t> closed;
+  const std::uint64_t capacity;
+};
+
+}  // namespace detail
+
+namespace {
+
+const char kControlName[] = "control";
+const char kRingName[] = "ring";
+const std::size_t kMinCapacity = 64;
+const std::size_t kMaxCapacity = 1U << 30;
+// Room for the segment manager, its index and the control block alongside the ring.
+const std::size_t kSegmentOverhead = 8192;
+
+// Sleeps while 'word' holds 'expected', until woken or 'deadline' passes.  May return spuriously.
+void Wait(std::atomic<std::uint32_t>& word, std::uint32_t expected,
+          std::chrono::steady_clock::time_point deadline) {
+  const auto now(std::chrono::steady_clock::now());
+  if (now >= deadline)
+    return;
+#ifdef __linux__
+  // Not FUTEX_WAIT_PRIVATE, since the waker may be in another process.
+  timespec timeout{};
+  timespec* timeout_ptr{nullptr};
+  if (deadline != std::chrono::steady_clock::time_point::max()) {
+    const auto remaining(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(deadline - now).count());
+    timeout.tv_sec = static_cast<time_t>(remaining / 1000000000);
+    timeout.tv_nsec = static_cast<decltype(timeout.tv_nsec)>(remaining % 1000000000);
+    timeout_ptr = &timeout;
+  }
+  syscall(SYS_futex, reinterpret_cast<std::uint32_t*>(&word), FUTEX_WAIT, expected, timeout_ptr,
+          nullptr, 0);
+#else
+  const auto poll_until(std::min(deadline, now + std::chrono::milliseconds(1)));
+  while (word.load(std::memory_order_acquire) == expected &&
+         std::chrono::steady_clock::now() < poll_until) {
+    std::this_thread::sleep_for(std::chrono::microseconds(50));
+  }
+#endif
+}
+
+// How many times a blocked end polls before sleeping.  With another core free, the other end is
+// usually only a few hundred nanoseconds away, while sleeping and waking cost a system call on
+// each side.  With one core, polling only delays the other end.
+int SpinCount() {
+  static const int spin_count(std::thread::hardware_concurrency() > 1 ? 1000 : 0);
+  return spin_count;
+}
+
+void Wake(std::atomic<std::uint32_t>& word) {
+  word.fetch_add(1, std::memory_order_release);
+#ifdef __linux__
+  syscall(SYS_futex, reinterpret_cast<std::uint32_t*>(&word), FUTEX_WAKE,
+          std::numeric_limits<int>::max(), nullptr, nullptr, 0);
+#endif
+}
+
+std::size_t RoundUpCapacity(std::size_t capacity) {
+  if (capacity < kMinCapacity || capacity > kMaxCapacity)
+    BOOST_THROW_EXCEPTION(MakeError(CommonErrors::invalid_argument));
+  std::size_t rounded(kMinCapacity);
+  while (rounded < capacity)
+    rounded <<= 1;
+  return rounded;
+}
+
+}  // unnamed namespace
+
+Channel::Channel(const std::string& name, std::size_t capacity)
+    : kName_(hex::Encode(name)),
+      kOwner_(true),
+      segment_(),
+      control_(nullptr),
+      ring_(nullptr),
+      capacity_(RoundUpCapacity(capacity)),
+      cached_read_position_(0),
+      cached_write_position_(0) {
+  bi::shared_memory_object::remove(kName_.c_str());
+  segment_ = bi::managed_shared_memory(bi::create_only, kName_.c_str(),
+                                       capacity_ + kSegmentOverhead);
+  // The ring is constructed first, so that an opener which finds the control block finds both.
+  ring_ = segment_.construct<byte>(kRingName)[capacity_](0);
+  control_ = segment_.construct<detail::ChannelControl>(kControlName)(capacity_);
+}
+
+Channel::Channel(const std::string& name)
+    : kName_(hex::Encode(name)),
+      kOwner_(false),
+      segment_(bi::open_only, kName_.c_str()),
+      control_(segment_.find<detail::ChannelControl>(kControlName).first),
+      ring_(segment_.find<byte>(kRingName).first),
+      capacity_(0),
+      cached_read_position_(0),
+      cached_write_position_(0) {
+  if (!control_ || !ring_)
+    BOOST_THROW_EXCEPTION(MakeError(CommonErrors::uninitialised));
+  capacity_ = static_cast<std::size_t>(control_->capacity);
+  cached_read_position_ = control_->read_position.load(std::memory_order_acquire);
+  cached_write_position_ = control_->write_position.load(std::memory_order_acquire);
+}
+
+Channel::~Channel() {
+  if (!kOwner_)
+    return;
+  Close();
+  bi::shared_memory_object::remove(kName_.c_str());
+}
+
+void Channel::Remove(const std::string& name) {
+  bi::shared_memory_object::remove(hex::Encode(name).c_str());
+}
+
+bool Channel::TrySend(const byte* data, std::size_t size) {
+  if (size > MaxMessageSize())
+    BOOST_THROW_EXCEPTION(MakeError(CommonErrors::cannot_exceed_limit));
+  if (control_->closed.load(std::memory_order_relaxed) != 0)
+    return false;
+  const std::uint64_t write_position(control_->write_position.load(std::memory_order_relaxed));
+  const std::uint64_t end_position(write_position + sizeof(std::uint32_t) + size);
+  if (end_position - cached_read_position_ > capacity_) {
+    cached_read_position_ = control_->read_position.load(std::memory_order_acquire);
+    if (end_position - cached_read_position_ > capacity_)
+      return false;
+  }
+
+  const std::uint32_t size_prefix(static_cast<std::uint32_t>(size));
+  CopyIn(write_position, reinterpret_cast<const byte*>(&size_prefix), sizeof(size_prefix));
+  CopyIn(write_position + sizeof(size_prefix), data, size);
+  // Sequentially consistent, so that either the receiver sees this message when it rechecks
+  // after setting 'receiver_waiting', or this sees the flag set.
+  control_->write_position.store(end_position, std::memory_order_seq_cst);
+  if (control_->receiver_waiting.load(std::memory_order_seq_cst) != 0)
+    Wake(control_->data_sequence);
+  return true;
+}
+
+bool Channel::Send(const byte* data, std::size_t size) {
+  return SendUntil(data, size, std::chrono::steady_clock::time_point::max());
+}
+
+bool Channel::Send(const byte* data, std::size_t size,
+                   std::chrono::steady_clock::duration timeout) {
+  return SendUntil(data, size, std::chrono::steady_clock::now() + timeout);
+}
+
+bool Channel::SendUntil(const byte* data, std::size_t size,
+                        std::chrono::steady_clock::time_point deadline) {
+  for (int i(0), spin_count(SpinCount()); i != spin_count; ++i) {
+    if (TrySend(data, size))
+      return true;
+  }
+  while (!TrySend(data, size)) {
+    if (Closed() || std::chrono::steady_clock::now() >= deadline)
+      return false;
+    const std::uint32_t sequence(control_->space_sequence.load(std::memory_order_acquire));
+    control_->sender_waiting.store(1, std::memory_order_seq_cst);
+    if (TrySend(data, size)) {
+      control_->sender_waiting.store(0, std::memory_order_relaxed);
+      return true;
+    }
+    if (!Closed())
+      Wait(control_->space_sequence, sequence, deadline);
+    control_->sender_waiting.store(0, std::memory_order_relaxed);
+  }
+  return true;
+}
+
+bool Channel::TryReceive(std::vector<byte>& message) {
+  const std::uint64_t read_position(control_->read_position.load(std::memory_order_relaxed));
+  if (read_position == cached_write_position_) {
+    cached_write_position_ = control_->write_position.load(std::memory_order_acquire);
+    if (read_position == cached_write_position_)
+      return false;
+  }
+
+  std::uint32_t size;
+  CopyOut(read_position, reinterpret_cast<byte*>(&size), sizeof(size));
+  if (size > cached_write_position_ - read_position - sizeof(size))
+    BOOST_THROW_EXCEPTION(MakeError(CommonErrors::parsing_error));
+  message.resize(size);
+  CopyOut(read_position + sizeof(size), message.data(), size);
+  control_->read_position.store(read_position + sizeof(size) + size, std::memory_order_seq_cst);
+  if (control_->sender_waiting.load(std::memory_order_seq_cst) != 0)
+    Wake(control_->space_sequence);
+  return true;
+}
+
+bool Channel::Receive(std::vector<byte>& message) {
+  return ReceiveUntil(message, std::chrono::steady_clock::time_point::max());
+}
+
+bool Channel::Receive(std::vector<byte>& message, std::chrono::steady_clock::duration timeout) {
+  return ReceiveUntil(message, std::chrono::steady_clock::now() + timeout);
+}
+
+bool Channel::ReceiveUntil(std::vector<byte>& message,
+                           std::chrono::steady_clock::time_point deadline) {
+  for (int i(0), spin_count(SpinCount()); i != spin_count; ++i) {
+    if (TryReceive(message))
+      return true;
+  }
+  while (!TryReceive(message)) {
+    // A message sent before the channel was closed is visible once 'closed' is.
+    if (Closed())
+      return TryReceive(message);
+    if (std::chrono::steady_clock::now() >= deadline)
+      return false;
+    const std::uint32_t sequence(control_->data_sequence.load(std::memory_order_acquire));
+    control_->receiver_waiting.store(1, std::memory_order_seq_cst);
+    if (TryReceive(message)) {
+      control_->receiver_waiting.store(0, std::memory_order_relaxed);
+      return true;
+    }
+    if (!Closed())
+      Wait(control_->data_sequence, sequence, deadline);
+    control_->receiver_waiting.store(0, std::memory_order_relaxed);
+  }
+  return true;
+}
+
+void Channel::Close() {
+  control_->closed.store(1, std::memory_order_seq_cst);
+  Wake(control_->data_sequence);
+  Wake(control_->space_sequence);
+}
+
+bool Channel::Closed() const { return control_->closed.load(std::memory_order_seq_cst) != 0; }
+
+void Channel::CopyIn(std::uint64_t position, const byte* data, std::size_t size) {
+  if (size == 0)
+    return;
+  const std::size_t index(static_cast<std::size_t>(position & (capacity_ - 1)));
+  const std::size_t first_part(std::min(size, capacity_ - index));
+  std::memcpy(ring_ + index, data, first_part);
+  if (first_part != size)
+    std::memcpy(ring_, data + first_part, size - first_part);
+}
+
+void Channel::CopyOut(std::uint64_t position, byte* data, std::size_t size) const {
+  if (size == 0)
+    return;
+  const std::size_t index(static_cast<std::size_t>(position & (capacity_ - 1)));
+  const std::size_t first_part(std::min(size, capacity_ - index));
+  std::memcpy(data, ring_ + index, first_part);
+  if (first_part != size)
+    std::memcpy(data + first_part, ring_, size - first_part);
+}
+
+}  // namespace ipc
+
+}  // namespace maidsafe
@@ -0,0 +1,421 @@
+/*  Copyright 2015 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#include "maidsafe/common/ipc/shared_cache.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <limits>
+#include <thread>
+
+#include "maidsafe/common/encode.h"
+#include "maidsafe/common/error.h"
+#include "maidsafe/common/log.h"
+#include "maidsafe/common/process.h"
+
+namespace bi = boost::interprocess;
+
+namespace maidsafe {
+
+namespace ipc {
+
+namespace detail {
+
+static_assert(ATOMIC_INT_LOCK_FREE == 2 && ATOMIC_LLONG_LOCK_FREE == 2,
+              "Shared memory synchronisation requires address-free lock-free atomics.");
+
+// Arena positions only ever increase; the offset into the arena is a position modulo the capacity.
+// 'head' and 'tail' are only modified by the writer holding the lock.
+struct CacheHeader {
+  CacheHeader(std::uint64_t capacity_in, std::uint64_t slot_count_in)
+      : writer(0),
+        index_version(0),
+        entry_count(0),
+        head(0),
+        tail(0),
+        capacity(capacity_in),
+        slot_count(slot_count_in) {}
+
+  // The process ID of the writer holding the lock, or 0.
+  std::atomic<std::uint64_t> writer;
+  // Incremented before any value is removed from or moved within the index, so that a reader
+  // which misses can tell whether the value might have been moved past it.
+  std::atomic<std::uint64_t> index_version;
+  std::atomic<std::uint64_t> entry_count, head, tail;
+  const std::uint64_t capacity, slot_count;
+};
+
+struct SlotContents {
+  std::uint64_t occupied, position, size;
+  std::uint32_t type_id;
+  byte name[identity_size];
+};
+
+// 'sequence' is odd while the contents are being written.  A reader copies the contents and only
+// trusts them if 'sequence' was even and unchanged throughout.
+struct CacheSlot {
+  CacheSlot() : sequence(0), contents() {}
+  std::atomic<std::uint32_t> sequence;
+  SlotContents contents;
+};
+
+}  // namespace detail
+
+namespace {
+
+const char kHeaderName[] = "header";
+const char kSlotsName[] = "slots";
+const char kArenaName[] = "arena";
+const std::uint64_t kMinCapacity = 4096;
+const std::uint64_t kMaxCapacity = std::uint64_t(64) << 30;
+// Room for the segment manager, its index and the allocation headers alongside the arrays.
+const std::uint64_t kSegmentOverhead = 4096;
+const std::uint64_t kNotFound = std::numeric_limits<std::uint64_t>::max();
+// A reader gives up (reporting a miss) after this many attempts spoiled by concurrent writes.
+const int kMaxReadAttempts = 16;
+
+// Precedes each value in the arena.  'slot' is the index slot referring to the value, or
+// 'kNotFound' if the block is padding or its value has been removed.
+struct BlockHeader {
+  std::uint64_t slot, length;
+};
+
+std::uint64_t SlotCount(std::uint64_t capacity) {
+  // Keep the index at most half full, so probe sequences stay short.
+  std::uint64_t slot_count(128);
+  while (slot_count < 2 * (capacity / 4096))
+    slot_count <<= 1;
+  return slot_count;
+}
+
+std::uint64_t BlockLength(std::uint64_t value_size) {
+  return (sizeof(BlockHeader) + value_size + sizeof(BlockHeader) - 1) & ~(sizeof(BlockHeader) - 1);
+}
+
+void BeginWrite(detail::CacheSlot& slot) {
+  // If a crashed writer left the sequence odd, it's left odd.
+  slot.sequence.store(slot.sequence.load(std::memory_order_relaxed) | 1,
+                      std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+}
+
+void EndWrite(detail::CacheSlot& slot) {
+  slot.sequence.store(slot.sequence.load(std::memory_order_relaxed) + 1,
+                      std::memory_order_release);
+}
+
+bool ReadSlot(const detail::CacheSlot& slot, detail::SlotContents& contents,
+              std::uint32_t& sequence) {
+  sequence = slot.sequence.load(std::memory_order_acquire);
+  if ((sequence & 1) != 0)
+    return false;
+  std::memcpy(&contents, &slot.contents, sizeof(contents));
+  std::atomic_thread_fence(std::memory_order_acquire);
+  return slot.sequence.load(std::memory_order_relaxed) == sequence;
+}
+
+bool Matches(const detail::SlotContents& contents, const SharedCache::KeyType& key) {
+  return contents.type_id == key.type_id.data &&
+         std::memcmp(contents.name, key.name.data(), identity_size) == 0;
+}
+
+// On POSIX this is 'kill(pid, 0)', which also succeeds for a zombie and for an unrelated process
+// which has since been given the same ID.  A dead writer's lock is then only taken over once its
+// parent has reaped it, or once the process reusing its ID exits.
+bool IsAlive(std::uint64_t process_id) {
+#ifdef MAIDSAFE_WIN32
+  HANDLE handle(OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION, FALSE,
+                            static_cast<DWORD>(process_id)));
+  if (handle == nullptr)
+    return false;
+  process::ManagedHandle managed_handle(handle);
+  return process::IsRunning(managed_handle.handle);
+#else
+  try {
+    return process::IsRunning(static_cast<pid_t>(process_id));
+  } catch (const std::exception&) {
+    // We're not permitted to signal it, so it exists.
+    return true;
+  }
+#endif
+}
+
+}  // unnamed namespace
+
+class SharedCache::WriterLock {
+ public:
+  explicit WriterLock(SharedCache& cache);
+  WriterLock(const WriterLock&) = delete;
+  WriterLock(WriterLock&&) = delete;
+  WriterLock& operator=(WriterLock) = delete;
+  ~WriterLock() { cache_.header_->writer.store(0, std::memory_order_release); }
+
+ private:
+  SharedCache& cache_;
+};
+
+SharedCache::WriterLock::WriterLock(SharedCache& cache) : cache_(cache) {
+  const std::uint64_t this_process(process::GetProcessId());
+  std::atomic<std::uint64_t>& writer(cache_.header_->writer);
+  for (unsigned attempt(1);; ++attempt) {
+    std::uint64_t holder(0);
+    if (writer.compare_exchange_weak(holder, this_process, std::memory_order_acquire))
+      return;
+    // Checking whether the holder is alive costs a system call, so isn't done on every attempt.
+    if (attempt % 1024 == 0 && holder != 0 && holder != this_process && !IsAlive(holder) &&
+        writer.compare_exchange_strong(holder, this_process, std::memory_order_acquire)) {
+      LOG(kWarning) << "Process " << holder << " died while writing to the shared cache; "
+                    << "clearing it.";
+      cache_.Clear();
+      return;
+    }
+    std::this_thread::yield();
+  }
+}
+
+SharedCache::SharedCache(const std::string& name, std::uint64_t capacity)
+    : segment_(), header_(nullptr), slots_(nullptr), arena_(nullptr) {
+  if (capacity < kMinCapacity || capacity > kMaxCapacity)
+    BOOST_THROW_EXCEPTION(MakeError(CommonErrors::invalid_argument));
+  capacity = BlockLength(capacity) - sizeof(BlockHeader);
+  const std::uint64_t slot_count(SlotCount(capacity));
+  segment_ = bi::managed_shared_memory(
+      bi::open_or_create, hex::Encode(name).c_str(),
+      static_cast<std::size_t>(capacity + slot_count * sizeof(detail::CacheSlot) +
+                               kSegmentOverhead));
+  // Whichever process gets here first constructs the cache, holding the segment's own lock so that
+  // no other process can see it partly constructed.
+  auto find_or_construct([&] {
+    header_ = segment_.find<detail::CacheHeader>(kHeaderName).first;
+    if (header_) {
+      slots_ = segment_.find<detail::CacheSlot>(kSlotsName).first;
+      arena_ = segment_.find<byte>(kArenaName).first;
+      return;
+    }
+    arena_ = segment_.construct<byte>(kArenaName)[static_cast<std::size_t>(capacity)](0);
+    slots_ = segment_.construct<detail::CacheSlot>(kSlotsName)[static_cast<std::size_t>(
+        slot_count)]();
+    header_ = segment_.construct<detail::CacheHeader>(kHeaderName)(capacity, slot_count);
+  });
+  segment_.atomic_func(find_or_construct);
+  if (!slots_ || !arena_)
+    BOOST_THROW_EXCEPTION(MakeError(CommonErrors::uninitialised));
+}
+
+void SharedCache::Remove(const std::string& name) {
+  bi::shared_memory_object::remove(hex::Encode(name).c_str());
+}
+
+void SharedCache::Store(const KeyType& key, boost::string_ref value) {
+  if (value.size() > MaxValueSize())
+    BOOST_THROW_EXCEPTION(MakeError(CommonErrors::cannot_exceed_limit));
+  const byte* const name(key.name.data());
+
+  WriterLock lock(*this);
+  if (Find(key) != kNotFound)
+    return;
+  const std::uint64_t capacity(header_->capacity);
+  const std::uint64_t length(BlockLength(value.size()));
+  std::uint64_t head(header_->head.load(std::memory_order_relaxed));
+  if (head % capacity + length > capacity) {
+    // A value is never split across the end of the arena, so that it can be read in place.
+    const std::uint64_t padding(capacity - head % capacity);
+    MakeSpace(padding);
+    const BlockHeader block{kNotFound, padding};
+    std::memcpy(arena_ + head % capacity, &block, sizeof(block));
+    head += padding;
+    header_->head.store(head, std::memory_order_relaxed);
+  }
+  MakeSpace(length);
+
+  std::uint64_t index(Home(key.name.data(), key.type_id.data));
+  while (slots_[index].contents.occupied != 0)
+    index = (index + 1) & (header_->slot_count - 1);
+  const BlockHeader block{index, length};
+  std::memcpy(arena_ + head % capacity, &block, sizeof(block));
+  std::memcpy(arena_ + head % capacity + sizeof(block), value.data(), value.size());
+
+  detail::CacheSlot& slot(slots_[index]);
+  BeginWrite(slot);
+  slot.contents.occupied = 1;
+  slot.contents.position = head;
+  slot.contents.size = value.size();
+  slot.contents.type_id = key.type_id.data;
+  std::memcpy(slot.contents.name, name, identity_size);
+  EndWrite(slot);
+  header_->head.store(head + length, std::memory_order_relaxed);
+  header_->entry_count.fetch_add(1, std::memory_order_relaxed);
+}
+
+bool SharedCache::Get(const KeyType& key,
+                      const std::function<void(boost::string_ref)>& reader) const {
+  const std::uint64_t capacity(header_->capacity), mask(header_->slot_count - 1);
+  const std::uint64_t home(Home(key.name.data(), key.type_id.data));
+  for (int attempt(0); attempt != kMaxReadAttempts; ++attempt) {
+    const std::uint64_t version(header_->index_version.load(std::memory_order_acquire));
+    bool spoiled(false);
+    for (std::uint64_t index(home), probes(0); probes <= mask;
+         index = (index + 1) & mask, ++probes) {
+      const detail::CacheSlot& slot(slots_[index]);
+      detail::SlotContents contents;
+      std::uint32_t sequence;
+      if (!ReadSlot(slot, contents, sequence)) {
+        spoiled = true;
+        break;
+      }
+      if (contents.occupied == 0)
+        break;
+      if (!Matches(contents, key))
+        continue;
+      const std::uint64_t offset(contents.position % capacity);
+      if (offset + sizeof(BlockHeader) + contents.size > capacity)
+        return false;
+      reader(boost::string_ref(reinterpret_cast<const char*>(arena_ + offset + sizeof(BlockHeader)),
+                               static_cast<std::size_t>(contents.size)));
+      // If the value was evicted while 'reader' ran, its bytes may have been overwritten.
+      std::atomic_thread_fence(std::memory_order_acquire);
+      return slot.sequence.load(std::memory_order_relaxed) == sequence;
+    }
+    if (!spoiled) {
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (header_->index_version.load(std::memory_order_relaxed) == version)
+        return false;
+    }
+  }
+  return false;
+}
+
+bool SharedCache::Get(const KeyType& key, std::string& value) const {
+  if (Get(key, [&value](boost::string_ref view) { value.assign(view.data(), view.size()); }))
+    return true;
+  value.clear();
+  return false;
+}
+
+void SharedCache::Delete(const KeyType& key) {
+  WriterLock lock(*this);
+  const std::uint64_t index(Find(key));
+  if (index != kNotFound)
+    RemoveSlot(index);
+}
+
+std::uint64_t SharedCache::Capacity() const { return header_->capacity; }
+
+std::uint64_t SharedCache::MaxValueSize() const { return header_->capacity - sizeof(BlockHeader); }
+
+std::uint64_t SharedCache::Size() const {
+  return header_->entry_count.load(std::memory_order_relaxed);
+}
+
+std::uint64_t SharedCache::UsedBytes() const {
+  return header_->head.load(std::memory_order_relaxed) -
+         header_->tail.load(std::memory_order_relaxed);
+}
+
+std::uint64_t SharedCache::Home(const byte* name, std::uint32_t type_id) const {
+  // Names are normally hashes already, so their leading bytes are as good as any hash of them.
+  std::uint64_t hash;
+  std::memcpy(&hash, name, sizeof(hash));
+  hash ^= type_id * 0x9e3779b97f4a7c15ULL;
+  return (hash ^ (hash >> 32)) & (header_->slot_count - 1);
+}
+
+std::uint64_t SharedCache::Find(const KeyType& key) const {
+  const std::uint64_t mask(header_->slot_count - 1);
+  for (std::uint64_t index(Home(key.name.data(), key.type_id.data));;
+       index = (index + 1) & mask) {
+    const detail::SlotContents& contents(slots_[index].contents);
+    if (contents.occupied == 0)
+      return kNotFound;
+    if (Matches(contents, key))
+      return index;
+  }
+}
+
+void SharedCache::MakeSpace(std::uint64_t required) {
+  const std::uint64_t max_entries(header_->slot_count / 2);
+  while (header_->head.load(std::memory_order_relaxed) + required -
+                 header_->tail.load(std::memory_order_relaxed) >
+             header_->capacity ||
+         header_->entry_count.load(std::memory_order_relaxed) >= max_entries) {
+    EvictOldest();
+  }
+}
+
+void SharedCache::EvictOldest() {
+  const std::uint64_t tail(header_->tail.load(std::memory_order_relaxed));
+  BlockHeader block;
+  std::memcpy(&block, arena_ + tail % header_->capacity, sizeof(block));
+  if (block.slot != kNotFound)
+    RemoveSlot(block.slot);
+  header_->tail.store(tail + block.length, std::memory_order_relaxed);
+}
+
+void SharedCache::RemoveSlot(std::uint64_t index) {
+  header_->index_version.store(header_->index_version.load(std::memory_order_relaxed) + 1,
+                               std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  // The value's block stays in the arena until evicted, but no longer refers to the index.
+  SetBlockSlot(slots_[index].contents.position, kNotFound);
+
+  // Backward-shift deletion, so that lookups never need tombstones: each later entry in the probe
+  // sequence is moved back into the gap unless its home slot lies after the gap.
+  const std::uint64_t mask(header_->slot_count - 1);
+  std::uint64_t gap(index);
+  for (std::uint64_t next((gap + 1) & mask);; next = (next + 1) & mask) {
+    const detail::SlotContents& contents(slots_[next].contents);
+    if (contents.occupied == 0)
+      break;
+    if (((next - Home(contents.name, contents.type_id)) & mask) < ((next - gap) & mask))
+      continue;
+    BeginWrite(slots_[gap]);
+    slots_[gap].contents = contents;
+    EndWrite(slots_[gap]);
+    SetBlockSlot(contents.position, gap);
+    gap = next;
+  }
+  BeginWrite(slots_[gap]);
+  slots_[gap].contents.occupied = 0;
+  EndWrite(slots_[gap]);
+  header_->entry_count.fetch_sub(1, std::memory_order_relaxed);
+}
+
+void SharedCache::SetBlockSlot(std::uint64_t position, std::uint64_t slot) {
+  std::memcpy(arena_ + position % header_->capacity, &slot, sizeof(slot));
+}
+
+void SharedCache::Clear() {
+  header_->index_version.store(header_->index_version.load(std::memory_order_relaxed) + 1,
+                               std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  for (std::uint64_t index(0); index != header_->slot_count; ++index) {
+    detail::CacheSlot& slot(slots_[index]);
+    if (slot.contents.occupied == 0 && (slot.sequence.load(std::memory_order_relaxed) & 1) == 0)
+      continue;
+    BeginWrite(slot);
+    slot.contents.occupied = 0;
+    EndWrite(slot);
+  }
+  header_->tail.store(header_->head.load(std::memory_order_relaxed), std::memory_order_relaxed);
+  header_->entry_count.store(0, std::memory_order_relaxed);
+}
+
+}  // namespace ipc
+
+}  // namespace maidsafe
@@ -0,0 +1,140 @@
+/*  Copyright 2015 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#include "maidsafe/common/ipc/channel.h"
+
+#include <chrono>
+#include <cstdint>
+#include <future>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "maidsafe/common/error.h"
+#include "maidsafe/common/test.h"
+#include "maidsafe/common/utils.h"
+
+namespace maidsafe {
+
+namespace ipc {
+
+namespace test {
+
+namespace {
+
+std::vector<byte> RandomMessage(std::size_t size) {
+  const std::string data(RandomString(size));
+  return std::vector<byte>(data.begin(), data.end());
+}
+
+}  // unnamed namespace
+
+TEST(ChannelTest, BEH_CreateAndOpen) {
+  const std::string name(RandomAlphaNumericString(8));
+  EXPECT_THROW(Channel{name}, boost::interprocess::interprocess_exception);
+  EXPECT_THROW(Channel(name, 63), maidsafe_error);
+  EXPECT_THROW(Channel(name, (1U << 30) + 1), maidsafe_error);
+
+  Channel sender(name, 1000);
+  EXPECT_EQ(sender.Capacity(), 1024U);
+  EXPECT_EQ(sender.MaxMessageSize(), 1020U);
+  Channel receiver(name);
+  EXPECT_EQ(receiver.Capacity(), 1024U);
+
+  // A message which exactly fills the ring fits; a larger one throws.
+  const std::vector<byte> largest(RandomMessage(sender.MaxMessageSize()));
+  EXPECT_THROW(sender.TrySend(largest.data(), largest.size() + 1), maidsafe_error);
+  EXPECT_TRUE(sender.TrySend(largest.data(), largest.size()));
+  EXPECT_FALSE(sender.TrySend(largest.data(), 0));
+  std::vector<byte> received;
+  EXPECT_TRUE(receiver.TryReceive(received));
+  EXPECT_EQ(received, largest);
+  EXPECT_FALSE(receiver.TryReceive(received));
+
+  // Empty messages are delivered too.
+  EXPECT_TRUE(sender.TrySend(nullptr, 0));
+  EXPECT_TRUE(receiver.TryReceive(received));
+  EXPECT_TRUE(received.empty());
+
+  // Removing the name doesn't affect channels which are already open.
+  Channel::Remove(name);
+  EXPECT_THROW(Channel{name}, boost::interprocess::interprocess_exception);
+  EXPECT_TRUE(sender.TrySend(largest.data(), 10));
+  EXPECT_TRUE(receiver.TryReceive(received));
+  EXPECT_EQ(received.size(), 10U);
+}
+
+TEST(ChannelTest, BEH_SendAndReceive) {
+  // Messages of assorted sizes wrap around a small ring many times over, with both ends often
+  // blocked waiting for the other.
+  const std::string name(RandomAlphaNumericString(8));
+  Channel sender(name, 512);
+  std::vector<std::vector<byte>> messages;
+  for (std::size_t i(0); i != 10000; ++i)
+    messages.emplace_back(RandomMessage(i % 300));
+
+  auto received_messages(std::async(std::launch::async, [&] {
+    Channel receiver(name);
+    std::vector<std::vector<byte>> received;
+    std::vector<byte> message;
+    while (receiver.Receive(message))
+      received.push_back(message);
+    return received;
+  }));
+  for (const auto& message : messages) {
+    ASSERT_TRUE(sender.Send(message.data(), message.size()));
+    if (message.size() == 299)
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  sender.Close();
+  EXPECT_EQ(received_messages.get(), messages);
+}
+
+TEST(ChannelTest, BEH_TimeoutsAndClose) {
+  const std::string name(RandomAlphaNumericString(8));
+  Channel receiver(name, 64);
+  Channel sender(name);
+  std::vector<byte> message;
+  auto start(std::chrono::steady_clock::now());
+  EXPECT_FALSE(receiver.Receive(message, std::chrono::milliseconds(20)));
+  EXPECT_GE(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(20));
+
+  const std::vector<byte> data(RandomMessage(40));
+  EXPECT_TRUE(sender.Send(data.data(), data.size(), std::chrono::milliseconds(20)));
+  start = std::chrono::steady_clock::now();
+  EXPECT_FALSE(sender.Send(data.data(), data.size(), std::chrono::milliseconds(20)));
+  EXPECT_GE(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(20));
+
+  // Closing wakes a blocked sender, but messages already sent can still be received.
+  auto blocked_send(std::async(std::launch::async,
+                               [&] { return sender.Send(data.data(), data.size()); }));
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  receiver.Close();
+  EXPECT_FALSE(blocked_send.get());
+  EXPECT_TRUE(sender.Closed());
+  EXPECT_FALSE(sender.TrySend(data.data(), 1));
+  EXPECT_TRUE(receiver.Receive(message));
+  EXPECT_EQ(message, data);
+  EXPECT_FALSE(receiver.Receive(message));
+}
+
+}  // namespace test
+
+}  // namespace ipc
+
+}  // namespace maidsafe
@@ -0,0 +1,264 @@
+/*  Copyright 2015 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#include "maidsafe/common/ipc/shared_cache.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifndef MAIDSAFE_WIN32
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+#include "maidsafe/common/encode.h"
+#include "maidsafe/common/error.h"
+#include "maidsafe/common/test.h"
+#include "maidsafe/common/utils.h"
+
+namespace maidsafe {
+
+namespace ipc {
+
+namespace test {
+
+namespace {
+
+using KeyType = SharedCache::KeyType;
+
+KeyType GenerateRandomKey() { return KeyType(MakeIdentity(), DataTypeId(RandomUint32())); }
+
+// A value which can be checked against its key.
+std::string ValueFor(const KeyType& key) {
+  return std::string(100 + 20 * key.name.data()[0], static_cast<char>(key.name.data()[1]));
+}
+
+struct CacheRemover {
+  explicit CacheRemover(std::string name_in) : name(std::move(name_in)) {
+    SharedCache::Remove(name);
+  }
+  ~CacheRemover() { SharedCache::Remove(name); }
+  const std::string name;
+};
+
+}  // unnamed namespace
+
+TEST(SharedCacheTest, BEH_StoreGetAndDelete) {
+  CacheRemover remover(RandomAlphaNumericString(12));
+  EXPECT_THROW(SharedCache(remover.name, 4095), maidsafe_error);
+  SharedCache cache(remover.name, 1024 * 1024);
+  EXPECT_EQ(cache.Capacity(), 1024 * 1024U);
+  EXPECT_THROW(cache.Store(KeyType(), "a"), maidsafe_error);
+  EXPECT_THROW(cache.Store(GenerateRandomKey(), std::string(cache.MaxValueSize() + 1, 'a')),
+               maidsafe_error);
+
+  std::vector<KeyType> keys;
+  for (int i(0); i != 100; ++i) {
+    keys.push_back(GenerateRandomKey());
+    cache.Store(keys.back(), ValueFor(keys.back()));
+  }
+  EXPECT_EQ(cache.Size(), keys.size());
+
+  // Another instance, as another process would use, sees the same values in place.
+  SharedCache other(remover.name, 4096);
+  EXPECT_EQ(other.Capacity(), 1024 * 1024U);
+  for (const auto& key : keys) {
+    std::string value;
+    EXPECT_TRUE(other.Get(key, value));
+    EXPECT_EQ(value, ValueFor(key));
+    const char* first_view(nullptr);
+    const char* second_view(nullptr);
+    EXPECT_TRUE(cache.Get(key, [&](boost::string_ref view) { first_view = view.data(); }));
+    EXPECT_TRUE(other.Get(key, [&](boost::string_ref view) { second_view = view.data(); }));
+    EXPECT_EQ(std::string(first_view, value.size()), value);
+    EXPECT_NE(first_view, value.data());
+  }
+
+  // Storing an existing key is a no-op, since values are immutable.
+  const std::uint64_t used_bytes(cache.UsedBytes());
+  cache.Store(keys.front(), "different");
+  EXPECT_EQ(cache.UsedBytes(), used_bytes);
+
+  // Deleting leaves every other value reachable.
+  std::string value;
+  const KeyType missing(GenerateRandomKey());
+  EXPECT_FALSE(cache.Get(missing, value));
+  EXPECT_TRUE(value.empty());
+  EXPECT_FALSE(cache.Get(missing, [](boost::string_ref) { ADD_FAILURE(); }));
+  cache.Delete(missing);
+  for (std::size_t i(0); i < keys.size(); i += 2)
+    other.Delete(keys[i]);
+  EXPECT_EQ(cache.Size(), keys.size() / 2);
+  for (std::size_t i(0); i < keys.size(); ++i)
+    EXPECT_EQ(cache.Get(keys[i], value), i % 2 == 1);
+}
+
+TEST(SharedCacheTest, BEH_Eviction) {
+  CacheRemover remover(RandomAlphaNumericString(12));
+  SharedCache cache(remover.name, 64 * 1024);
+
+  // The arena holds bytes, not entries, so the oldest values are evicted to fit new ones.
+  std::vector<KeyType> keys;
+  for (int i(0); i != 1000; ++i) {
+    keys.push_back(GenerateRandomKey());
+    cache.Store(keys.back(), ValueFor(keys.back()));
+    EXPECT_LE(cache.UsedBytes(), cache.Capacity());
+  }
+  std::string value;
+  EXPECT_TRUE(cache.Get(keys.back(), value));
+  EXPECT_EQ(value, ValueFor(keys.back()));
+  EXPECT_FALSE(cache.Get(keys.front(), value));
+  const auto present(std::count_if(keys.begin(), keys.end(), [&](const KeyType& key) {
+    return cache.Get(key, value) && value == ValueFor(key);
+  }));
+  EXPECT_EQ(static_cast<std::uint64_t>(present), cache.Size());
+  EXPECT_GT(cache.Size(), 10U);
+
+  // The index is bounded too: its capacity is one value per 4 KiB, with a minimum of 64.
+  for (int i(0); i != 1000; ++i)
+    cache.Store(GenerateRandomKey(), "a");
+  EXPECT_EQ(cache.Size(), 64U);
+
+  // A value the size of the whole arena evicts everything else.
+  const KeyType large_key(GenerateRandomKey());
+  cache.Store(large_key, std::string(cache.MaxValueSize(), 'a'));
+  EXPECT_EQ(cache.Size(), 1U);
+  EXPECT_TRUE(cache.Get(large_key, value));
+  EXPECT_EQ(value.size(), cache.MaxValueSize());
+}
+
+TEST(SharedCacheTest, BEH_ConcurrentReadersAndWriters) {
+  // Readers never see a value which doesn't match its key, even while writers are evicting and
+  // overwriting values under them.
+  CacheRemover remover(RandomAlphaNumericString(12));
+  SharedCache cache(remover.name, 128 * 1024);
+  std::vector<KeyType> keys;
+  for (int i(0); i != 500; ++i)
+    keys.push_back(GenerateRandomKey());
+
+  std::atomic<bool> stop(false);
+  std::atomic<int> hits(0), corrupt(0);
+  std::vector<std::thread> threads;
+  for (int i(0); i != 2; ++i) {
+    threads.emplace_back([&, i] {
+      SharedCache writer(remover.name, 4096);
+      for (int j(0); j != 20000; ++j) {
+        const KeyType& key(keys[(j * 7 + i) % keys.size()]);
+        if (j % 5 == 0)
+          writer.Delete(key);
+        else
+          writer.Store(key, ValueFor(key));
+      }
+    });
+  }
+  for (int i(0); i != 2; ++i) {
+    threads.emplace_back([&] {
+      SharedCache reader(remover.name, 4096);
+      std::string value;
+      while (!stop) {
+        for (const auto& key : keys) {
+          if (reader.Get(key, value)) {
+            ++hits;
+            if (value != ValueFor(key))
+              ++corrupt;
+          }
+        }
+      }
+    });
+  }
+  threads[0].join();
+  threads[1].join();
+  stop = true;
+  threads[2].join();
+  threads[3].join();
+  EXPECT_GT(hits, 0);
+  EXPECT_EQ(corrupt, 0);
+}
+
+#ifndef MAIDSAFE_WIN32
+TEST(SharedCacheTest, BEH_ReaderCrash) {
+  CacheRemover remover(RandomAlphaNumericString(12));
+  SharedCache cache(remover.name, 64 * 1024);
+  const KeyType key(GenerateRandomKey());
+  cache.Store(key, ValueFor(key));
+
+  // A reader dying part way through reading a value leaves nothing locked.
+  const pid_t child(fork());
+  ASSERT_NE(child, -1);
+  if (child == 0) {
+    SharedCache child_cache(remover.name, 4096);
+    child_cache.Get(key, [](boost::string_ref) { _exit(0); });
+    _exit(1);
+  }
+  int status(0);
+  ASSERT_EQ(waitpid(child, &status, 0), child);
+  EXPECT_EQ(WEXITSTATUS(status), 0);
+
+  std::string value;
+  EXPECT_TRUE(cache.Get(key, value));
+  const KeyType other_key(GenerateRandomKey());
+  cache.Store(other_key, ValueFor(other_key));
+  EXPECT_TRUE(cache.Get(other_key, value));
+  EXPECT_EQ(value, ValueFor(other_key));
+}
+
+TEST(SharedCacheTest, BEH_WriterCrash) {
+  CacheRemover remover(RandomAlphaNumericString(12));
+  SharedCache cache(remover.name, 64 * 1024);
+  const KeyType key(GenerateRandomKey());
+  cache.Store(key, ValueFor(key));
+
+  // The writer lock is the first member of the cache's header.  The child takes it and exits
+  // without releasing it, as a writer crashing part way through a store would.
+  const pid_t child(fork());
+  ASSERT_NE(child, -1);
+  if (child == 0) {
+    boost::interprocess::managed_shared_memory segment(boost::interprocess::open_only,
+                                                       hex::Encode(remover.name).c_str());
+    std::atomic<std::uint64_t>* const writer(
+        segment.find<std::atomic<std::uint64_t>>("header").first);
+    std::uint64_t unlocked(0);
+    _exit(writer && writer->compare_exchange_strong(unlocked, getpid()) ? 0 : 1);
+  }
+  int status(0);
+  ASSERT_EQ(waitpid(child, &status, 0), child);
+  ASSERT_EQ(WEXITSTATUS(status), 0);
+
+  // The next writer takes the lock over and clears the cache, then carries on as normal.
+  const KeyType other_key(GenerateRandomKey());
+  cache.Store(other_key, ValueFor(other_key));
+  std::string value;
+  EXPECT_FALSE(cache.Get(key, value));
+  EXPECT_TRUE(cache.Get(other_key, value));
+  EXPECT_EQ(value, ValueFor(other_key));
+  EXPECT_EQ(cache.Size(), 1U);
+  cache.Store(key, ValueFor(key));
+  EXPECT_TRUE(cache.Get(key, value));
+  EXPECT_EQ(cache.Size(), 2U);
+}
+#endif
+
+}  // namespace test
+
+}  // namespace ipc
+
+}  // namespace maidsafe
@@ -0,0 +1,142 @@
+/*  Copyright 2015 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#include "maidsafe/common/serialisation/compact_archive.h"
+
+#include <cstdint>
+#include <limits>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "maidsafe/common/error.h"
+#include "maidsafe/common/test.h"
+#include "maidsafe/common/utils.h"
+#include "maidsafe/common/data_types/data.h"
+#include "maidsafe/common/data_types/immutable_data.h"
+#include "maidsafe/common/serialisation/serialisation.h"
+
+namespace maidsafe {
+
+namespace test {
+
+namespace {
+
+template <typename T>
+void CheckLimits() {
+  const std::vector<T> values{std::numeric_limits<T>::min(), std::numeric_limits<T>::max(),
+                              T(0), T(1), T(127), T(128), static_cast<T>(-1)};
+  for (const auto& value : values) {
+    const SerialisedData serialised(SerialiseCompact(value));
+    EXPECT_EQ(value, ParseCompact<T>(serialised)) << "value " << +value;
+  }
+}
+
+}  // unnamed namespace
+
+TEST(CompactArchiveTest, BEH_VarintEncoding) {
+  EXPECT_EQ(SerialisedData{0x00}, SerialiseCompact(std::uint64_t{0}));
+  EXPECT_EQ(SerialisedData{0x7F}, SerialiseCompact(std::uint32_t{127}));
+  EXPECT_EQ((SerialisedData{0x80, 0x01}), SerialiseCompact(std::uint16_t{128}));
+  EXPECT_EQ((SerialisedData{0xAC, 0x02}), SerialiseCompact(std::uint64_t{300}));
+  EXPECT_EQ(10U, SerialiseCompact(std::numeric_limits<std::uint64_t>::max()).size());
+
+  // Signed values are zigzag-encoded, so small negative numbers stay small.
+  EXPECT_EQ(SerialisedData{0x00}, SerialiseCompact(std::int32_t{0}));
+  EXPECT_EQ(SerialisedData{0x01}, SerialiseCompact(std::int32_t{-1}));
+  EXPECT_EQ(SerialisedData{0x02}, SerialiseCompact(std::int64_t{1}));
+  EXPECT_EQ(SerialisedData{0x03}, SerialiseCompact(std::int16_t{-2}));
+
+  // Single-byte, boolean and floating point types are written unchanged.
+  EXPECT_EQ(SerialisedData{0xFF}, SerialiseCompact(std::uint8_t{0xFF}));
+  EXPECT_EQ(SerialisedData{0x01}, SerialiseCompact(true));
+  EXPECT_EQ(sizeof(double), SerialiseCompact(1.5).size());
+
+  // Size tags are varints too: one byte for the size, then the raw characters.
+  EXPECT_EQ((SerialisedData{0x03, 'a', 'b', 'c'}), SerialiseCompact(std::string("abc")));
+  EXPECT_EQ(SerialisedData{0x00}, SerialiseCompact(std::vector<std::uint32_t>()));
+}
+
+TEST(CompactArchiveTest, BEH_RoundTrip) {
+  CheckLimits<std::int16_t>();
+  CheckLimits<std::uint16_t>();
+  CheckLimits<std::int32_t>();
+  CheckLimits<std::uint32_t>();
+  CheckLimits<std::int64_t>();
+  CheckLimits<std::uint64_t>();
+  CheckLimits<std::int8_t>();
+  CheckLimits<std::uint8_t>();
+
+  const std::map<std::uint32_t, std::vector<std::string>> mapped{
+      {1, {RandomString(10), RandomString(200)}}, {1000000, {}}};
+  const Data::NameAndTypeId name_and_type_id(MakeIdentity(), DataTypeId(RandomUint32()));
+  const ImmutableData data(NonEmptyString(RandomBytes(1000)));
+  const std::unique_ptr<Data> data_ptr(new ImmutableData(data));
+  const double number(RandomInt32() / 3.0);
+
+  const SerialisedData serialised(
+      SerialiseCompact(mapped, name_and_type_id, data, data_ptr, number));
+  EXPECT_GT(Serialise(mapped, name_and_type_id, data, data_ptr, number).size(),
+            serialised.size());
+
+  std::map<std::uint32_t, std::vector<std::string>> parsed_mapped;
+  Data::NameAndTypeId parsed_name_and_type_id;
+  ImmutableData parsed_data;
+  std::unique_ptr<Data> parsed_data_ptr;
+  double parsed_number(0);
+  ParseCompact(serialised, parsed_mapped, parsed_name_and_type_id, parsed_data, parsed_data_ptr,
+               parsed_number);
+  EXPECT_EQ(mapped, parsed_mapped);
+  EXPECT_EQ(name_and_type_id, parsed_name_and_type_id);
+  EXPECT_EQ(data.Value(), parsed_data.Value());
+  ASSERT_NE(nullptr, dynamic_cast<ImmutableData*>(parsed_data_ptr.get()));
+  EXPECT_EQ(data.Value(), dynamic_cast<ImmutableData*>(parsed_data_ptr.get())->Value());
+  EXPECT_EQ(number, parsed_number);
+}
+
+TEST(CompactArchiveTest, BEH_InvalidInput) {
+  // Truncated varint
+  EXPECT_THROW(ParseCompact<std::uint32_t>(SerialisedData{0x80}), cereal::Exception);
+  EXPECT_THROW(ParseCompact<std::uint32_t>(SerialisedData()), cereal::Exception);
+
+  // Varints longer than 64 bits
+  SerialisedData too_long(10, 0xFF);
+  too_long.push_back(0x01);
+  EXPECT_THROW(ParseCompact<std::uint64_t>(too_long), cereal::Exception);
+  too_long.resize(10);
+  too_long.back() = 0x02;
+  EXPECT_THROW(ParseCompact<std::uint64_t>(too_long), cereal::Exception);
+  too_long.back() = 0x01;
+  EXPECT_EQ(std::numeric_limits<std::uint64_t>::max(), ParseCompact<std::uint64_t>(too_long));
+
+  // Values out of range for the type being parsed
+  const SerialisedData large(SerialiseCompact(std::uint32_t{70000}));
+  EXPECT_THROW(ParseCompact<std::uint16_t>(large), cereal::Exception);
+  EXPECT_THROW(ParseCompact<std::int16_t>(SerialiseCompact(std::int32_t{-40000})),
+               cereal::Exception);
+
+  // A size tag claiming more data than there is
+  SerialisedData short_string(SerialiseCompact(std::string(100, 'a')));
+  short_string.pop_back();
+  EXPECT_THROW(ParseCompact<std::string>(short_string), cereal::Exception);
+}
+
+}  // namespace test
+
+}  // namespace maidsafe
@@ -0,0 +1,255 @@
+/*  Copyright 2015 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#include "maidsafe/common/serialisation/serialisation.h"
+
+#include <cstdint>
+#include <limits>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "maidsafe/common/error.h"
+#include "maidsafe/common/identity.h"
+#include "maidsafe/common/test.h"
+#include "maidsafe/common/utils.h"
+#include "maidsafe/common/data_types/data.h"
+#include "maidsafe/common/data_types/immutable_data.h"
+
+namespace maidsafe {
+
+namespace test {
+
+namespace {
+
+// The original stream-based serialisation, which the buffer-based functions must match exactly.
+template <typename... TypesToSerialise>
+SerialisedData StreamSerialise(const TypesToSerialise&... objects_to_serialise) {
+  OutputVectorStream binary_output_stream;
+  return ConvertToVectorStream(binary_output_stream, objects_to_serialise...).vector();
+}
+
+// Counts how often it's saved, standing in for a type whose save function is expensive.
+struct CountedSave {
+  template <typename Archive>
+  void save(Archive& archive) const {
+    ++save_count;
+    archive(value);
+  }
+  std::string value;
+  mutable int save_count;
+};
+
+}  // unnamed namespace
+
+TEST(SerialisationTest, BEH_SerialisedSize) {
+  EXPECT_EQ(sizeof(std::uint32_t), SerialisedSize(std::uint32_t{7}));
+  EXPECT_EQ(sizeof(std::uint64_t) + 3, SerialisedSize(std::string("abc")));
+
+  const std::vector<std::uint16_t> numbers(100, 9);
+  const std::map<std::string, std::vector<byte>> mapped{
+      {RandomString(10), RandomBytes(100)}, {RandomString(20), RandomBytes(0)}};
+  const Data::NameAndTypeId name_and_type_id(MakeIdentity(), DataTypeId(RandomUint32()));
+  const ImmutableData immutable_data(NonEmptyString(RandomBytes(1000)));
+  const std::unique_ptr<Data> data_ptr(new ImmutableData(immutable_data));
+
+  EXPECT_EQ(StreamSerialise(numbers).size(), SerialisedSize(numbers));
+  EXPECT_EQ(StreamSerialise(mapped).size(), SerialisedSize(mapped));
+  EXPECT_EQ(StreamSerialise(name_and_type_id).size(), SerialisedSize(name_and_type_id));
+  EXPECT_EQ(StreamSerialise(immutable_data).size(), SerialisedSize(immutable_data));
+  EXPECT_EQ(StreamSerialise(data_ptr).size(), SerialisedSize(data_ptr));
+  EXPECT_EQ(StreamSerialise(numbers, mapped, immutable_data).size(),
+            SerialisedSize(numbers, mapped, immutable_data));
+
+  // Sizing must fail in the same way as serialising.
+  EXPECT_THROW(SerialisedSize(Data::NameAndTypeId()), common_error);
+}
+
+TEST(SerialisationTest, BEH_SerialiseInto) {
+  const ImmutableData small_data(NonEmptyString(RandomBytes(100)));
+  const ImmutableData large_data(NonEmptyString(RandomBytes(10000)));
+  const std::vector<std::string> strings{RandomString(1), RandomString(10), RandomString(100)};
+
+  SerialisedData buffer;
+  SerialiseInto(buffer, large_data);
+  EXPECT_EQ(StreamSerialise(large_data), buffer);
+  EXPECT_EQ(Serialise(large_data), buffer);
+  const byte* const allocation(buffer.data());
+  const std::size_t capacity(buffer.capacity());
+
+  // Reusing the buffer for smaller output replaces its contents without reallocating.
+  SerialiseInto(buffer, small_data, strings);
+  EXPECT_EQ(StreamSerialise(small_data, strings), buffer);
+  EXPECT_EQ(allocation, buffer.data());
+  EXPECT_EQ(capacity, buffer.capacity());
+
+  ImmutableData parsed_data;
+  std::vector<std::string> parsed_strings;
+  Parse(buffer, parsed_data, parsed_strings);
+  EXPECT_EQ(small_data.Value(), parsed_data.Value());
+  EXPECT_EQ(strings, parsed_strings);
+
+  // A failure leaves the buffer in a valid state which can still be reused.
+  EXPECT_THROW(SerialiseInto(buffer, Data::NameAndTypeId()), common_error);
+  SerialiseInto(buffer, strings);
+  EXPECT_EQ(strings, Parse<std::vector<std::string>>(buffer));
+}
+
+TEST(SerialisationTest, BEH_SavePasses) {
+  // Serialise and ConvertToString make a single pass, while SerialiseInto sizes the output first.
+  const CountedSave counted{RandomString(100), 0};
+  const SerialisedData serialised(Serialise(counted));
+  EXPECT_EQ(1, counted.save_count);
+  EXPECT_EQ(StreamSerialise(counted.value), serialised);
+  SerialisedData buffer;
+  SerialiseInto(buffer, counted);
+  EXPECT_EQ(3, counted.save_count);
+  EXPECT_EQ(serialised, buffer);
+  const std::string converted(ConvertToString(counted));
+  EXPECT_EQ(4, counted.save_count);
+  EXPECT_EQ(std::string(serialised.begin(), serialised.end()), converted);
+}
+
+TEST(SerialisationTest, BEH_FixedBufferOverflow) {
+  const std::vector<byte> bytes(RandomBytes(64));
+  const std::size_t size(SerialisedSize(bytes));
+  std::vector<byte> region(size + 1, 0xFF);
+
+  {
+    BinaryOutputArchive binary_output_archive(region.data(), region.data() + size);
+    binary_output_archive(bytes);
+    EXPECT_EQ(size, binary_output_archive.bytesWritten());
+  }
+  EXPECT_EQ(0xFF, region.back());
+  region.pop_back();
+  EXPECT_EQ(bytes, Parse<std::vector<byte>>(region));
+
+  BinaryOutputArchive binary_output_archive(region.data(), region.data() + size - 1);
+  EXPECT_THROW(binary_output_archive(bytes), cereal::Exception);
+}
+
+TEST(SerialisationTest, BEH_ParseInPlace) {
+  const std::vector<std::string> strings{RandomString(1), RandomString(10), RandomString(100)};
+  const ImmutableData data(NonEmptyString(RandomBytes(1000)));
+  const SerialisedData serialised(Serialise(strings, data));
+
+  // Embed the serialised objects in the middle of a larger buffer and parse them from there.
+  const std::size_t offset(37);
+  std::vector<byte> frame(RandomBytes(offset));
+  frame.insert(frame.end(), serialised.begin(), serialised.end());
+  const std::vector<byte> trailer(RandomBytes(50));
+  frame.insert(frame.end(), trailer.begin(), trailer.end());
+
+  std::vector<std::string> parsed_strings;
+  ImmutableData parsed_data;
+  Parse(frame.data() + offset, serialised.size(), parsed_strings, parsed_data);
+  EXPECT_EQ(strings, parsed_strings);
+  EXPECT_EQ(data.Value(), parsed_data.Value());
+  EXPECT_EQ(strings, Parse<std::vector<std::string>>(frame.data() + offset, serialised.size()));
+
+  // Reading past the end of the span must fail rather than run into the trailer.
+  const std::size_t strings_size(SerialisedSize(strings));
+  EXPECT_THROW(Parse<std::vector<std::string>>(frame.data() + offset, strings_size - 1),
+               cereal::Exception);
+  EXPECT_THROW(Parse<ImmutableData>(frame.data() + offset + strings_size,
+                                    serialised.size() - strings_size - 1),
+               common_error);
+  EXPECT_THROW(Parse<std::uint32_t>(frame.data(), 0), cereal::Exception);
+}
+
+namespace {
+
+// Checks that 'container' is serialised as a 64-bit size tag followed by its raw elements, and that
+// it parses back both in place and via a stream.
+template <typename Container>
+void CheckContiguous(const Container& container) {
+  const std::uint64_t size_tag(container.size());
+  SerialisedData expected(reinterpret_cast<const byte*>(&size_tag),
+                          reinterpret_cast<const byte*>(&size_tag) + sizeof(size_tag));
+  expected.insert(expected.end(), reinterpret_cast<const byte*>(container.data()),
+                  reinterpret_cast<const byte*>(container.data() + container.size()));
+  const SerialisedData serialised(Serialise(container));
+  EXPECT_EQ(expected, serialised);
+  EXPECT_EQ(expected.size(), SerialisedSize(container));
+  EXPECT_EQ(container, Parse<Container>(serialised));
+  InputVectorStream binary_input_stream{serialised};
+  EXPECT_EQ(container, Parse<Container>(binary_input_stream));
+}
+
+}  // unnamed namespace
+
+TEST(SerialisationTest, BEH_ContiguousPayloads) {
+  for (const std::size_t size : {0, 1, 1000, 1024 * 1024}) {
+    const std::vector<byte> bytes(RandomBytes(size));
+    CheckContiguous(bytes);
+    CheckContiguous(std::string(bytes.begin(), bytes.end()));
+    CheckContiguous(std::vector<std::uint64_t>(size / 8, RandomUint32()));
+    CheckContiguous(std::vector<std::int16_t>(size / 2, static_cast<std::int16_t>(RandomInt32())));
+    CheckContiguous(std::vector<double>(size / 8, RandomInt32() / 7.0));
+  }
+
+  const Identity identity(MakeIdentity());
+  const SerialisedData serialised_identity(Serialise(identity));
+  EXPECT_EQ(Serialise(identity.string()), serialised_identity);
+  EXPECT_EQ(identity, Parse<Identity>(serialised_identity));
+
+  // A size tag larger than the remaining input must be rejected before anything is allocated.
+  SerialisedData huge(Serialise(std::numeric_limits<std::uint64_t>::max() / 16));
+  huge.resize(huge.size() + 64, 'A');
+  EXPECT_THROW(Parse<std::vector<std::uint64_t>>(huge), cereal::Exception);
+  EXPECT_THROW(Parse<std::string>(huge), cereal::Exception);
+  EXPECT_THROW(Parse<Identity>(huge), common_error);
+}
+
+TEST(SerialisationTest, BEH_ConvertToAndFromString) {
+  const std::vector<std::string> strings{RandomString(1), RandomString(10), RandomString(100)};
+  const std::map<std::uint32_t, std::string> mapped{{1, RandomString(50)}, {2, std::string()}};
+  const Data::NameAndTypeId name_and_type_id(MakeIdentity(), DataTypeId(RandomUint32()));
+
+  // The output must match that of the stream-based functions.
+  std::stringstream stream;
+  const std::string serialised(ConvertToString(strings, mapped, name_and_type_id));
+  EXPECT_EQ(ConvertToString(stream, strings, mapped, name_and_type_id), serialised);
+  const SerialisedData serialised_data(Serialise(strings, mapped, name_and_type_id));
+  EXPECT_EQ(std::string(serialised_data.begin(), serialised_data.end()), serialised);
+
+  std::vector<std::string> parsed_strings;
+  std::map<std::uint32_t, std::string> parsed_mapped;
+  Data::NameAndTypeId parsed_name_and_type_id;
+  ConvertFromString(serialised, parsed_strings, parsed_mapped, parsed_name_and_type_id);
+  EXPECT_EQ(strings, parsed_strings);
+  EXPECT_EQ(mapped, parsed_mapped);
+  EXPECT_EQ(name_and_type_id, parsed_name_and_type_id);
+
+  const std::string serialised_strings(ConvertToString(strings));
+  std::stringstream source_stream{serialised_strings};
+  EXPECT_EQ(strings, ConvertFromStream<std::vector<std::string>>(source_stream));
+  EXPECT_EQ(strings, ConvertFromString<std::vector<std::string>>(serialised_strings));
+  parsed_strings.clear();
+  EXPECT_EQ(strings, ConvertFromString(serialised_strings, parsed_strings));
+
+  EXPECT_THROW(ConvertFromString<std::vector<std::string>>(
+                   serialised_strings.substr(0, serialised_strings.size() - 1)),
+               cereal::Exception);
+}
+
+}  // namespace test
+
+}  // namespace maidsafe
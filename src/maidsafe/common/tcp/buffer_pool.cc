@@ -0,0 +1,81 @@
+/*  Copyright 2015 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#include "maidsafe/common/tcp/buffer_pool.h"
+
+#include <algorithm>
+#include <utility>
+
+namespace maidsafe {
+
+namespace tcp {
+
+BufferPool::BufferPool(std::size_t max_buffers, std::size_t max_bytes)
+    : kMaxBuffers_(max_buffers), kMaxBytes_(max_bytes), buffers_(), bytes_(0), mutex_() {
+  buffers_.reserve(kMaxBuffers_);
+}
+
+Message BufferPool::Acquire(std::size_t size) {
+  Message buffer;
+  {
+    std::lock_guard<std::mutex> lock{mutex_};
+    // Take the smallest buffer which is large enough.  If none is, a new one is allocated rather
+    // than reallocating a cached one, which would copy its stale contents.
+    auto best(std::end(buffers_));
+    for (auto itr(std::begin(buffers_)); itr != std::end(buffers_); ++itr) {
+      if (itr->capacity() >= size &&
+          (best == std::end(buffers_) || itr->capacity() < best->capacity())) {
+        best = itr;
+      }
+    }
+    if (best != std::end(buffers_)) {
+      bytes_ -= best->capacity();
+      buffer.swap(*best);
+      if (best != std::end(buffers_) - 1)
+        best->swap(buffers_.back());
+      buffers_.pop_back();
+    }
+  }
+  buffer.resize(size);
+  return buffer;
+}
+
+void BufferPool::Recycle(Message buffer) {
+  if (buffer.capacity() == 0 || buffer.capacity() > kMaxBytes_)
+    return;
+  buffer.clear();
+  std::lock_guard<std::mutex> lock{mutex_};
+  if (buffers_.size() < kMaxBuffers_ && bytes_ + buffer.capacity() <= kMaxBytes_) {
+    bytes_ += buffer.capacity();
+    buffers_.emplace_back(std::move(buffer));
+  }
+}
+
+std::size_t BufferPool::Size() const {
+  std::lock_guard<std::mutex> lock{mutex_};
+  return buffers_.size();
+}
+
+std::size_t BufferPool::Bytes() const {
+  std::lock_guard<std::mutex> lock{mutex_};
+  return bytes_;
+}
+
+}  // namespace tcp
+
+}  // namespace maidsafe
@@ -0,0 +1,238 @@
+/*  Copyright 2015 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#include "maidsafe/common/tcp/compression.h"
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+
+namespace maidsafe {
+
+namespace tcp {
+
+namespace detail {
+
+namespace {
+
+const std::size_t kMinMatch = 4;
+// As the LZ4 block format requires, the last match starts at least 'kMatchStartLimit' bytes
+// before the end of the input, and the last 'kLastLiterals' bytes are always literals.
+const std::size_t kMatchStartLimit = 12;
+const std::size_t kLastLiterals = 5;
+const std::size_t kMaxOffset = 65535;
+const unsigned kHashBits = 12;
+// After every 2^kSkipTrigger failed probes in a row, the step to the next probe grows by a byte.
+const unsigned kSkipTrigger = 6;
+const unsigned kLengthBits = 4;
+const std::size_t kMaxLengthInToken = (1U << kLengthBits) - 1;
+
+std::uint32_t Read32(const byte* data) {
+  std::uint32_t value;
+  std::memcpy(&value, data, sizeof(value));
+  return value;
+}
+
+std::uint64_t Read64(const byte* data) {
+  std::uint64_t value;
+  std::memcpy(&value, data, sizeof(value));
+  return value;
+}
+
+std::uint32_t Hash(std::uint32_t sequence) {
+  return (sequence * 2654435761U) >> (32 - kHashBits);
+}
+
+// The number of bytes used to encode a length which didn't fit in its token nibble.
+std::size_t ExtraLengthBytes(std::size_t length) {
+  return length < kMaxLengthInToken ? 0 : (length - kMaxLengthInToken) / 255 + 1;
+}
+
+byte* WriteExtraLength(byte* output, std::size_t length) {
+  length -= kMaxLengthInToken;
+  for (; length >= 255; length -= 255)
+    *output++ = 255;
+  *output++ = static_cast<byte>(length);
+  return output;
+}
+
+bool ReadExtraLength(const byte*& input, const byte* input_end, std::size_t& length) {
+  byte next;
+  do {
+    if (input == input_end)
+      return false;
+    next = *input++;
+    length += next;
+  } while (next == 255);
+  return true;
+}
+
+// Writes a sequence of 'literal_count' literals from 'literals', followed (unless 'offset' is 0,
+// for the final sequence) by a match of 'match_length' bytes at 'offset'.  Returns nullptr if it
+// doesn't fit before 'output_end'.
+byte* WriteSequence(byte* output, byte* output_end, const byte* literals,
+                    std::size_t literal_count, std::size_t offset, std::size_t match_length) {
+  const std::size_t extra_match_length(match_length - kMinMatch);
+  const std::size_t required(1 + ExtraLengthBytes(literal_count) + literal_count +
+                             (offset == 0 ? 0 : 2 + ExtraLengthBytes(extra_match_length)));
+  if (static_cast<std::size_t>(output_end - output) < required)
+    return nullptr;
+
+  byte* const token(output++);
+  if (literal_count < kMaxLengthInToken) {
+    *token = static_cast<byte>(literal_count << kLengthBits);
+  } else {
+    *token = static_cast<byte>(kMaxLengthInToken << kLengthBits);
+    output = WriteExtraLength(output, literal_count);
+  }
+  if (literal_count != 0)
+    std::memcpy(output, literals, literal_count);
+  output += literal_count;
+  if (offset == 0)
+    return output;
+
+  *output++ = static_cast<byte>(offset);
+  *output++ = static_cast<byte>(offset >> 8);
+  if (extra_match_length < kMaxLengthInToken) {
+    *token |= static_cast<byte>(extra_match_length);
+  } else {
+    *token |= static_cast<byte>(kMaxLengthInToken);
+    output = WriteExtraLength(output, extra_match_length);
+  }
+  return output;
+}
+
+}  // unnamed namespace
+
+std::size_t Compress(const byte* input, std::size_t input_size, byte* output,
+                     std::size_t output_capacity) {
+  const byte* const input_end(input + input_size);
+  byte* const output_end(output + output_capacity);
+  byte* output_position(output);
+  const byte* anchor(input);
+
+  if (input_size > kMatchStartLimit) {
+    const byte* const match_start_limit(input_end - kMatchStartLimit);
+    const byte* const match_end_limit(input_end - kLastLiterals);
+    // Positions are stored relative to 'input'; a stale or colliding entry is rejected below by
+    // comparing the bytes themselves.
+    std::array<std::uint32_t, 1U << kHashBits> table;
+    table.fill(0);
+    const byte* position(input + 1);
+    std::size_t failed_probes(0);
+    while (position <= match_start_limit) {
+      const std::uint32_t sequence(Read32(position));
+      const std::uint32_t hash(Hash(sequence));
+      const byte* candidate(input + table[hash]);
+      table[hash] = static_cast<std::uint32_t>(position - input);
+      if (candidate >= position || static_cast<std::size_t>(position - candidate) > kMaxOffset ||
+          Read32(candidate) != sequence) {
+        // Skip ahead faster the longer it's been since the last match, so incompressible input
+        // is passed over quickly.
+        position += 1 + (failed_probes++ >> kSkipTrigger);
+        continue;
+      }
+      failed_probes = 0;
+
+      while (position > anchor && candidate > input && position[-1] == candidate[-1]) {
+        --position;
+        --candidate;
+      }
+      const byte* match_end(position + kMinMatch);
+      const byte* candidate_end(candidate + kMinMatch);
+      while (match_end + sizeof(std::uint64_t) <= match_end_limit &&
+             Read64(match_end) == Read64(candidate_end)) {
+        match_end += sizeof(std::uint64_t);
+        candidate_end += sizeof(std::uint64_t);
+      }
+      while (match_end < match_end_limit && *match_end == *candidate_end) {
+        ++match_end;
+        ++candidate_end;
+      }
+
+      output_position = WriteSequence(output_position, output_end, anchor,
+                                      static_cast<std::size_t>(position - anchor),
+                                      static_cast<std::size_t>(position - candidate),
+                                      static_cast<std::size_t>(match_end - position));
+      if (!output_position)
+        return 0;
+      position = anchor = match_end;
+      if (position <= match_start_limit)
+        table[Hash(Read32(position - 2))] = static_cast<std::uint32_t>(position - 2 - input);
+    }
+  }
+
+  output_position = WriteSequence(output_position, output_end, anchor,
+                                  static_cast<std::size_t>(input_end - anchor), 0, kMinMatch);
+  return output_position ? static_cast<std::size_t>(output_position - output) : 0;
+}
+
+bool Decompress(const byte* input, std::size_t input_size, byte* output, std::size_t output_size) {
+  const byte* const input_end(input + input_size);
+  byte* const output_end(output + output_size);
+  byte* output_position(output);
+
+  for (;;) {
+    if (input == input_end)
+      return false;
+    const byte token(*input++);
+    std::size_t literal_count(token >> kLengthBits);
+    if (literal_count == kMaxLengthInToken && !ReadExtraLength(input, input_end, literal_count))
+      return false;
+    if (static_cast<std::size_t>(input_end - input) < literal_count ||
+        static_cast<std::size_t>(output_end - output_position) < literal_count) {
+      return false;
+    }
+    if (literal_count != 0)
+      std::memcpy(output_position, input, literal_count);
+    input += literal_count;
+    output_position += literal_count;
+    // Only the final sequence has no match.
+    if (input == input_end)
+      return output_position == output_end;
+
+    if (input_end - input < 2)
+      return false;
+    const std::size_t offset(input[0] | (static_cast<std::size_t>(input[1]) << 8));
+    input += 2;
+    if (offset == 0 || offset > static_cast<std::size_t>(output_position - output))
+      return false;
+    std::size_t match_length(token & kMaxLengthInToken);
+    if (match_length == kMaxLengthInToken && !ReadExtraLength(input, input_end, match_length))
+      return false;
+    match_length += kMinMatch;
+    if (static_cast<std::size_t>(output_end - output_position) < match_length)
+      return false;
+
+    const byte* match(output_position - offset);
+    if (offset >= match_length) {
+      std::memcpy(output_position, match, match_length);
+      output_position += match_length;
+    } else {
+      // The match overlaps the bytes it produces, e.g. a run of a repeated byte.
+      for (std::size_t i(0); i != match_length; ++i)
+        *output_position++ = *match++;
+    }
+  }
+}
+
+}  // namespace detail
+
+}  // namespace tcp
+
+}  // namespace maidsafe
@@ -0,0 +1,53 @@
+/*  Copyright 2015 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#ifndef MAIDSAFE_COMMON_TCP_COMPRESSION_H_
+#define MAIDSAFE_COMMON_TCP_COMPRESSION_H_
+
+#include <cstddef>
+
+#include "maidsafe/common/types.h"
+
+namespace maidsafe {
+
+namespace tcp {
+
+namespace detail {
+
+// A fast LZ77 block codec for frame bodies, using the LZ4 block format: sequences of literals
+// followed by a match of at least 4 bytes at an offset of up to 64 KiB.  It trades ratio for speed
+// (a single-probe hash table and no entropy coding), so it's cheap enough to run inline on the send
+// and receive paths.
+
+// Compresses 'input' into 'output', returning the compressed size, or 0 if the result wouldn't fit
+// in 'output_capacity' bytes.  Passing a capacity below 'input_size' bounds the work done on
+// poorly compressible input, which fails as soon as it overflows.
+std::size_t Compress(const byte* input, std::size_t input_size, byte* output,
+                     std::size_t output_capacity);
+
+// Returns false unless 'input' decodes to exactly 'output_size' bytes.  Never reads or writes
+// outside the given ranges, whatever 'input' holds.
+bool Decompress(const byte* input, std::size_t input_size, byte* output, std::size_t output_size);
+
+}  // namespace detail
+
+}  // namespace tcp
+
+}  // namespace maidsafe
+
+#endif  // MAIDSAFE_COMMON_TCP_COMPRESSION_H_
@@ -18,10 +18,23 @@
 
 #include "maidsafe/common/tcp/connection.h"
 
+#include <algorithm>
 #include <condition_variable>
+#include <cstring>
+#include <functional>
+#include <limits>
+#include <system_error>
+
+#ifndef MAIDSAFE_WIN32
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
 
 #include "asio/dispatch.hpp"
 #include "asio/error.hpp"
+#include "asio/local/stream_protocol.hpp"
 #include "asio/post.hpp"
 #include "asio/read.hpp"
 #include "asio/write.hpp"
@@ -29,6 +42,7 @@
 #include "maidsafe/common/log.h"
 #include "maidsafe/common/on_scope_exit.h"
 #include "maidsafe/common/utils.h"
+#include "maidsafe/common/tcp/compression.h"
 
 namespace ip = asio::ip;
 
@@ -36,28 +50,181 @@ namespace maidsafe {
 
 namespace tcp {
 
-Connection::Connection(asio::io_service::strand& strand)
+const size_t Connection::kDefaultMaxCoalescedMessages;
+const size_t Connection::kDefaultMaxCoalescedBytes;
+const size_t Connection::kReadBufferSize;
+const size_t Connection::kDirectReadThreshold;
+const size_t Connection::kBufferPoolSize;
+const size_t Connection::kBufferPoolBytes;
+const Connection::DataSize Connection::kMoreChunksFlag;
+const Connection::DataSize Connection::kDescriptorFlag;
+const Connection::DataSize Connection::kCompressedFlag;
+const size_t Connection::kDefaultCompressionThreshold;
+const size_t Connection::kMinCompressionThreshold;
+
+namespace {
+
+// The shortest LZ4 block which can hold any data: a token byte followed by a single literal.
+const size_t kMinCompressedSize = 2;
+
+void CloseDescriptor(int descriptor) {
+#ifndef MAIDSAFE_WIN32
+  if (descriptor != -1)
+    ::close(descriptor);
+#else
+  static_cast<void>(descriptor);
+#endif
+}
+
+// A view of a connection's send buffers, so that each write operation can hold a copy of the
+// sequence without allocating.
+class SendBufferSequence {
+ public:
+  typedef asio::const_buffer value_type;
+  typedef std::vector<asio::const_buffer>::const_iterator const_iterator;
+  explicit SendBufferSequence(const std::vector<asio::const_buffer>& buffers)
+      : begin_(std::begin(buffers)), end_(std::end(buffers)) {}
+  const_iterator begin() const { return begin_; }
+  const_iterator end() const { return end_; }
+
+ private:
+  const_iterator begin_, end_;
+};
+
+#ifndef MAIDSAFE_WIN32
+// Room for the control message carrying descriptors, suitably aligned.
+const size_t kMaxDescriptorsPerRead = 16;
+union ControlBuffer {
+  cmsghdr header;
+  char buffer[CMSG_SPACE(kMaxDescriptorsPerRead * sizeof(int))];
+};
+#endif
+
+}  // unnamed namespace
+
+void* Connection::HandlerMemory::Allocate(size_t size) {
+  if (in_use_ || size > sizeof(storage_))
+    return ::operator new(size);
+  in_use_ = true;
+  return &storage_;
+}
+
+void Connection::HandlerMemory::Deallocate(void* pointer) {
+  if (pointer == &storage_)
+    in_use_ = false;
+  else
+    ::operator delete(pointer);
+}
+
+// Has asio allocate the memory for the operation which will invoke 'Handler' from 'memory'.
+template <typename Handler>
+class Connection::AllocatingHandler {
+ public:
+  AllocatingHandler(HandlerMemory& memory, Handler handler)
+      : memory_(&memory), handler_(std::move(handler)) {}
+
+  template <typename... Args>
+  void operator()(Args&&... args) {
+    handler_(std::forward<Args>(args)...);
+  }
+
+  friend void* asio_handler_allocate(size_t size, AllocatingHandler* this_handler) {
+    return this_handler->memory_->Allocate(size);
+  }
+
+  friend void asio_handler_deallocate(void* pointer, size_t /*size*/,
+                                      AllocatingHandler* this_handler) {
+    this_handler->memory_->Deallocate(pointer);
+  }
+
+ private:
+  HandlerMemory* memory_;
+  Handler handler_;
+};
+
+template <typename Handler>
+Connection::AllocatingHandler<Handler> Connection::AllocateFrom(HandlerMemory& memory,
+                                                                Handler handler) {
+  return AllocatingHandler<Handler>(memory, std::move(handler));
+}
+
+template <typename Buffers, typename Handler>
+void Connection::AsyncRead(const Buffers& buffers, Handler handler) {
+#ifndef MAIDSAFE_WIN32
+  if (local_)
+    return asio::async_read(local_socket_, buffers, std::move(handler));
+#endif
+  asio::async_read(socket_, buffers, std::move(handler));
+}
+
+template <typename Buffers, typename Handler>
+void Connection::AsyncWrite(const Buffers& buffers, Handler handler) {
+#ifndef MAIDSAFE_WIN32
+  if (local_)
+    return asio::async_write(local_socket_, buffers, std::move(handler));
+#endif
+  asio::async_write(socket_, buffers, std::move(handler));
+}
+
+Connection::Connection(asio::io_service::strand& strand, bool local)
     : strand_(strand),
       start_flag_(),
       socket_close_flag_(),
       socket_(strand_.context()),
+#ifndef MAIDSAFE_WIN32
+      local_socket_(strand_.context()),
+#endif
+      local_(local),
       on_message_received_(),
+      on_chunk_received_(),
+      on_descriptor_received_(),
       on_connection_closed_(),
-      receiving_message_(),
-      send_queue_() {
+      read_buffer_(kReadBufferSize),
+      body_buffer_(),
+      read_begin_(0),
+      read_end_(0),
+      reading_(false),
+      parsing_(false),
+      read_operation_count_(0),
+      received_descriptors_(),
+      body_descriptor_(-1),
+      reassembly_buffer_(),
+      reassembly_limit_(MaxMessageSize()),
+      reassembling_(false),
+      receive_handlers_(),
+      buffer_pool_(kBufferPoolSize, kBufferPoolBytes),
+      pending_sends_mutex_(),
+      pending_sends_(),
+      flushing_sends_(),
+      send_queue_(),
+      spare_sends_(),
+      send_buffers_(),
+      read_handler_memory_(),
+      write_handler_memory_(),
+      sending_count_(0),
+      max_coalesced_messages_(kDefaultMaxCoalescedMessages),
+      max_coalesced_bytes_(kDefaultMaxCoalescedBytes),
+      queued_bytes_(0),
+      peak_queued_bytes_(0),
+      high_watermark_(std::numeric_limits<size_t>::max()),
+      low_watermark_(0),
+      above_high_watermark_(false),
+      on_writable_(),
+      compression_flag_(),
+      compression_threshold_(0),
+      peer_accepts_compression_(false),
+      compressed_frames_(0),
+      skipped_frames_(0),
+      bytes_saved_(0),
+      compression_nanoseconds_(0),
+      decompression_nanoseconds_(0),
+      closed_(false) {
   static_assert((sizeof(DataSize)) == 4, "DataSize must be 4 bytes.");
   assert(!socket_.is_open());
 }
 
 Connection::Connection(asio::io_service::strand& strand, Port remote_port)
-    : strand_(strand),
-      start_flag_(),
-      socket_close_flag_(),
-      socket_(strand_.context()),
-      on_message_received_(),
-      on_connection_closed_(),
-      receiving_message_(),
-      send_queue_() {
+    : Connection(strand, false) {
   std::error_code connect_error;
   // Try IPv6 first.
   socket_.connect(ip::tcp::endpoint{ip::address_v6::loopback(), remote_port}, connect_error);
@@ -74,21 +241,63 @@ Connection::Connection(asio::io_service::strand& strand, Port remote_port)
   }
 }
 
+#ifndef MAIDSAFE_WIN32
+Connection::Connection(asio::io_service::strand& strand,
+                       const boost::filesystem::path& socket_path)
+    : Connection(strand, true) {
+  std::error_code connect_error;
+  local_socket_.connect(asio::local::stream_protocol::endpoint{socket_path.string()},
+                        connect_error);
+  if (connect_error) {
+    LOG(kError) << "Failed to connect to " << socket_path << ": " << connect_error.message();
+    BOOST_THROW_EXCEPTION(MakeError(VaultManagerErrors::failed_to_connect));
+  }
+}
+#endif
+
+Connection::~Connection() {
+  // Close any descriptors which were never handed over or sent.
+  for (int descriptor : received_descriptors_)
+    CloseDescriptor(descriptor);
+  CloseDescriptor(body_descriptor_);
+  for (const auto& message : pending_sends_)
+    CloseDescriptor(message.descriptor);
+  for (const auto& message : send_queue_)
+    CloseDescriptor(message.descriptor);
+}
+
 ConnectionPtr Connection::MakeShared(asio::io_service::strand& strand) {
-  return ConnectionPtr{new Connection{strand}};
+  return ConnectionPtr{new Connection{strand, false}};
 }
 
 ConnectionPtr Connection::MakeShared(asio::io_service::strand& strand, Port remote_port) {
   return ConnectionPtr{new Connection{strand, remote_port}};
 }
 
+#ifndef MAIDSAFE_WIN32
+ConnectionPtr Connection::MakeShared(asio::io_service::strand& strand,
+                                     const boost::filesystem::path& socket_path) {
+  return ConnectionPtr{new Connection{strand, socket_path}};
+}
+#endif
+
 void Connection::Start(MessageReceivedFunctor on_message_received,
                        ConnectionClosedFunctor on_connection_closed) {
   std::call_once(start_flag_, [=] {
     on_message_received_ = on_message_received;
     on_connection_closed_ = on_connection_closed;
     ConnectionPtr this_ptr{shared_from_this()};
-    asio::dispatch(strand_, [this_ptr] { this_ptr->ReadSize(); });
+    asio::dispatch(strand_, [this_ptr] { this_ptr->ProcessReadBuffer(); });
+  });
+}
+
+void Connection::StartStreaming(ChunkReceivedFunctor on_chunk_received,
+                                ConnectionClosedFunctor on_connection_closed) {
+  std::call_once(start_flag_, [=] {
+    on_chunk_received_ = on_chunk_received;
+    on_connection_closed_ = on_connection_closed;
+    ConnectionPtr this_ptr{shared_from_this()};
+    asio::dispatch(strand_, [this_ptr] { this_ptr->ProcessReadBuffer(); });
   });
 }
 
@@ -99,106 +308,660 @@ void Connection::Close() {
 
 void Connection::DoClose() {
   std::call_once(socket_close_flag_, [this] {
+    closed_ = true;
     std::error_code ignored_ec;
     socket_.shutdown(asio::ip::tcp::socket::shutdown_send, ignored_ec);
     socket_.close(ignored_ec);
+#ifndef MAIDSAFE_WIN32
+    local_socket_.shutdown(asio::local::stream_protocol::socket::shutdown_send, ignored_ec);
+    local_socket_.close(ignored_ec);
+#endif
+    AbortPendingHandlers();
     if (on_connection_closed_)
       on_connection_closed_();
   });
 }
 
-void Connection::ReadSize() {
-  ConnectionPtr this_ptr{shared_from_this()};
-  asio::async_read(socket_, asio::buffer(receiving_message_.size_buffer),
-                   [this_ptr](const std::error_code& ec, size_t bytes_transferred) {
-    if (ec) {
-      LOG(kInfo) << ec.message();
-      return this_ptr->DoClose();
+void Connection::AbortPendingHandlers() {
+  const std::error_code aborted(asio::error::make_error_code(asio::error::operation_aborted));
+  for (auto& handler : receive_handlers_)
+    asio::post(strand_, std::bind(std::move(handler), aborted, Message()));
+  receive_handlers_.clear();
+  // The queued messages themselves are left alone, since an in-flight write may still be using
+  // the buffers of the first 'sending_count_' of them.
+  for (auto& message : send_queue_) {
+    if (message.on_sent) {
+      asio::post(strand_, std::bind(std::move(message.on_sent), aborted));
+      message.on_sent = nullptr;
     }
-    assert(bytes_transferred == 4U);
-    static_cast<void>(bytes_transferred);
-
-    DataSize data_size;
-    data_size = (((((this_ptr->receiving_message_.size_buffer[0] << 8) |
-                    this_ptr->receiving_message_.size_buffer[1])
-                   << 8) |
-                  this_ptr->receiving_message_.size_buffer[2])
-                 << 8) |
-                this_ptr->receiving_message_.size_buffer[3];
+  }
+}
+
+bool Connection::WantsMessages() const {
+  // In pull mode, only read while there are 'Receive' handlers waiting.
+  return !closed_ &&
+         (on_message_received_ || on_chunk_received_ || !receive_handlers_.empty());
+}
+
+void Connection::ProcessReadBuffer() {
+  // A 'Receive' handler may call 'Receive' again, re-entering here; the outer call carries on.
+  if (parsing_)
+    return;
+  parsing_ = true;
+  while (WantsMessages() && read_end_ - read_begin_ >= sizeof(DataSize)) {
+    const byte* const frame{read_buffer_.data() + read_begin_};
+    const DataSize size_field{(((((static_cast<DataSize>(frame[0]) << 8) | frame[1]) << 8) |
+                                frame[2]) << 8) | frame[3]};
+    const bool last_chunk{(size_field & kMoreChunksFlag) == 0};
+    const bool compressed{(size_field & kCompressedFlag) != 0};
+    const DataSize data_size{size_field & ~(kMoreChunksFlag | kDescriptorFlag | kCompressedFlag)};
     if (data_size > MaxMessageSize()) {
       LOG(kError) << "Incoming message size of " << data_size
                   << " bytes exceeds maximum allowed of " << MaxMessageSize() << " bytes.";
-      this_ptr->receiving_message_.data_buffer.clear();
-      return this_ptr->DoClose();
+      parsing_ = false;
+      return DoClose();
+    }
+    const byte* const body{frame + sizeof(DataSize)};
+    const size_t available{read_end_ - read_begin_ - sizeof(DataSize)};
+    if (data_size >= kDirectReadThreshold) {
+      // Take whatever part of the body has already been read, then read the rest directly.
+      if (!TakeReceivedDescriptor(size_field, body_descriptor_)) {
+        parsing_ = false;
+        return DoClose();
+      }
+      const size_t bytes_already_read{std::min<size_t>(available, data_size)};
+      body_buffer_ = buffer_pool_.Acquire(data_size);
+      std::copy(body, body + bytes_already_read, std::begin(body_buffer_));
+      read_begin_ += sizeof(DataSize) + bytes_already_read;
+      if (bytes_already_read != data_size) {
+        parsing_ = false;
+        return ReadBody(bytes_already_read, last_chunk, compressed);
+      }
+      Message data;
+      data.swap(body_buffer_);
+      const int descriptor{body_descriptor_};
+      body_descriptor_ = -1;
+      HandleChunk(std::move(data), last_chunk, compressed, descriptor);
+      continue;
+    }
+    if (available < data_size)
+      break;
+    int descriptor{-1};
+    if (!TakeReceivedDescriptor(size_field, descriptor)) {
+      parsing_ = false;
+      return DoClose();
+    }
+    Message data{buffer_pool_.Acquire(data_size)};
+    std::copy(body, body + data_size, std::begin(data));
+    read_begin_ += sizeof(DataSize) + data_size;
+    HandleChunk(std::move(data), last_chunk, compressed, descriptor);
+  }
+  parsing_ = false;
+  if (WantsMessages() && !reading_)
+    ReadSome();
+}
+
+void Connection::ReadSome() {
+  // Move any partial message to the front; it's always smaller than 'kDirectReadThreshold'.
+  if (read_begin_ != 0) {
+    std::copy(std::begin(read_buffer_) + read_begin_, std::begin(read_buffer_) + read_end_,
+              std::begin(read_buffer_));
+    read_end_ -= read_begin_;
+    read_begin_ = 0;
+  }
+  reading_ = true;
+  ConnectionPtr this_ptr{shared_from_this()};
+#ifndef MAIDSAFE_WIN32
+  if (local_) {
+    // Descriptors can only be received via 'recvmsg'.  Like 'async_read_some', try a read straight
+    // away and only wait for the socket to become readable if nothing's there yet.
+    std::error_code ec;
+    if (ReceiveWithDescriptors(ec) || ec) {
+      return asio::post(strand_, [this_ptr, ec] {
+        this_ptr->reading_ = false;
+        if (ec) {
+          LOG(kInfo) << ec.message();
+          return this_ptr->DoClose();
+        }
+        this_ptr->ProcessReadBuffer();
+      });
     }
+    return local_socket_.async_wait(
+        asio::socket_base::wait_read,
+        strand_.wrap(AllocateFrom(read_handler_memory_, [this_ptr](const std::error_code& ec) {
+          this_ptr->reading_ = false;
+          if (ec) {
+            LOG(kInfo) << ec.message();
+            return this_ptr->DoClose();
+          }
+          this_ptr->ReadSome();
+        })));
+  }
+#endif
+  ++read_operation_count_;
+  socket_.async_read_some(
+      asio::buffer(read_buffer_.data() + read_end_, read_buffer_.size() - read_end_),
+      strand_.wrap(AllocateFrom(read_handler_memory_, [this_ptr](const std::error_code& ec,
+                                                                 size_t bytes_transferred) {
+        this_ptr->reading_ = false;
+        if (ec) {
+          LOG(kInfo) << ec.message();
+          return this_ptr->DoClose();
+        }
+        this_ptr->read_end_ += bytes_transferred;
+        this_ptr->ProcessReadBuffer();
+      })));
+}
 
-    this_ptr->receiving_message_.data_buffer.resize(data_size);
-    this_ptr->ReadData();
+void Connection::ReadBody(size_t bytes_already_read, bool last_chunk, bool compressed) {
+  assert(read_begin_ == read_end_);
+  read_begin_ = read_end_ = 0;
+  reading_ = true;
+  ++read_operation_count_;
+  ConnectionPtr this_ptr{shared_from_this()};
+  AsyncRead(
+      asio::buffer(body_buffer_.data() + bytes_already_read,
+                   body_buffer_.size() - bytes_already_read),
+      strand_.wrap(AllocateFrom(read_handler_memory_, [this_ptr, last_chunk, compressed](
+                                    const std::error_code& ec, size_t /*bytes_transferred*/) {
+        this_ptr->reading_ = false;
+        if (ec) {
+          LOG(kError) << "Failed to read message body: " << ec.message();
+          return this_ptr->DoClose();
+        }
+        Message data;
+        data.swap(this_ptr->body_buffer_);
+        const int descriptor{this_ptr->body_descriptor_};
+        this_ptr->body_descriptor_ = -1;
+        this_ptr->HandleChunk(std::move(data), last_chunk, compressed, descriptor);
+        this_ptr->ProcessReadBuffer();
+      })));
+}
+
+#ifndef MAIDSAFE_WIN32
+bool Connection::ReceiveWithDescriptors(std::error_code& ec) {
+  iovec io_vector;
+  io_vector.iov_base = read_buffer_.data() + read_end_;
+  io_vector.iov_len = read_buffer_.size() - read_end_;
+  ControlBuffer control;
+  msghdr header{};
+  header.msg_iov = &io_vector;
+  header.msg_iovlen = 1;
+  header.msg_control = control.buffer;
+  header.msg_controllen = sizeof(control.buffer);
+  const ssize_t received{::recvmsg(local_socket_.native_handle(), &header, MSG_DONTWAIT)};
+  if (received < 0) {
+    ec.assign(errno, std::system_category());
+    if (ec == std::errc::resource_unavailable_try_again || ec == std::errc::interrupted)
+      ec.clear();
+    return false;
+  }
+  if (received == 0) {
+    ec = asio::error::make_error_code(asio::error::eof);
+    return false;
+  }
+  ++read_operation_count_;
+
+  for (cmsghdr* control_header = CMSG_FIRSTHDR(&header); control_header;
+       control_header = CMSG_NXTHDR(&header, control_header)) {
+    if (control_header->cmsg_level != SOL_SOCKET || control_header->cmsg_type != SCM_RIGHTS)
+      continue;
+    const size_t count{(control_header->cmsg_len - CMSG_LEN(0)) / sizeof(int)};
+    for (size_t i(0); i != count; ++i) {
+      int descriptor;
+      std::memcpy(&descriptor, CMSG_DATA(control_header) + i * sizeof(int), sizeof(int));
+      ::fcntl(descriptor, F_SETFD, FD_CLOEXEC);
+      received_descriptors_.push_back(descriptor);
+    }
+  }
+  if ((header.msg_flags & MSG_CTRUNC) != 0)
+    LOG(kError) << "Received more descriptors than can be handled; some have been dropped.";
+  read_end_ += static_cast<size_t>(received);
+  return true;
+}
+#endif
+
+bool Connection::TakeReceivedDescriptor(DataSize size_field, int& descriptor) {
+  descriptor = -1;
+  if ((size_field & kDescriptorFlag) == 0)
+    return true;
+  if (received_descriptors_.empty()) {
+    LOG(kError) << "Incoming message's file descriptor is missing.";
+    return false;
+  }
+  descriptor = received_descriptors_.front();
+  received_descriptors_.pop_front();
+  return true;
+}
+
+void Connection::HandleChunk(Message chunk, bool last_chunk, bool compressed, int descriptor) {
+  if (compressed) {
+    if (chunk.empty()) {
+      peer_accepts_compression_ = true;
+      return CloseDescriptor(descriptor);
+    }
+    if (!DecompressBody(chunk)) {
+      CloseDescriptor(descriptor);
+      return DoClose();
+    }
+  }
+  if (descriptor != -1) {
+    if (on_descriptor_received_)
+      return on_descriptor_received_(std::move(chunk), descriptor);
+    LOG(kWarning) << "No handler for received file descriptor; closing it.";
+    CloseDescriptor(descriptor);
+  }
+  if (on_chunk_received_)
+    return on_chunk_received_(std::move(chunk), last_chunk);
+
+  if (last_chunk && !reassembling_)
+    return Deliver(std::move(chunk));
+  if (reassembly_buffer_.size() + chunk.size() > reassembly_limit_) {
+    LOG(kError) << "Incoming chunked message exceeds maximum allowed size of "
+                << reassembly_limit_ << " bytes.";
+    reassembly_buffer_ = Message();
+    return DoClose();
+  }
+  if (reassembling_) {
+    reassembly_buffer_.insert(std::end(reassembly_buffer_), std::begin(chunk), std::end(chunk));
+    buffer_pool_.Recycle(std::move(chunk));
+  } else {
+    reassembly_buffer_ = std::move(chunk);
+    reassembling_ = true;
+  }
+  if (!last_chunk)
+    return;
+  reassembling_ = false;
+  Message data;
+  data.swap(reassembly_buffer_);
+  Deliver(std::move(data));
+}
+
+void Connection::Deliver(Message data) {
+  if (on_message_received_)
+    return on_message_received_(std::move(data));
+  if (receive_handlers_.empty())  // Aborted by 'DoClose'.
+    return;
+  ReceiveHandler handler(std::move(receive_handlers_.front()));
+  receive_handlers_.pop_front();
+  handler(std::error_code(), std::move(data));
+}
+
+void Connection::Receive(ReceiveHandler handler) {
+  ConnectionPtr this_ptr{shared_from_this()};
+  // Posted rather than dispatched: with a message already buffered, 'handler' is invoked as soon
+  // as this runs, which must not happen within this call (e.g. before a coroutine has yielded).
+  asio::post(strand_, [this_ptr, handler] {
+    assert(!this_ptr->on_message_received_);
+    if (this_ptr->closed_) {
+      return asio::post(this_ptr->strand_, std::bind(handler, asio::error::make_error_code(
+                                                                  asio::error::operation_aborted),
+                                                     Message()));
+    }
+    this_ptr->receive_handlers_.push_back(handler);
+    this_ptr->ProcessReadBuffer();
   });
 }
 
-void Connection::ReadData() {
+void Connection::Send(Message data) { QueueSend(EncodeData(std::move(data))); }
+
+void Connection::Send(Message data, SendHandler handler) {
+  SendingMessage message(EncodeData(std::move(data)));
+  message.on_sent = std::move(handler);
+  QueueSend(std::move(message));
+}
+
+void Connection::SendChunk(Message chunk, bool last_chunk, SendHandler handler) {
+  SendingMessage message(EncodeData(std::move(chunk), last_chunk));
+  message.on_sent = std::move(handler);
+  QueueSend(std::move(message));
+}
+
+void Connection::SetReassemblyLimit(size_t max_bytes) {
+  ConnectionPtr this_ptr{shared_from_this()};
+  asio::dispatch(strand_, [this_ptr, max_bytes] { this_ptr->reassembly_limit_ = max_bytes; });
+}
+
+void Connection::SetSendWatermarks(size_t high_watermark, size_t low_watermark,
+                                   WritableFunctor on_writable) {
+  if (low_watermark >= high_watermark)
+    BOOST_THROW_EXCEPTION(MakeError(CommonErrors::invalid_argument));
+  high_watermark_ = high_watermark;
+  low_watermark_ = low_watermark;
   ConnectionPtr this_ptr{shared_from_this()};
-  asio::async_read(socket_, asio::buffer(receiving_message_.data_buffer),
-                   strand_.wrap([this_ptr](const std::error_code& ec, size_t bytes_transferred) {
-                     if (ec) {
-                       LOG(kError) << "Failed to read message body: " << ec.message();
-                       return this_ptr->DoClose();
-                     }
-                     assert(bytes_transferred == this_ptr->receiving_message_.data_buffer.size());
-                     static_cast<void>(bytes_transferred);
-
-                     // Dispatch the message outside the strand.
-                     Message data{std::begin(this_ptr->receiving_message_.data_buffer),
-                                      std::end(this_ptr->receiving_message_.data_buffer)};
-                     asio::post(this_ptr->strand_,
-                                [=] { this_ptr->on_message_received_(std::move(data)); });
-                     asio::dispatch(this_ptr->strand_, [this_ptr] { this_ptr->ReadSize(); });
-                   }));
-}
-
-void Connection::Send(Message data) {
+  asio::dispatch(strand_, [this_ptr, on_writable] { this_ptr->on_writable_ = on_writable; });
+}
+
+bool Connection::TrySend(Message data) {
+  if (queued_bytes_ >= high_watermark_) {
+    above_high_watermark_ = true;
+    // The queue may have drained past the low watermark before the flag was set, in which case no
+    // 'Dequeued' call will see it.  Unless a concurrent 'Dequeued' has already claimed the flag
+    // (and so will invoke 'on_writable_'), clear it again and send after all.
+    if (queued_bytes_ > low_watermark_ || !above_high_watermark_.exchange(false))
+      return false;
+  }
+  Send(std::move(data));
+  return true;
+}
+
+#ifndef MAIDSAFE_WIN32
+void Connection::SendWithDescriptor(Message data, int descriptor, SendHandler handler) {
+  if (!local_)
+    BOOST_THROW_EXCEPTION(MakeError(CommonErrors::invalid_argument));
   SendingMessage message(EncodeData(std::move(data)));
+  message.size_buffer[0] |= static_cast<unsigned char>(kDescriptorFlag >> 24);
+  message.descriptor = ::fcntl(descriptor, F_DUPFD_CLOEXEC, 0);
+  if (message.descriptor == -1) {
+    LOG(kError) << "Failed to duplicate file descriptor " << descriptor << ": "
+                << std::error_code(errno, std::system_category()).message();
+    BOOST_THROW_EXCEPTION(MakeError(CommonErrors::invalid_argument));
+  }
+  message.on_sent = std::move(handler);
+  QueueSend(std::move(message));
+}
+
+void Connection::SetDescriptorReceivedFunctor(DescriptorReceivedFunctor on_descriptor_received) {
+  ConnectionPtr this_ptr{shared_from_this()};
+  asio::dispatch(strand_, [this_ptr, on_descriptor_received] {
+    this_ptr->on_descriptor_received_ = on_descriptor_received;
+  });
+}
+#endif
+
+void Connection::RecycleBuffer(Message buffer) { buffer_pool_.Recycle(std::move(buffer)); }
+
+void Connection::QueueSend(SendingMessage message) {
+  const size_t queued{queued_bytes_ += message.size_buffer.size() + message.data.size()};
+  if (queued >= high_watermark_)
+    above_high_watermark_ = true;
+  size_t peak{peak_queued_bytes_};
+  while (queued > peak && !peak_queued_bytes_.compare_exchange_weak(peak, queued)) {
+  }
+
+  // Messages are moved into 'pending_sends_' rather than captured by a handler, which would copy
+  // them.  Only the first of a batch of concurrent sends needs to schedule a flush.
+  bool flush_scheduled;
+  {
+    std::lock_guard<std::mutex> lock{pending_sends_mutex_};
+    flush_scheduled = !pending_sends_.empty();
+    pending_sends_.emplace_back(std::move(message));
+  }
+  if (!flush_scheduled) {
+    ConnectionPtr this_ptr{shared_from_this()};
+    asio::dispatch(strand_, [this_ptr] { this_ptr->FlushPendingSends(); });
+  }
+}
+
+void Connection::FlushPendingSends() {
+  {
+    std::lock_guard<std::mutex> lock{pending_sends_mutex_};
+    flushing_sends_.swap(pending_sends_);
+  }
+  const bool currently_sending{!send_queue_.empty()};
+  for (auto& message : flushing_sends_) {
+    if (!closed_) {
+      if (spare_sends_.empty()) {
+        send_queue_.emplace_back(std::move(message));
+      } else {
+        send_queue_.splice(std::end(send_queue_), spare_sends_, std::begin(spare_sends_));
+        send_queue_.back() = std::move(message);
+      }
+      continue;
+    }
+    queued_bytes_ -= message.size_buffer.size() + message.data.size();
+    CloseDescriptor(message.descriptor);
+    if (message.on_sent) {
+      asio::post(strand_, std::bind(std::move(message.on_sent), asio::error::make_error_code(
+                                                                    asio::error::operation_aborted)));
+    }
+  }
+  flushing_sends_.clear();
+  if (!currently_sending && !send_queue_.empty())
+    DoSend();
+}
+
+void Connection::SetWriteCoalescingLimits(size_t max_messages, size_t max_bytes) {
+  if (max_messages == 0)
+    BOOST_THROW_EXCEPTION(MakeError(CommonErrors::invalid_argument));
   ConnectionPtr this_ptr{shared_from_this()};
-  asio::post(strand_, [this_ptr, message] {
-    bool currently_sending{!this_ptr->send_queue_.empty()};
-    this_ptr->send_queue_.emplace_back(std::move(message));
-    if (!currently_sending)
-      this_ptr->DoSend();
+  asio::dispatch(strand_, [this_ptr, max_messages, max_bytes] {
+    this_ptr->max_coalesced_messages_ = max_messages;
+    this_ptr->max_coalesced_bytes_ = max_bytes;
   });
 }
 
 void Connection::DoSend() {
-  std::array<asio::const_buffer, 2> buffers;
-  buffers[0] = asio::buffer(send_queue_.front().size_buffer);
-  buffers[1] = asio::buffer(send_queue_.front().data.data(), send_queue_.front().data.size());
+#ifndef MAIDSAFE_WIN32
+  if (send_queue_.front().descriptor != -1)
+    return DoSendWithDescriptor();
+#endif
+  // Gather as many queued messages as the limits allow into a single write.  The first message is
+  // always included, however large.  A message with a descriptor is always sent on its own.  The
+  // buffers are gathered into 'send_buffers_', which is left alone until the write completes.
+  send_buffers_.clear();
+  size_t total_size{0};
+  for (const auto& message : send_queue_) {
+    const size_t message_size{message.size_buffer.size() + message.data.size()};
+    if (!send_buffers_.empty() &&
+        (send_buffers_.size() == 2 * max_coalesced_messages_ ||
+         total_size + message_size > max_coalesced_bytes_ || message.descriptor != -1)) {
+      break;
+    }
+    send_buffers_.push_back(asio::buffer(message.size_buffer));
+    send_buffers_.push_back(asio::buffer(message.data.data(), message.data.size()));
+    total_size += message_size;
+  }
+  sending_count_ = send_buffers_.size() / 2;
+
   ConnectionPtr this_ptr{shared_from_this()};
-  asio::async_write(socket_, buffers,
-                    strand_.wrap([this_ptr](const std::error_code& ec, size_t bytes_transferred) {
-                      if (ec) {
-                        LOG(kError) << "Failed to send message: " << ec.message();
-                        return this_ptr->DoClose();
-                      }
-                      assert(bytes_transferred ==
-                             this_ptr->send_queue_.front().size_buffer.size() +
-                                 this_ptr->send_queue_.front().data.size());
-                      static_cast<void>(bytes_transferred);
-
-                      this_ptr->send_queue_.pop_front();
-                      if (!this_ptr->send_queue_.empty())
-                        this_ptr->DoSend();
-                    }));
-}
-
-Connection::SendingMessage Connection::EncodeData(Message data) const {
+  AsyncWrite(
+      SendBufferSequence(send_buffers_),
+      strand_.wrap(AllocateFrom(write_handler_memory_, [this_ptr, total_size](
+                                    const std::error_code& ec, size_t bytes_transferred) {
+        if (ec) {
+          LOG(kError) << "Failed to send message: " << ec.message();
+          return this_ptr->DoClose();
+        }
+        assert(bytes_transferred == total_size);
+        static_cast<void>(bytes_transferred);
+        this_ptr->HandleSent(total_size);
+      })));
+}
+
+#ifndef MAIDSAFE_WIN32
+void Connection::DoSendWithDescriptor() {
+  SendingMessage& message(send_queue_.front());
+  const size_t total_size{message.size_buffer.size() + message.data.size()};
+  sending_count_ = 1;
+
+  std::array<iovec, 2> io_vectors;
+  io_vectors[0].iov_base = message.size_buffer.data();
+  io_vectors[0].iov_len = message.size_buffer.size();
+  io_vectors[1].iov_base = message.data.data();
+  io_vectors[1].iov_len = message.data.size();
+  ControlBuffer control;
+  msghdr header{};
+  header.msg_iov = io_vectors.data();
+  header.msg_iovlen = io_vectors.size();
+  header.msg_control = control.buffer;
+  header.msg_controllen = CMSG_SPACE(sizeof(int));
+  cmsghdr* const control_header{CMSG_FIRSTHDR(&header)};
+  control_header->cmsg_level = SOL_SOCKET;
+  control_header->cmsg_type = SCM_RIGHTS;
+  control_header->cmsg_len = CMSG_LEN(sizeof(int));
+  std::memcpy(CMSG_DATA(control_header), &message.descriptor, sizeof(int));
+
+  ConnectionPtr this_ptr{shared_from_this()};
+  const ssize_t sent{
+      ::sendmsg(local_socket_.native_handle(), &header, MSG_DONTWAIT | MSG_NOSIGNAL)};
+  if (sent < 0) {
+    const std::error_code ec(errno, std::system_category());
+    if (ec == std::errc::resource_unavailable_try_again || ec == std::errc::interrupted) {
+      return local_socket_.async_wait(
+          asio::socket_base::wait_write,
+          strand_.wrap(AllocateFrom(write_handler_memory_, [this_ptr](
+                                        const std::error_code& wait_error) {
+            if (wait_error) {
+              LOG(kError) << "Failed to send message: " << wait_error.message();
+              return this_ptr->DoClose();
+            }
+            this_ptr->DoSendWithDescriptor();
+          })));
+    }
+    LOG(kError) << "Failed to send message: " << ec.message();
+    return DoClose();
+  }
+
+  // The descriptor has gone with the first byte, so the rest of the frame is written normally.
+  CloseDescriptor(message.descriptor);
+  message.descriptor = -1;
+  std::vector<asio::const_buffer> remaining;
+  size_t skip{static_cast<size_t>(sent)};
+  for (const auto& io_vector : io_vectors) {
+    if (skip < io_vector.iov_len) {
+      remaining.push_back(asio::buffer(static_cast<const byte*>(io_vector.iov_base) + skip,
+                                       io_vector.iov_len - skip));
+    }
+    skip -= std::min(skip, io_vector.iov_len);
+  }
+  asio::async_write(local_socket_, remaining, strand_.wrap([this_ptr, total_size](
+                                                   const std::error_code& ec, size_t /*bytes*/) {
+    if (ec) {
+      LOG(kError) << "Failed to send message: " << ec.message();
+      return this_ptr->DoClose();
+    }
+    this_ptr->HandleSent(total_size);
+  }));
+}
+#endif
+
+void Connection::HandleSent(size_t total_size) {
+  std::vector<SendHandler> sent_handlers;
+  for (size_t i(0); i != sending_count_; ++i) {
+    SendingMessage& sent(send_queue_.front());
+    if (sent.on_sent)
+      sent_handlers.emplace_back(std::move(sent.on_sent));
+    buffer_pool_.Recycle(std::move(sent.data));
+    if (spare_sends_.size() < kDefaultMaxCoalescedMessages)
+      spare_sends_.splice(std::end(spare_sends_), send_queue_, std::begin(send_queue_));
+    else
+      send_queue_.pop_front();
+  }
+  sending_count_ = 0;
+  if (!send_queue_.empty())
+    DoSend();
+  Dequeued(total_size);
+  for (auto& on_sent : sent_handlers)
+    on_sent(std::error_code());
+}
+
+void Connection::Dequeued(size_t bytes) {
+  const size_t queued{queued_bytes_ -= bytes};
+  if (queued <= low_watermark_ && above_high_watermark_.exchange(false) && on_writable_)
+    on_writable_();
+}
+
+void Connection::EnableCompression(size_t threshold) {
+  if (threshold < kMinCompressionThreshold)
+    BOOST_THROW_EXCEPTION(MakeError(CommonErrors::invalid_argument));
+  compression_threshold_ = threshold;
+  std::call_once(compression_flag_, [this] {
+    SendingMessage announcement;
+    for (int i = 0; i != 4; ++i)
+      announcement.size_buffer[i] = static_cast<char>(kCompressedFlag >> (8 * (3 - i)));
+    QueueSend(std::move(announcement));
+  });
+}
+
+Connection::CompressionStats Connection::GetCompressionStats() const {
+  CompressionStats stats;
+  stats.compressed_frames = compressed_frames_;
+  stats.skipped_frames = skipped_frames_;
+  stats.bytes_saved = bytes_saved_;
+  stats.compression_time = std::chrono::nanoseconds(compression_nanoseconds_);
+  stats.decompression_time = std::chrono::nanoseconds(decompression_nanoseconds_);
+  return stats;
+}
+
+bool Connection::CompressBody(Message& data) {
+  // Compressing into a buffer an eighth smaller than the input gives up as soon as the ratio is
+  // known to be too poor to be worth it.  The buffer must also have room for the size prefix and
+  // the shortest possible LZ4 block, which the minimum threshold normally guarantees.
+  const size_t capacity{data.size() - data.size() / 8};
+  if (capacity <= sizeof(DataSize) + kMinCompressedSize) {
+    ++skipped_frames_;
+    return false;
+  }
+  const auto start(std::chrono::steady_clock::now());
+  Message compressed{buffer_pool_.Acquire(capacity)};
+  const size_t compressed_size{detail::Compress(data.data(), data.size(),
+                                                compressed.data() + sizeof(DataSize),
+                                                compressed.size() - sizeof(DataSize))};
+  compression_nanoseconds_ += std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                  std::chrono::steady_clock::now() - start).count();
+  if (compressed_size == 0) {
+    ++skipped_frames_;
+    buffer_pool_.Recycle(std::move(compressed));
+    return false;
+  }
+
+  const DataSize uncompressed_size{static_cast<DataSize>(data.size())};
+  for (int i = 0; i != 4; ++i)
+    compressed[i] = static_cast<byte>(uncompressed_size >> (8 * (3 - i)));
+  compressed.resize(sizeof(DataSize) + compressed_size);
+  ++compressed_frames_;
+  bytes_saved_ += data.size() - compressed.size();
+  buffer_pool_.Recycle(std::move(data));
+  data = std::move(compressed);
+  return true;
+}
+
+bool Connection::DecompressBody(Message& data) {
+  if (data.size() < sizeof(DataSize)) {
+    LOG(kError) << "Incoming compressed message is too small to hold its size.";
+    return false;
+  }
+  const DataSize uncompressed_size{(((((static_cast<DataSize>(data[0]) << 8) | data[1]) << 8) |
+                                     data[2]) << 8) | data[3]};
+  if (uncompressed_size > MaxMessageSize()) {
+    LOG(kError) << "Incoming compressed message's size of " << uncompressed_size
+                << " bytes exceeds maximum allowed of " << MaxMessageSize() << " bytes.";
+    return false;
+  }
+
+  const auto start(std::chrono::steady_clock::now());
+  Message uncompressed{buffer_pool_.Acquire(uncompressed_size)};
+  const bool decompressed{detail::Decompress(data.data() + sizeof(DataSize),
+                                             data.size() - sizeof(DataSize), uncompressed.data(),
+                                             uncompressed.size())};
+  decompression_nanoseconds_ += std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                    std::chrono::steady_clock::now() - start).count();
+  if (!decompressed) {
+    LOG(kError) << "Incoming compressed message is corrupt.";
+    return false;
+  }
+  buffer_pool_.Recycle(std::move(data));
+  data = std::move(uncompressed);
+  return true;
+}
+
+Connection::SendingMessage Connection::EncodeData(Message data, bool last_chunk) {
   if (data.empty())
     BOOST_THROW_EXCEPTION(MakeError(CommonErrors::outside_of_bounds));
   if (data.size() > MaxMessageSize())
     BOOST_THROW_EXCEPTION(MakeError(VaultManagerErrors::ipc_message_too_large));
 
+  // Compression happens here, on the sending thread, rather than on the strand.
+  const size_t threshold{compression_threshold_};
+  const bool compressed{threshold != 0 && data.size() >= threshold && peer_accepts_compression_ &&
+                        CompressBody(data)};
   SendingMessage message;
+  const DataSize size_field{static_cast<DataSize>(data.size()) |
+                            (last_chunk ? 0U : kMoreChunksFlag) |
+                            (compressed ? kCompressedFlag : 0U)};
   for (int i = 0; i != 4; ++i)
-    message.size_buffer[i] = static_cast<char>(data.size() >> (8 * (3 - i)));
+    message.size_buffer[i] = static_cast<char>(size_field >> (8 * (3 - i)));
   message.data = std::move(data);
 
   return message;
@@ -23,9 +23,11 @@
 
 #include "asio/post.hpp"
 #include "asio/wrap.hpp"
+#include "boost/filesystem/operations.hpp"
 
 #include "maidsafe/common/error.h"
 #include "maidsafe/common/log.h"
+#include "maidsafe/common/make_unique.h"
 #include "maidsafe/common/on_scope_exit.h"
 #include "maidsafe/common/tcp/connection.h"
 
@@ -33,25 +35,119 @@ namespace maidsafe {
 
 namespace tcp {
 
-Listener::Listener(asio::io_service::strand& strand, NewConnectionFunctor on_new_connection)
-    : strand_(strand),
-      stop_listening_flag_(),
+namespace {
+
+#ifdef SO_REUSEPORT
+typedef asio::detail::socket_option::boolean<SOL_SOCKET, SO_REUSEPORT> ReusePort;
+#endif
+
+#ifndef MAIDSAFE_WIN32
+// Removes the file at 'socket_path' if it's a socket which nothing is listening on.  Throws if it's
+// some other type of file or a socket which another listener is still using.
+void RemoveStaleSocket(asio::io_context& io_context,
+                       const asio::local::stream_protocol::endpoint& endpoint,
+                       const boost::filesystem::path& socket_path) {
+  boost::system::error_code ec;
+  const boost::filesystem::file_status status(boost::filesystem::symlink_status(socket_path, ec));
+  if (status.type() == boost::filesystem::file_not_found)
+    return;
+  if (status.type() != boost::filesystem::socket_file) {
+    LOG(kError) << socket_path << " exists and isn't a socket.";
+    BOOST_THROW_EXCEPTION(MakeError(CommonErrors::invalid_argument));
+  }
+  asio::local::stream_protocol::socket probe{io_context};
+  std::error_code connect_ec;
+  probe.connect(endpoint, connect_ec);
+  if (!connect_ec) {
+    LOG(kError) << "Another listener is already using " << socket_path;
+    BOOST_THROW_EXCEPTION(MakeError(CommonErrors::invalid_argument));
+  }
+  boost::filesystem::remove(socket_path, ec);
+}
+#endif
+
+}  // unnamed namespace
+
+Listener::Acceptor::Acceptor(asio::io_service::strand& strand_in,
+                             StrandPicker connection_strand_picker_in)
+    : strand(strand_in),
+      connection_strand_picker(connection_strand_picker_in),
+#ifndef MAIDSAFE_WIN32
+      local_acceptor(strand_in.context()),
+#endif
+      acceptor(strand_in.context()) {}
+
+bool Listener::Acceptor::IsOpen() const {
+#ifndef MAIDSAFE_WIN32
+  if (local_acceptor.is_open())
+    return true;
+#endif
+  return acceptor.is_open();
+}
+
+Listener::Listener(NewConnectionFunctor on_new_connection)
+    : stop_listening_flag_(),
       on_new_connection_(on_new_connection),
-      acceptor_(strand.context()) {}
+      acceptors_(),
+      port_(0),
+      socket_path_() {}
 
 ListenerPtr Listener::MakeShared(asio::io_service::strand& strand,
                                  NewConnectionFunctor on_new_connection, Port desired_port) {
-  ListenerPtr listener{new Listener{strand, on_new_connection}};
+  return MakeShared(strand, on_new_connection, desired_port,
+                    [&strand]() -> asio::io_service::strand& { return strand; });
+}
+
+ListenerPtr Listener::MakeShared(asio::io_service::strand& strand,
+                                 NewConnectionFunctor on_new_connection, Port desired_port,
+                                 StrandPicker connection_strand_picker) {
+  ListenerPtr listener{new Listener{on_new_connection}};
+  listener->acceptors_.emplace_back(
+      maidsafe::make_unique<Acceptor>(strand, connection_strand_picker));
   listener->StartListening(desired_port);
   return listener;
 }
 
-Port Listener::ListeningPort() const { return acceptor_.local_endpoint().port(); }
+ListenerPtr Listener::MakeShared(const AcceptorStrands& acceptor_strands,
+                                 NewConnectionFunctor on_new_connection, Port desired_port) {
+  if (acceptor_strands.empty())
+    BOOST_THROW_EXCEPTION(MakeError(CommonErrors::invalid_argument));
+#ifndef SO_REUSEPORT
+  if (acceptor_strands.size() > 1U) {
+    LOG(kError) << "SO_REUSEPORT isn't supported on this platform.";
+    BOOST_THROW_EXCEPTION(MakeError(CommonErrors::invalid_argument));
+  }
+#endif
+  ListenerPtr listener{new Listener{on_new_connection}};
+  for (asio::io_service::strand& strand : acceptor_strands) {
+    listener->acceptors_.emplace_back(maidsafe::make_unique<Acceptor>(
+        strand, [&strand]() -> asio::io_service::strand& { return strand; }));
+  }
+  listener->StartListening(desired_port);
+  return listener;
+}
+
+#ifndef MAIDSAFE_WIN32
+ListenerPtr Listener::MakeShared(asio::io_service::strand& strand,
+                                 NewConnectionFunctor on_new_connection,
+                                 const boost::filesystem::path& socket_path) {
+  ListenerPtr listener{new Listener{on_new_connection}};
+  listener->acceptors_.emplace_back(maidsafe::make_unique<Acceptor>(
+      strand, [&strand]() -> asio::io_service::strand& { return strand; }));
+  listener->socket_path_ = socket_path;
+  listener->StartListeningLocally();
+  return listener;
+}
+#endif
+
+Port Listener::ListeningPort() const { return port_; }
 
 void Listener::StartListening(Port desired_port) {
+  const auto& first_acceptor(acceptors_.front()->acceptor);
   unsigned attempts{0};
   while (attempts <= kMaxRangeAboveDefaultPort &&
-         desired_port + attempts <= std::numeric_limits<Port>::max() && !acceptor_.is_open()) {
+         desired_port + attempts <= std::numeric_limits<Port>::max() &&
+         !first_acceptor.is_open()) {
     try {
       DoStartListening(static_cast<Port>(desired_port + attempts));
     } catch (const std::exception& e) {
@@ -60,7 +156,7 @@ void Listener::StartListening(Port desired_port) {
       ++attempts;
     }
   }
-  if (!acceptor_.is_open()) {
+  if (!first_acceptor.is_open()) {
     LOG(kError) << "Failed to start listening on any port in the range [" << desired_port << ", "
                 << desired_port + attempts << "]";
     BOOST_THROW_EXCEPTION(MakeError(VaultManagerErrors::failed_to_listen));
@@ -72,16 +168,41 @@ void Listener::DoStartListening(Port port) {
   asio::ip::tcp::endpoint endpoint{asio::ip::address_v6::loopback(), port};
   on_scope_exit cleanup_on_error([&] {
     std::error_code ec;
-    acceptor_.close(ec);
+    for (auto& acceptor : acceptors_)
+      acceptor->acceptor.close(ec);
   });
 
+  // SO_REUSEPORT lets 'bind' succeed on a port already held by another SO_REUSEPORT listener of
+  // the same user, which would then be handed a share of our connections.  So the first acceptor
+  // claims the port without the option, which fails if anything else holds it and fixes the port
+  // if the OS is choosing one.  It then releases the port so that every acceptor can claim it
+  // with the option.
+  Acceptor& first_acceptor(*acceptors_.front());
+  OpenAcceptor(first_acceptor, endpoint, false);
+  endpoint = first_acceptor.acceptor.local_endpoint();
+  port_ = endpoint.port();
+  if (acceptors_.size() > 1U) {
+    first_acceptor.acceptor.close();
+    for (auto& acceptor : acceptors_)
+      OpenAcceptor(*acceptor, endpoint, true);
+  }
+
+  for (auto& acceptor : acceptors_) {
+    acceptor->acceptor.listen(asio::socket_base::max_connections);
+    StartAccept(*acceptor);
+  }
+  cleanup_on_error.Release();
+}
+
+void Listener::OpenAcceptor(Acceptor& acceptor, asio::ip::tcp::endpoint& endpoint,
+                            bool reuse_port) {
   try {
-    acceptor_.open(endpoint.protocol());
+    acceptor.acceptor.open(endpoint.protocol());
   } catch (const std::system_error& error) {
     if (error.code() == std::make_error_code(std::errc::address_family_not_supported)) {
       // Try IPv4 now.
-      endpoint = asio::ip::tcp::endpoint{asio::ip::address_v4::loopback(), port};
-      acceptor_.open(endpoint.protocol());
+      endpoint = asio::ip::tcp::endpoint{asio::ip::address_v4::loopback(), endpoint.port()};
+      acceptor.acceptor.open(endpoint.protocol());
     } else {
       throw;
     }
@@ -96,24 +217,57 @@ void Listener::DoStartListening(Port port) {
 // http://www.unixguide.net/network/socketfaq/4.5.shtml
 // http://old.nabble.com/Port-allocation-problem-on-windows-(incl.-patch)-td28241079.html
 #ifndef MAIDSAFE_WIN32
-  acceptor_.set_option(asio::ip::tcp::acceptor::reuse_address(true));
+  acceptor.acceptor.set_option(asio::ip::tcp::acceptor::reuse_address(true));
+#endif
+#ifdef SO_REUSEPORT
+  if (reuse_port)
+    acceptor.acceptor.set_option(ReusePort(true));
+#else
+  static_cast<void>(reuse_port);
+#endif
+  acceptor.acceptor.bind(endpoint);
+}
+
+#ifndef MAIDSAFE_WIN32
+void Listener::StartListeningLocally() {
+  Acceptor& acceptor(*acceptors_.front());
+  try {
+    const asio::local::stream_protocol::endpoint endpoint{socket_path_.string()};
+    RemoveStaleSocket(acceptor.strand.context(), endpoint, socket_path_);
+    acceptor.local_acceptor.open(endpoint.protocol());
+    acceptor.local_acceptor.bind(endpoint);
+    acceptor.local_acceptor.listen(asio::socket_base::max_connections);
+  } catch (const std::exception& e) {
+    LOG(kError) << "Failed to start listening on " << socket_path_ << ": "
+                << boost::diagnostic_information(e);
+    std::error_code ec;
+    acceptor.local_acceptor.close(ec);
+    BOOST_THROW_EXCEPTION(MakeError(VaultManagerErrors::failed_to_listen));
+  }
+  StartAccept(acceptor);
+}
 #endif
-  acceptor_.bind(endpoint);
-  acceptor_.listen(asio::socket_base::max_connections);
 
+void Listener::StartAccept(Acceptor& acceptor) {
   // The connection object is kept alive in the acceptor handler until HandleAccept() is called.
-  ConnectionPtr connection{Connection::MakeShared(strand_)};
+  ConnectionPtr connection{
+      new Connection{acceptor.connection_strand_picker(), !socket_path_.empty()}};
   ListenerPtr this_ptr{shared_from_this()};
-  acceptor_.async_accept(connection->Socket(), strand_.wrap([this_ptr, connection](
-                                                   const std::error_code& error) {
-                                                 this_ptr->HandleAccept(connection, error);
-                                               }));
-
-  cleanup_on_error.Release();
+  Acceptor* const accepting{&acceptor};
+  auto on_accept(
+      acceptor.strand.wrap([this_ptr, accepting, connection](const std::error_code& error) {
+        this_ptr->HandleAccept(*accepting, connection, error);
+      }));
+#ifndef MAIDSAFE_WIN32
+  if (!socket_path_.empty())
+    return acceptor.local_acceptor.async_accept(connection->LocalSocket(), on_accept);
+#endif
+  acceptor.acceptor.async_accept(connection->Socket(), on_accept);
 }
 
-void Listener::HandleAccept(ConnectionPtr accepted_connection, const std::error_code& ec) {
-  if (!acceptor_.is_open() || strand_.context().stopped())
+void Listener::HandleAccept(Acceptor& acceptor, ConnectionPtr accepted_connection,
+                            const std::error_code& ec) {
+  if (!acceptor.IsOpen() || acceptor.strand.context().stopped())
     return;
 
   if (ec)
@@ -121,27 +275,35 @@ void Listener::HandleAccept(ConnectionPtr accepted_connection, const std::error_
   else
     on_new_connection_(accepted_connection);
 
-  // The connection object is kept alive in the acceptor handler until HandleAccept() is called.
-  ConnectionPtr connection{ Connection::MakeShared(strand_) };
-  ListenerPtr this_ptr{shared_from_this()};
-  acceptor_.async_accept(connection->Socket(), strand_.wrap([this_ptr, connection](
-                                                   const std::error_code& error) {
-                                                 this_ptr->HandleAccept(connection, error);
-                                               }));
+  StartAccept(acceptor);
 }
 
 void Listener::StopListening() {
-  asio::post(strand_.context().get_executor(), [this] { DoStopListening(); });
+  // Each acceptor is closed on its own strand, so as not to race with its accept handler.
+  ListenerPtr this_ptr{shared_from_this()};
+  std::call_once(stop_listening_flag_, [this_ptr] {
+    for (auto& acceptor : this_ptr->acceptors_) {
+      Acceptor* const closing{acceptor.get()};
+      asio::post(closing->strand, [this_ptr, closing] { this_ptr->DoStopListening(*closing); });
+    }
+    // Unlinking the socket file doesn't touch the acceptor, so needn't wait for the strand.
+    if (!this_ptr->socket_path_.empty()) {
+      boost::system::error_code ignored_ec;
+      boost::filesystem::remove(this_ptr->socket_path_, ignored_ec);
+    }
+  });
 }
 
-void Listener::DoStopListening() {
-  std::call_once(stop_listening_flag_, [this] {
-    std::error_code ec;
-    if (acceptor_.is_open())
-      acceptor_.close(ec);
-    if (ec.value() != 0)
-      LOG(kError) << "Acceptor close error: " << ec.message();
-  });
+void Listener::DoStopListening(Acceptor& acceptor) {
+  std::error_code ec;
+  if (acceptor.acceptor.is_open())
+    acceptor.acceptor.close(ec);
+#ifndef MAIDSAFE_WIN32
+  if (acceptor.local_acceptor.is_open())
+    acceptor.local_acceptor.close(ec);
+#endif
+  if (ec.value() != 0)
+    LOG(kError) << "Acceptor close error: " << ec.message();
 }
 
 }  // namespace tcp
@@ -0,0 +1,230 @@
+/*  Copyright 2015 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#include "maidsafe/common/tcp/rpc_channel.h"
+
+#include <exception>
+#include <utility>
+#include <vector>
+
+#include "asio/error.hpp"
+
+#include "maidsafe/common/error.h"
+#include "maidsafe/common/log.h"
+#include "maidsafe/common/tcp/connection.h"
+
+namespace maidsafe {
+
+namespace tcp {
+
+const std::size_t RpcChannel::kTrailerSize;
+
+RpcChannel::RpcChannel(ConnectionPtr connection, std::shared_ptr<TimerWheel> timer_wheel,
+                       RequestFunctor on_request, ConnectionClosedFunctor on_channel_closed)
+    : connection_(std::move(connection)),
+      timer_wheel_(std::move(timer_wheel)),
+      on_request_(std::move(on_request)),
+      on_channel_closed_(std::move(on_channel_closed)),
+      mutex_(),
+      next_id_(0),
+      closed_(false),
+      pending_calls_() {}
+
+RpcChannel::~RpcChannel() {
+  connection_->Close();
+  AbortPendingCalls();
+}
+
+RpcChannelPtr RpcChannel::MakeShared(ConnectionPtr connection,
+                                     std::shared_ptr<TimerWheel> timer_wheel,
+                                     RequestFunctor on_request,
+                                     ConnectionClosedFunctor on_channel_closed) {
+  if (!connection || !timer_wheel)
+    BOOST_THROW_EXCEPTION(MakeError(CommonErrors::null_pointer));
+  RpcChannelPtr channel{new RpcChannel{std::move(connection), std::move(timer_wheel),
+                                       std::move(on_request), std::move(on_channel_closed)}};
+  channel->Start();
+  return channel;
+}
+
+std::size_t RpcChannel::MaxMessageSize() { return Connection::MaxMessageSize() - kTrailerSize; }
+
+void RpcChannel::Start() {
+  // The connection's handlers only hold weak pointers, so that the channel's owner controls its
+  // lifetime.
+  std::weak_ptr<RpcChannel> weak_channel{shared_from_this()};
+  connection_->Start(
+      [weak_channel](Message message) {
+        if (RpcChannelPtr channel = weak_channel.lock())
+          channel->HandleMessage(std::move(message));
+      },
+      [weak_channel] {
+        if (RpcChannelPtr channel = weak_channel.lock())
+          channel->HandleClosed();
+      });
+}
+
+void RpcChannel::Call(Message request, std::chrono::steady_clock::duration timeout,
+                      ReceiveHandler handler) {
+  CheckSize(request);
+  CorrelationId id{0};
+  {
+    std::lock_guard<std::mutex> lock{mutex_};
+    if (!closed_) {
+      // Once the id wraps, skip any still awaiting a response.
+      do {
+        id = next_id_++;
+      } while (pending_calls_.count(id) != 0);
+      TimerWheel::TimerId timer_id{0};
+      if (timeout != std::chrono::steady_clock::duration::zero()) {
+        // The wheel never invokes a handler while scheduling, so holding 'mutex_' here is safe.
+        std::weak_ptr<RpcChannel> weak_channel{shared_from_this()};
+        timer_id = timer_wheel_->Schedule(timeout, [weak_channel, id] {
+          if (RpcChannelPtr channel = weak_channel.lock())
+            channel->HandleTimeout(id);
+        });
+      }
+      pending_calls_.emplace(id, PendingCall{std::move(handler), timer_id});
+      handler = nullptr;
+    }
+  }
+  if (handler)
+    return handler(asio::error::make_error_code(asio::error::operation_aborted), Message());
+  Send(std::move(request), id, Kind::kRequest);
+}
+
+std::future<Message> RpcChannel::Call(Message request,
+                                      std::chrono::steady_clock::duration timeout) {
+  auto promise(std::make_shared<std::promise<Message>>());
+  std::future<Message> future{promise->get_future()};
+  Call(std::move(request), timeout, [promise](std::error_code ec, Message response) {
+    if (ec)
+      promise->set_exception(std::make_exception_ptr(maidsafe_error(ec)));
+    else
+      promise->set_value(std::move(response));
+  });
+  return future;
+}
+
+void RpcChannel::Close() { connection_->Close(); }
+
+std::size_t RpcChannel::InFlight() const {
+  std::lock_guard<std::mutex> lock{mutex_};
+  return pending_calls_.size();
+}
+
+void RpcChannel::HandleMessage(Message message) {
+  if (message.size() < kTrailerSize) {
+    LOG(kError) << "Received message is too small to hold an RPC trailer.";
+    return connection_->Close();
+  }
+  const byte* const trailer{message.data() + message.size() - kTrailerSize};
+  const CorrelationId id{(static_cast<CorrelationId>(trailer[0]) << 24) |
+                         (static_cast<CorrelationId>(trailer[1]) << 16) |
+                         (static_cast<CorrelationId>(trailer[2]) << 8) |
+                         static_cast<CorrelationId>(trailer[3])};
+  const byte kind{trailer[4]};
+  message.resize(message.size() - kTrailerSize);
+
+  if (kind == static_cast<byte>(Kind::kRequest)) {
+    if (!on_request_) {
+      LOG(kWarning) << "No handler for incoming request " << id << "; ignoring it.";
+      return;
+    }
+    std::weak_ptr<RpcChannel> weak_channel{shared_from_this()};
+    return on_request_(std::move(message), [weak_channel, id](Message response) {
+      if (RpcChannelPtr channel = weak_channel.lock())
+        channel->Send(std::move(response), id, Kind::kResponse);
+    });
+  }
+  if (kind != static_cast<byte>(Kind::kResponse)) {
+    LOG(kError) << "Received message has invalid RPC kind " << static_cast<int>(kind) << '.';
+    return connection_->Close();
+  }
+
+  PendingCall pending_call;
+  {
+    std::lock_guard<std::mutex> lock{mutex_};
+    auto itr(pending_calls_.find(id));
+    if (itr == std::end(pending_calls_)) {
+      LOG(kVerbose) << "Dropping response to unknown or timed out request " << id << '.';
+      return;
+    }
+    pending_call = std::move(itr->second);
+    pending_calls_.erase(itr);
+  }
+  if (pending_call.timer_id != 0)
+    timer_wheel_->Cancel(pending_call.timer_id);
+  pending_call.handler(std::error_code(), std::move(message));
+}
+
+void RpcChannel::HandleTimeout(CorrelationId id) {
+  ReceiveHandler handler;
+  {
+    std::lock_guard<std::mutex> lock{mutex_};
+    auto itr(pending_calls_.find(id));
+    if (itr == std::end(pending_calls_))
+      return;
+    handler = std::move(itr->second.handler);
+    pending_calls_.erase(itr);
+  }
+  handler(asio::error::make_error_code(asio::error::timed_out), Message());
+}
+
+void RpcChannel::HandleClosed() {
+  AbortPendingCalls();
+  if (on_channel_closed_)
+    on_channel_closed_();
+}
+
+void RpcChannel::AbortPendingCalls() {
+  std::unordered_map<CorrelationId, PendingCall> aborted_calls;
+  {
+    std::lock_guard<std::mutex> lock{mutex_};
+    closed_ = true;
+    aborted_calls.swap(pending_calls_);
+  }
+  const std::error_code aborted(asio::error::make_error_code(asio::error::operation_aborted));
+  for (auto& aborted_call : aborted_calls) {
+    if (aborted_call.second.timer_id != 0)
+      timer_wheel_->Cancel(aborted_call.second.timer_id);
+    aborted_call.second.handler(aborted, Message());
+  }
+}
+
+void RpcChannel::CheckSize(const Message& message) const {
+  if (message.size() > MaxMessageSize()) {
+    LOG(kError) << "Message size " << message.size() << " bytes exceeds maximum RPC size of "
+                << MaxMessageSize() << " bytes.";
+    BOOST_THROW_EXCEPTION(MakeError(CommonErrors::invalid_argument));
+  }
+}
+
+void RpcChannel::Send(Message message, CorrelationId id, Kind kind) {
+  CheckSize(message);
+  const byte trailer[kTrailerSize] = {
+      static_cast<byte>(id >> 24), static_cast<byte>(id >> 16), static_cast<byte>(id >> 8),
+      static_cast<byte>(id), static_cast<byte>(kind)};
+  // Only reallocates (and so copies the payload) if there's no spare capacity for the trailer.
+  message.insert(std::end(message), trailer, trailer + kTrailerSize);
+  connection_->Send(std::move(message));
+}
+
+}  // namespace tcp
+
+}  // namespace maidsafe
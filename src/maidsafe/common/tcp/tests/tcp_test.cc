@@ -19,17 +19,29 @@
 #include <algorithm>
 #include <array>
 #include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <exception>
 #include <future>
 #include <mutex>
+#include <set>
 #include <string>
+#include <thread>
 #include <utility>
 #include <vector>
 
+#ifndef MAIDSAFE_WIN32
+#include <unistd.h>
+#endif
+
 #include "asio/buffer.hpp"
+#include "asio/coroutine.hpp"
 #include "asio/error.hpp"
 #include "asio/io_service.hpp"
 #include "asio/ip/tcp.hpp"
 #include "asio/write.hpp"
+#include "boost/filesystem/operations.hpp"
 
 #include "maidsafe/common/asio_service.h"
 #include "maidsafe/common/make_unique.h"
@@ -37,9 +49,12 @@
 #include "maidsafe/common/test.h"
 #include "maidsafe/common/utils.h"
 #include "maidsafe/common/config.h"
+#include "maidsafe/common/tcp/buffer_pool.h"
+#include "maidsafe/common/tcp/compression.h"
 #include "maidsafe/common/tcp/connection.h"
 #include "maidsafe/common/tcp/listener.h"
-
+#include "maidsafe/common/tcp/rpc_channel.h"
+#include "maidsafe/common/timer_wheel.h"
 
 namespace maidsafe {
 
@@ -99,6 +114,42 @@ class Messages {
   mutable std::mutex mutex_;
 };
 
+#include "asio/yield.hpp"
+
+// Sends each message in turn, waiting for it to be echoed back before sending the next.
+class EchoCoroutine : public asio::coroutine {
+ public:
+  EchoCoroutine(ConnectionPtr connection, std::shared_ptr<const std::vector<Message>> messages,
+                std::shared_ptr<std::promise<size_t>> echoed_count)
+      : connection_(std::move(connection)),
+        messages_(std::move(messages)),
+        echoed_count_(std::move(echoed_count)),
+        index_(0) {}
+
+  void operator()(std::error_code ec = std::error_code(), Message received = Message()) {
+    if (ec)
+      return echoed_count_->set_value(index_);
+    reenter(this) {
+      for (index_ = 0; index_ != messages_->size(); ++index_) {
+        yield connection_->Send((*messages_)[index_], *this);
+        yield connection_->Receive(*this);
+        if (received != (*messages_)[index_]) {
+          yield break;
+        }
+      }
+      echoed_count_->set_value(index_);
+    }
+  }
+
+ private:
+  ConnectionPtr connection_;
+  std::shared_ptr<const std::vector<Message>> messages_;
+  std::shared_ptr<std::promise<size_t>> echoed_count_;
+  size_t index_;
+};
+
+#include "asio/unyield.hpp"
+
 class TcpTest : public testing::Test {
  protected:
   TcpTest()
@@ -148,6 +199,59 @@ class TcpTest : public testing::Test {
   asio::io_service::strand client_strand_, server_strand_;
 };
 
+TEST(BufferPoolTest, BEH_AcquireAndRecycle) {
+  BufferPool buffer_pool(2, 1000);
+  Message buffer(buffer_pool.Acquire(100));
+  EXPECT_EQ(buffer.size(), 100U);
+  EXPECT_EQ(buffer_pool.Size(), 0U);
+
+  // Buffers which are empty or too large aren't kept.
+  buffer_pool.Recycle(Message());
+  buffer_pool.Recycle(Message(1001));
+  EXPECT_EQ(buffer_pool.Size(), 0U);
+
+  // A recycled buffer is handed out again without reallocating.
+  const byte* const data(buffer.data());
+  buffer_pool.Recycle(std::move(buffer));
+  EXPECT_EQ(buffer_pool.Size(), 1U);
+  buffer = buffer_pool.Acquire(50);
+  EXPECT_EQ(buffer.size(), 50U);
+  EXPECT_EQ(buffer.data(), data);
+  EXPECT_EQ(buffer_pool.Size(), 0U);
+
+  // The pool is bounded, and prefers a buffer which is already large enough.
+  Message small(10), large(500);
+  const byte* const large_data(large.data());
+  buffer_pool.Recycle(std::move(small));
+  buffer_pool.Recycle(std::move(large));
+  buffer_pool.Recycle(std::move(buffer));
+  EXPECT_EQ(buffer_pool.Size(), 2U);
+  buffer = buffer_pool.Acquire(400);
+  EXPECT_EQ(buffer.data(), large_data);
+
+  // The smallest buffer which is large enough is chosen, and if none is, a new one is allocated.
+  BufferPool best_fit_pool(3, 1000);
+  Message first(500), second(100), third(300);
+  const byte* const second_data(second.data());
+  const byte* const third_data(third.data());
+  best_fit_pool.Recycle(std::move(first));
+  best_fit_pool.Recycle(std::move(second));
+  best_fit_pool.Recycle(std::move(third));
+  EXPECT_EQ(best_fit_pool.Acquire(50).data(), second_data);
+  EXPECT_EQ(best_fit_pool.Acquire(200).data(), third_data);
+  EXPECT_EQ(best_fit_pool.Acquire(600).size(), 600U);
+  EXPECT_EQ(best_fit_pool.Size(), 1U);
+  EXPECT_EQ(best_fit_pool.Bytes(), 500U);
+
+  // The pool is also bounded by the total capacity of its buffers.
+  best_fit_pool.Recycle(Message(400));
+  best_fit_pool.Recycle(Message(200));
+  EXPECT_EQ(best_fit_pool.Size(), 2U);
+  EXPECT_EQ(best_fit_pool.Bytes(), 900U);
+  best_fit_pool.Acquire(450);
+  EXPECT_EQ(best_fit_pool.Bytes(), 400U);
+}
+
 TEST_F(TcpTest, BEH_Basic) {
   const size_t kMessageCount(10);
   AddRandomMessage(to_client_messages_, 1);
@@ -417,6 +521,867 @@ TEST_F(TcpTest, BEH_MultipleConnectionsToServer) {
   server_connections.clear();
 }
 
+TEST_F(TcpTest, BEH_ConnectionsSpreadAcrossServices) {
+  const size_t kServiceCount(3), kClientCount(6);
+  AsioService per_thread_service(kServiceCount, IoServiceMode::kServicePerThread);
+  std::vector<std::unique_ptr<asio::io_service::strand>> strands;
+  for (size_t i(0); i != kServiceCount; ++i)
+    strands.emplace_back(maidsafe::make_unique<asio::io_service::strand>(
+        per_thread_service.NextService()));
+  size_t next_strand{0};
+
+  std::mutex mutex;
+  std::condition_variable cond_var;
+  std::vector<ConnectionPtr> server_connections;
+  std::set<std::thread::id> server_threads;
+  AddRandomMessage(to_server_messages_, 1000);
+  for (size_t i(1); i != kClientCount; ++i)
+    to_server_messages_.push_back(to_server_messages_.front());
+  InitialiseMessagesToServer();
+
+  ListenerPtr listener{Listener::MakeShared(
+      *strands.front(),
+      [&](ConnectionPtr connection) {
+        connection->Start(
+            [&](Message message) {
+              {
+                std::lock_guard<std::mutex> lock{mutex};
+                server_threads.insert(std::this_thread::get_id());
+              }
+              messages_received_by_server_->AddMessage(std::move(message));
+            },
+            [] {});
+        {
+          std::lock_guard<std::mutex> lock{mutex};
+          server_connections.push_back(connection);
+        }
+        cond_var.notify_one();
+      },
+      Port{7777}, [&]() -> asio::io_service::strand& {
+        return *strands[next_strand++ % strands.size()];
+      })};
+  on_scope_exit stop_listening([listener] { listener->StopListening(); });
+
+  std::vector<ConnectionAndCloser> client_connections_and_closers;
+  for (size_t i(0); i != kClientCount; ++i) {
+    client_connections_and_closers.emplace_back(
+        GenerateClientConnection(listener->ListeningPort(), [](Message) {}, [] {}));
+  }
+  {
+    std::unique_lock<std::mutex> lock{mutex};
+    ASSERT_TRUE(cond_var.wait_for(lock, std::chrono::seconds(10),
+                                  [&] { return server_connections.size() == kClientCount; }));
+  }
+  for (auto& client_connection_and_closer : client_connections_and_closers)
+    client_connection_and_closer.first->Send(to_server_messages_.front());
+  EXPECT_EQ(messages_received_by_server_->MessagesMatch(), Messages::Status::kSuccess);
+
+  // Accepted connections were assigned to the io_services (each with its own thread) round-robin.
+  {
+    std::lock_guard<std::mutex> lock{mutex};
+    EXPECT_EQ(server_threads.size(), kServiceCount);
+  }
+
+  for (auto& server_connection : server_connections)
+    server_connection->Close();
+  client_connections_and_closers.clear();
+  listener->StopListening();
+  per_thread_service.Stop();
+}
+
+TEST_F(TcpTest, BEH_CoroutineSendAndReceive) {
+  std::promise<ConnectionPtr> server_promise;
+  ListenerAndCloser listener_and_closer{GenerateListener(
+      server_strand_,
+      [&](ConnectionPtr connection) {
+        std::weak_ptr<Connection> weak_connection(connection);
+        connection->Start([weak_connection](Message message) {
+                            if (ConnectionPtr echoer = weak_connection.lock())
+                              echoer->Send(std::move(message));
+                          },
+                          [] {});
+        server_promise.set_value(connection);
+      },
+      Port{7777})};
+  ConnectionPtr client{Connection::MakeShared(client_strand_,
+                                              listener_and_closer.first->ListeningPort())};
+  ConnectionPtr server_connection{server_promise.get_future().get()};
+
+  auto messages(std::make_shared<std::vector<Message>>());
+  for (size_t i(1); i != 100; ++i)
+    AddRandomMessage(*messages, i * 97);
+  AddRandomMessage(*messages, Connection::MaxMessageSize());
+  auto echoed_count(std::make_shared<std::promise<size_t>>());
+  std::future<size_t> echoed_future(echoed_count->get_future());
+  asio_service_.Spawn(EchoCoroutine(client, messages, echoed_count));
+  ASSERT_EQ(echoed_future.wait_for(std::chrono::seconds(10)), std::future_status::ready);
+  EXPECT_EQ(echoed_future.get(), messages->size());
+
+  // Several receives can be outstanding at once; they complete in order.
+  std::mutex mutex;
+  std::condition_variable cond_var;
+  std::vector<Message> received;
+  std::vector<std::error_code> send_results;
+  for (size_t i(0); i != 3; ++i) {
+    client->Receive([&](std::error_code ec, Message message) {
+      EXPECT_FALSE(ec);
+      std::lock_guard<std::mutex> lock{mutex};
+      received.push_back(std::move(message));
+      cond_var.notify_one();
+    });
+  }
+  for (size_t i(0); i != 3; ++i) {
+    client->Send((*messages)[i], [&](std::error_code ec) {
+      std::lock_guard<std::mutex> lock{mutex};
+      send_results.push_back(ec);
+      cond_var.notify_one();
+    });
+  }
+  {
+    std::unique_lock<std::mutex> lock{mutex};
+    ASSERT_TRUE(cond_var.wait_for(lock, std::chrono::seconds(10), [&] {
+      return received.size() == 3U && send_results.size() == 3U;
+    }));
+    EXPECT_TRUE(std::equal(std::begin(received), std::end(received), std::begin(*messages)));
+    EXPECT_EQ(std::count(std::begin(send_results), std::end(send_results), std::error_code()), 3);
+  }
+
+  // Pending and subsequent handlers are aborted once the connection closes.
+  std::promise<std::error_code> pending_receive, late_receive, late_send;
+  client->Receive([&](std::error_code ec, Message) { pending_receive.set_value(ec); });
+  client->Close();
+  client->Receive([&](std::error_code ec, Message) { late_receive.set_value(ec); });
+  client->Send((*messages)[0], [&](std::error_code ec) { late_send.set_value(ec); });
+  const std::error_code aborted(asio::error::make_error_code(asio::error::operation_aborted));
+  EXPECT_EQ(pending_receive.get_future().get(), aborted);
+  EXPECT_EQ(late_receive.get_future().get(), aborted);
+  EXPECT_EQ(late_send.get_future().get(), aborted);
+  server_connection->Close();
+}
+
+TEST_F(TcpTest, BEH_WriteCoalescing) {
+  std::mutex mutex;
+  std::condition_variable cond_var;
+  std::vector<Message> received;
+  std::promise<ConnectionPtr> server_promise;
+  ListenerAndCloser listener_and_closer{GenerateListener(
+      server_strand_,
+      [&](ConnectionPtr connection) {
+        connection->Start(
+            [&](Message message) {
+              std::lock_guard<std::mutex> lock{mutex};
+              received.push_back(std::move(message));
+              cond_var.notify_one();
+            },
+            [] {});
+        server_promise.set_value(connection);
+      },
+      Port{7777})};
+  ConnectionAndCloser client_connection_and_closer{
+      GenerateClientConnection(listener_and_closer.first->ListeningPort(), [](Message) {}, [] {})};
+  ConnectionPtr client{client_connection_and_closer.first};
+  ConnectionPtr server_connection{server_promise.get_future().get()};
+  EXPECT_THROW(client->SetWriteCoalescingLimits(0, 1024), maidsafe_error);
+
+  // Bursts of small messages are gathered into writes limited by message count or total size, but
+  // each message is still delivered intact, in order, with its own completion handler invoked.
+  const std::vector<std::pair<size_t, size_t>> limits{
+      {1, Connection::kDefaultMaxCoalescedBytes}, {7, 1024 * 1024}, {1000, 1000}, {1000, 1}};
+  std::vector<Message> sent;
+  size_t sent_handler_count{0};
+  for (const auto& limit : limits) {
+    client->SetWriteCoalescingLimits(limit.first, limit.second);
+    for (size_t i(0); i != 500; ++i) {
+      AddRandomMessage(sent, 1 + (i * 37) % 300);
+      client->Send(sent.back(), [&](std::error_code ec) {
+        EXPECT_FALSE(ec);
+        std::lock_guard<std::mutex> lock{mutex};
+        ++sent_handler_count;
+        cond_var.notify_one();
+      });
+    }
+  }
+  {
+    std::unique_lock<std::mutex> lock{mutex};
+    ASSERT_TRUE(cond_var.wait_for(lock, std::chrono::seconds(10), [&] {
+      return received.size() == sent.size() && sent_handler_count == sent.size();
+    }));
+    EXPECT_TRUE(received == sent);
+  }
+  server_connection->Close();
+}
+
+TEST_F(TcpTest, BEH_ReadBatching) {
+  std::mutex mutex;
+  std::condition_variable cond_var;
+  std::vector<Message> received;
+  std::promise<ConnectionPtr> server_promise;
+  ListenerAndCloser listener_and_closer{GenerateListener(
+      server_strand_,
+      [&](ConnectionPtr connection) {
+        connection->Start(
+            [&](Message message) {
+              std::lock_guard<std::mutex> lock{mutex};
+              received.push_back(std::move(message));
+              cond_var.notify_one();
+            },
+            [] {});
+        server_promise.set_value(connection);
+      },
+      Port{7777})};
+  ConnectionAndCloser client_connection_and_closer{
+      GenerateClientConnection(listener_and_closer.first->ListeningPort(), [](Message) {}, [] {})};
+  ConnectionPtr client{client_connection_and_closer.first};
+  ConnectionPtr server_connection{server_promise.get_future().get()};
+
+  // A burst of small messages needs far fewer reads than messages.
+  std::vector<Message> sent;
+  const size_t kSmallMessageCount{2000};
+  for (size_t i(0); i != kSmallMessageCount; ++i) {
+    AddRandomMessage(sent, 1 + (i * 37) % 300);
+    client->Send(sent.back());
+  }
+  {
+    std::unique_lock<std::mutex> lock{mutex};
+    ASSERT_TRUE(cond_var.wait_for(lock, std::chrono::seconds(10),
+                                  [&] { return received.size() == sent.size(); }));
+    EXPECT_TRUE(received == sent);
+  }
+  EXPECT_LT(server_connection->ReadOperationCount(), kSmallMessageCount / 2);
+
+  // Messages either side of the direct read threshold and of the read buffer size, interleaved
+  // with small ones so that bodies straddle reads.
+  for (size_t size : {Connection::kDirectReadThreshold - 1, Connection::kDirectReadThreshold,
+                      Connection::kReadBufferSize - 4, Connection::kReadBufferSize,
+                      Connection::kReadBufferSize + 1, Connection::MaxMessageSize()}) {
+    AddRandomMessage(sent, size);
+    client->Send(sent.back());
+    for (size_t i(0); i != 10; ++i) {
+      AddRandomMessage(sent, 1 + i * 1000);
+      client->Send(sent.back());
+    }
+  }
+  {
+    std::unique_lock<std::mutex> lock{mutex};
+    ASSERT_TRUE(cond_var.wait_for(lock, std::chrono::seconds(10),
+                                  [&] { return received.size() == sent.size(); }));
+    EXPECT_TRUE(received == sent);
+  }
+  server_connection->Close();
+}
+
+TEST_F(TcpTest, BEH_ChunkedMessages) {
+  std::mutex mutex;
+  std::condition_variable cond_var;
+  std::vector<std::pair<Message, bool>> chunks_received;
+  std::vector<Message> messages_received;
+  bool reassembling_connection_closed{false};
+  std::vector<ConnectionPtr> server_connections;
+  ListenerAndCloser listener_and_closer{GenerateListener(
+      server_strand_,
+      [&](ConnectionPtr connection) {
+        std::lock_guard<std::mutex> lock{mutex};
+        if (server_connections.empty()) {
+          connection->StartStreaming(
+              [&](Message chunk, bool last_chunk) {
+                std::lock_guard<std::mutex> chunk_lock{mutex};
+                chunks_received.emplace_back(std::move(chunk), last_chunk);
+                cond_var.notify_one();
+              },
+              [] {});
+        } else {
+          connection->SetReassemblyLimit(4 * Connection::MaxMessageSize());
+          connection->Start(
+              [&](Message message) {
+                std::lock_guard<std::mutex> message_lock{mutex};
+                messages_received.push_back(std::move(message));
+                cond_var.notify_one();
+              },
+              [&] {
+                std::lock_guard<std::mutex> closed_lock{mutex};
+                reassembling_connection_closed = true;
+                cond_var.notify_one();
+              });
+        }
+        server_connections.push_back(connection);
+        cond_var.notify_one();
+      },
+      Port{7777})};
+
+  // Sends 'message' in chunks of up to 'chunk_size' bytes, with at most two chunks in flight.
+  auto send_in_chunks([&](ConnectionPtr client, const Message& message, size_t chunk_size) {
+    size_t sent{0}, chunks_in_flight{0};
+    while (sent != message.size()) {
+      const size_t size{std::min(chunk_size, message.size() - sent)};
+      {
+        std::unique_lock<std::mutex> lock{mutex};
+        ASSERT_TRUE(cond_var.wait_for(lock, std::chrono::seconds(10),
+                                      [&] { return chunks_in_flight < 2; }));
+        ++chunks_in_flight;
+      }
+      client->SendChunk(Message(std::begin(message) + sent, std::begin(message) + sent + size),
+                        sent + size == message.size(), [&](std::error_code ec) {
+                          EXPECT_FALSE(ec);
+                          std::lock_guard<std::mutex> sent_lock{mutex};
+                          --chunks_in_flight;
+                          cond_var.notify_one();
+                        });
+      sent += size;
+    }
+    std::unique_lock<std::mutex> lock{mutex};
+    ASSERT_TRUE(cond_var.wait_for(lock, std::chrono::seconds(10),
+                                  [&] { return chunks_in_flight == 0; }));
+  });
+
+  std::vector<Message> messages;
+  AddRandomMessage(messages, 3 * Connection::MaxMessageSize() + 1000);
+  AddRandomMessage(messages, 500);
+  AddRandomMessage(messages, 4 * Connection::MaxMessageSize());
+
+  {
+    // Chunks are passed on as they arrive; an ordinary message is a single last chunk.
+    ConnectionAndCloser client_connection_and_closer{GenerateClientConnection(
+        listener_and_closer.first->ListeningPort(), [](Message) {}, [] {})};
+    ConnectionPtr client{client_connection_and_closer.first};
+    EXPECT_THROW(client->SendChunk(Message(Connection::MaxMessageSize() + 1), false),
+                 maidsafe_error);
+    send_in_chunks(client, messages[0], Connection::MaxMessageSize());
+    client->Send(messages[1]);
+    std::unique_lock<std::mutex> lock{mutex};
+    ASSERT_TRUE(cond_var.wait_for(lock, std::chrono::seconds(10), [&] {
+      return !chunks_received.empty() && chunks_received.back().first.size() == 500U;
+    }));
+    ASSERT_EQ(chunks_received.size(), 5U);
+    Message reassembled;
+    for (size_t i(0); i != 4; ++i) {
+      EXPECT_LE(chunks_received[i].first.size(), Connection::MaxMessageSize());
+      EXPECT_EQ(chunks_received[i].second, i == 3);
+      reassembled.insert(std::end(reassembled), std::begin(chunks_received[i].first),
+                         std::end(chunks_received[i].first));
+    }
+    EXPECT_TRUE(reassembled == messages[0]);
+    EXPECT_TRUE(chunks_received[4].second);
+    EXPECT_TRUE(chunks_received[4].first == messages[1]);
+  }
+
+  {
+    // Chunked messages are reassembled up to the limit, and the connection is closed beyond it.
+    ConnectionAndCloser client_connection_and_closer{GenerateClientConnection(
+        listener_and_closer.first->ListeningPort(), [](Message) {}, [] {})};
+    ConnectionPtr client{client_connection_and_closer.first};
+    send_in_chunks(client, messages[2], 300 * 1024);
+    client->Send(messages[1]);
+    {
+      std::unique_lock<std::mutex> lock{mutex};
+      ASSERT_TRUE(cond_var.wait_for(lock, std::chrono::seconds(10),
+                                    [&] { return messages_received.size() == 2U; }));
+      EXPECT_TRUE(messages_received[0] == messages[2]);
+      EXPECT_TRUE(messages_received[1] == messages[1]);
+    }
+    for (size_t i(0); i != 5; ++i)
+      client->SendChunk(Message(Connection::MaxMessageSize()), i == 4);
+    std::unique_lock<std::mutex> lock{mutex};
+    ASSERT_TRUE(cond_var.wait_for(lock, std::chrono::seconds(10),
+                                  [&] { return reassembling_connection_closed; }));
+    EXPECT_EQ(messages_received.size(), 2U);
+  }
+  std::lock_guard<std::mutex> lock{mutex};
+  for (auto& server_connection : server_connections)
+    server_connection->Close();
+}
+
+TEST_F(TcpTest, BEH_SendBackpressure) {
+  std::promise<ConnectionPtr> server_promise;
+  ListenerAndCloser listener_and_closer{
+      GenerateListener(server_strand_,
+                       [&](ConnectionPtr connection) { server_promise.set_value(connection); },
+                       Port{7777})};
+  ConnectionAndCloser client_connection_and_closer{
+      GenerateClientConnection(listener_and_closer.first->ListeningPort(), [](Message) {}, [] {})};
+  ConnectionPtr client{client_connection_and_closer.first};
+  // The server doesn't start reading yet, so the client's queue backs up once the socket buffers
+  // are full.
+  ConnectionPtr server_connection{server_promise.get_future().get()};
+
+  const size_t kHighWatermark{1024 * 1024}, kLowWatermark{256 * 1024}, kMessageSize{64 * 1024};
+  EXPECT_THROW(client->SetSendWatermarks(kLowWatermark, kLowWatermark, [] {}), maidsafe_error);
+  std::mutex mutex;
+  std::condition_variable cond_var;
+  bool writable{false};
+  size_t queued_bytes_when_writable{0};
+  client->SetSendWatermarks(kHighWatermark, kLowWatermark, [&] {
+    std::lock_guard<std::mutex> lock{mutex};
+    writable = true;
+    queued_bytes_when_writable = client->QueuedBytes();
+    cond_var.notify_one();
+  });
+
+  std::atomic<size_t> received_count{0};
+  size_t sent_count{0};
+  while (client->TrySend(Message(kMessageSize, 'A'))) {
+    ++sent_count;
+    ASSERT_LT(sent_count, 10000U) << "Send queue never reached the high watermark.";
+  }
+  EXPECT_GE(client->QueuedBytes(), kHighWatermark);
+  EXPECT_LT(client->QueuedBytes(), kHighWatermark + kMessageSize + 4);
+  EXPECT_GE(client->PeakQueuedBytes(), client->QueuedBytes());
+  {
+    // The queue may already have crossed both watermarks while the socket buffers were filling.
+    std::lock_guard<std::mutex> lock{mutex};
+    writable = false;
+  }
+
+  // Once the peer reads, the queue drains below the low watermark and the producer is told.
+  server_connection->Start([&](Message) {
+    std::lock_guard<std::mutex> lock{mutex};
+    ++received_count;
+    cond_var.notify_one();
+  }, [] {});
+  {
+    std::unique_lock<std::mutex> lock{mutex};
+    ASSERT_TRUE(cond_var.wait_for(lock, std::chrono::seconds(10), [&] {
+      return writable && client->QueuedBytes() < kHighWatermark;
+    }));
+    EXPECT_LE(queued_bytes_when_writable, kLowWatermark);
+  }
+  EXPECT_TRUE(client->TrySend(Message(kMessageSize, 'A')));
+  ++sent_count;
+  {
+    std::unique_lock<std::mutex> lock{mutex};
+    EXPECT_TRUE(cond_var.wait_for(lock, std::chrono::seconds(10),
+                                  [&] { return received_count == sent_count; }));
+  }
+  // The peer can receive the last message before the client's write handler has run.
+  const auto deadline(std::chrono::steady_clock::now() + std::chrono::seconds(10));
+  while (client->QueuedBytes() != 0 && std::chrono::steady_clock::now() < deadline)
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  EXPECT_EQ(client->QueuedBytes(), 0U);
+  server_connection->Close();
+}
+
+TEST_F(TcpTest, BEH_MultipleAcceptors) {
+  EXPECT_THROW(Listener::MakeShared(Listener::AcceptorStrands(), [](ConnectionPtr) {}, Port{7777}),
+               maidsafe_error);
+
+  const size_t kServiceCount(4), kClientCount(40);
+  AsioService per_thread_service(kServiceCount, IoServiceMode::kServicePerThread);
+  std::vector<std::unique_ptr<asio::io_service::strand>> strands;
+  Listener::AcceptorStrands acceptor_strands;
+  for (size_t i(0); i != kServiceCount; ++i) {
+    strands.emplace_back(maidsafe::make_unique<asio::io_service::strand>(
+        per_thread_service.NextService()));
+    acceptor_strands.emplace_back(*strands.back());
+  }
+
+  std::mutex mutex;
+  std::condition_variable cond_var;
+  std::vector<ConnectionPtr> server_connections;
+  std::set<std::thread::id> accepting_threads;
+  AddRandomMessage(to_server_messages_, 1000);
+  for (size_t i(1); i != kClientCount; ++i)
+    to_server_messages_.push_back(to_server_messages_.front());
+  InitialiseMessagesToServer();
+
+  ListenerPtr listener{Listener::MakeShared(
+      acceptor_strands,
+      [&](ConnectionPtr connection) {
+        connection->Start(
+            [&](Message message) { messages_received_by_server_->AddMessage(std::move(message)); },
+            [] {});
+        std::lock_guard<std::mutex> lock{mutex};
+        accepting_threads.insert(std::this_thread::get_id());
+        server_connections.push_back(connection);
+        cond_var.notify_one();
+      },
+      Port{0})};
+  on_scope_exit stop_listening([listener] { listener->StopListening(); });
+
+  // Another SO_REUSEPORT listener mustn't share the port.
+  ListenerPtr other_listener{
+      Listener::MakeShared(acceptor_strands, [](ConnectionPtr) {}, listener->ListeningPort())};
+  EXPECT_NE(other_listener->ListeningPort(), listener->ListeningPort());
+  other_listener->StopListening();
+
+  std::vector<ConnectionAndCloser> client_connections_and_closers;
+  for (size_t i(0); i != kClientCount; ++i) {
+    client_connections_and_closers.emplace_back(
+        GenerateClientConnection(listener->ListeningPort(), [](Message) {}, [] {}));
+  }
+  {
+    std::unique_lock<std::mutex> lock{mutex};
+    ASSERT_TRUE(cond_var.wait_for(lock, std::chrono::seconds(10),
+                                  [&] { return server_connections.size() == kClientCount; }));
+  }
+  for (auto& client_connection_and_closer : client_connections_and_closers)
+    client_connection_and_closer.first->Send(to_server_messages_.front());
+  EXPECT_EQ(messages_received_by_server_->MessagesMatch(), Messages::Status::kSuccess);
+
+  // The kernel hashes each connection to one of the acceptors, so with this many clients it's
+  // vanishingly unlikely that a single acceptor (and hence thread) took them all, unless the
+  // acceptors were bound to different ports when the OS chose the port.
+  {
+    std::lock_guard<std::mutex> lock{mutex};
+    EXPECT_GT(accepting_threads.size(), 1U);
+  }
+
+  for (auto& server_connection : server_connections)
+    server_connection->Close();
+  client_connections_and_closers.clear();
+  listener->StopListening();
+  per_thread_service.Stop();
+}
+
+TEST(CompressionTest, BEH_RoundTrip) {
+  // Text-like input built from a small vocabulary of random words compresses well; random input
+  // doesn't fit in a buffer smaller than itself.
+  std::vector<std::string> words;
+  for (int i(0); i != 32; ++i)
+    words.push_back(RandomString(1 + i % 12));
+  std::vector<Message> inputs{Message(), Message(1, 'a'), Message(100000, 0)};
+  Message text;
+  while (text.size() < 300000) {
+    const std::string& word(words[RandomUint32() % words.size()]);
+    text.insert(text.end(), word.begin(), word.end());
+  }
+  inputs.push_back(text);
+  const std::string random(RandomString(70000));
+  inputs.emplace_back(random.begin(), random.end());
+  for (const auto& input : inputs) {
+    Message compressed(input.size() + input.size() / 255 + 16);
+    const std::size_t compressed_size{detail::Compress(input.data(), input.size(),
+                                                       compressed.data(), compressed.size())};
+    ASSERT_NE(compressed_size, 0U);
+    compressed.resize(compressed_size);
+    Message output(input.size());
+    EXPECT_TRUE(detail::Decompress(compressed.data(), compressed.size(), output.data(),
+                                   output.size()));
+    EXPECT_TRUE(output == input);
+    if (input.size() > 1000) {
+      const bool compressible{&input != &inputs.back()};
+      EXPECT_EQ(compressible, compressed.size() < input.size() / 2);
+      EXPECT_EQ(compressible, detail::Compress(input.data(), input.size(), compressed.data(),
+                                               input.size() - input.size() / 8) != 0);
+    }
+
+    // Corrupt or truncated input, or the wrong output size, is rejected.
+    if (!input.empty()) {
+      EXPECT_FALSE(detail::Decompress(compressed.data(), compressed.size() - 1, output.data(),
+                                      output.size()));
+      EXPECT_FALSE(detail::Decompress(compressed.data(), compressed.size(), output.data(),
+                                      output.size() - 1));
+    }
+    for (int i(0); i != 100 && !compressed.empty(); ++i) {
+      Message corrupted(compressed);
+      corrupted[RandomUint32() % corrupted.size()] ^= static_cast<byte>(1 + RandomUint32() % 255);
+      detail::Decompress(corrupted.data(), corrupted.size(), output.data(), output.size());
+    }
+  }
+}
+
+TEST_F(TcpTest, BEH_Compression) {
+  std::mutex mutex;
+  std::condition_variable cond_var;
+  std::vector<Message> received_by_client, received_by_server;
+  auto receiver([&](std::vector<Message>& received) {
+    return [&](Message message) {
+      std::lock_guard<std::mutex> lock{mutex};
+      received.push_back(std::move(message));
+      cond_var.notify_one();
+    };
+  });
+  auto wait_for([&](const std::vector<Message>& received, const std::vector<Message>& sent) {
+    std::unique_lock<std::mutex> lock{mutex};
+    ASSERT_TRUE(cond_var.wait_for(lock, std::chrono::seconds(10),
+                                  [&] { return received.size() == sent.size(); }));
+    EXPECT_TRUE(received == sent);
+  });
+
+  std::promise<ConnectionPtr> server_promise;
+  ListenerAndCloser listener_and_closer{GenerateListener(
+      server_strand_,
+      [&](ConnectionPtr connection) {
+        connection->Start(receiver(received_by_server), [] {});
+        server_promise.set_value(connection);
+      },
+      Port{7777})};
+  ConnectionAndCloser client_connection_and_closer{GenerateClientConnection(
+      listener_and_closer.first->ListeningPort(), receiver(received_by_client), [] {})};
+  ConnectionPtr client{client_connection_and_closer.first};
+  ConnectionPtr server_connection{server_promise.get_future().get()};
+  EXPECT_THROW(client->EnableCompression(0), maidsafe_error);
+  EXPECT_THROW(client->EnableCompression(Connection::kMinCompressionThreshold - 1),
+               maidsafe_error);
+
+  // Small compressible, large compressible (read directly into a body buffer even once
+  // compressed) and incompressible messages.
+  std::vector<Message> messages{Message(100, 'a'), Message(100000, 'a')};
+  std::vector<std::string> words;
+  for (int i(0); i != 1000; ++i)
+    words.push_back(RandomAlphaNumericString(1 + i % 8) + ' ');
+  Message text;
+  while (text.size() < 512 * 1024) {
+    const std::string& word(words[RandomUint32() % words.size()]);
+    text.insert(text.end(), word.begin(), word.end());
+  }
+  messages.push_back(text);
+  AddRandomMessage(messages, 100000);
+
+  // Nothing is compressed until both ends have enabled compression.
+  client->EnableCompression(1000);
+  for (const auto& message : messages)
+    client->Send(message);
+  wait_for(received_by_server, messages);
+  EXPECT_EQ(client->GetCompressionStats().compressed_frames, 0U);
+  EXPECT_EQ(client->GetCompressionStats().skipped_frames, 0U);
+
+  // The server's announcement precedes its messages, so once they've arrived the client knows.
+  server_connection->EnableCompression(1000);
+  for (const auto& message : messages)
+    server_connection->Send(message);
+  wait_for(received_by_client, messages);
+  {
+    std::lock_guard<std::mutex> lock{mutex};
+    received_by_server.clear();
+  }
+  for (const auto& message : messages)
+    client->Send(message);
+  wait_for(received_by_server, messages);
+
+  for (const auto& connection : {client, server_connection}) {
+    const Connection::CompressionStats stats{connection->GetCompressionStats()};
+    EXPECT_EQ(stats.compressed_frames, 2U);
+    EXPECT_EQ(stats.skipped_frames, 1U);
+    EXPECT_GT(stats.bytes_saved, 99000U + text.size() / 8);
+    EXPECT_GT(stats.compression_time.count(), 0);
+    EXPECT_GT(stats.decompression_time.count(), 0);
+  }
+  server_connection->Close();
+}
+
+TEST_F(TcpTest, BEH_RpcChannel) {
+  const size_t kPipelinedCount(100);
+  const Message kIgnoredRequest{'i', 'g', 'n', 'o', 'r', 'e'};
+  std::shared_ptr<TimerWheel> timer_wheel{
+      TimerWheel::MakeShared(asio_service_, std::chrono::milliseconds(5))};
+
+  // The server holds back its responses to the pipelined requests until it has them all, then
+  // answers them in reverse order.
+  std::mutex mutex;
+  std::vector<std::pair<Message, RpcChannel::Responder>> held_requests;
+  auto on_request([&](Message request, RpcChannel::Responder respond) {
+    // The stripped trailer leaves room for the response's, so echoing the request doesn't copy it.
+    EXPECT_GE(request.capacity(), request.size() + RpcChannel::kTrailerSize);
+    if (request == kIgnoredRequest)
+      return;
+    if (request.size() != sizeof(std::uint32_t))
+      return respond(std::move(request));
+    std::vector<std::pair<Message, RpcChannel::Responder>> to_answer;
+    {
+      std::lock_guard<std::mutex> lock{mutex};
+      held_requests.emplace_back(std::move(request), std::move(respond));
+      if (held_requests.size() == kPipelinedCount)
+        to_answer.swap(held_requests);
+    }
+    for (auto itr(to_answer.rbegin()); itr != to_answer.rend(); ++itr) {
+      Message response(itr->first);
+      response.push_back(0xff);
+      itr->second(std::move(response));
+    }
+  });
+
+  std::promise<RpcChannelPtr> server_promise;
+  std::promise<void> server_closed;
+  ListenerAndCloser listener_and_closer{GenerateListener(
+      server_strand_,
+      [&](ConnectionPtr connection) {
+        server_promise.set_value(RpcChannel::MakeShared(connection, timer_wheel, on_request,
+                                                        [&] { server_closed.set_value(); }));
+      },
+      Port{7777})};
+  std::promise<void> client_closed;
+  RpcChannelPtr client{RpcChannel::MakeShared(
+      Connection::MakeShared(client_strand_, listener_and_closer.first->ListeningPort()),
+      timer_wheel, nullptr, [&] { client_closed.set_value(); })};
+  RpcChannelPtr server{server_promise.get_future().get()};
+
+  // Pipelined requests are matched with their out-of-order responses.
+  std::vector<std::promise<Message>> responses(kPipelinedCount);
+  for (std::uint32_t i(0); i != kPipelinedCount; ++i) {
+    Message request(sizeof(i));
+    std::memcpy(request.data(), &i, sizeof(i));
+    client->Call(std::move(request), std::chrono::seconds(10),
+                 [&responses, i](std::error_code ec, Message response) {
+                   if (ec)
+                     responses[i].set_exception(std::make_exception_ptr(maidsafe_error(ec)));
+                   else
+                     responses[i].set_value(std::move(response));
+                 });
+  }
+  for (std::uint32_t i(0); i != kPipelinedCount; ++i) {
+    Message response(responses[i].get_future().get());
+    ASSERT_EQ(sizeof(i) + 1, response.size());
+    std::uint32_t echoed;
+    std::memcpy(&echoed, response.data(), sizeof(echoed));
+    EXPECT_EQ(i, echoed);
+    EXPECT_EQ(0xff, response.back());
+  }
+  EXPECT_EQ(0U, client->InFlight());
+
+  // Either end can issue requests, via the future-based API too.
+  const Message kEmpty, kLarge(RpcChannel::MaxMessageSize(), 'L');
+  EXPECT_EQ(kEmpty, client->Call(kEmpty, std::chrono::seconds(10)).get());
+  EXPECT_EQ(kLarge, client->Call(kLarge, std::chrono::seconds(10)).get());
+  EXPECT_THROW(client->Call(Message(RpcChannel::MaxMessageSize() + 1), std::chrono::seconds(10)),
+               maidsafe_error);
+  std::future<Message> unanswered{server->Call(kEmpty, std::chrono::milliseconds(50))};
+
+  // Requests which aren't answered time out, and are aborted if the channel closes.
+  std::future<Message> timed_out{client->Call(kIgnoredRequest, std::chrono::milliseconds(50))};
+  std::future<Message> aborted{client->Call(kIgnoredRequest, std::chrono::seconds(0))};
+  try {
+    timed_out.get();
+    ADD_FAILURE() << "Request should have timed out.";
+  } catch (const maidsafe_error& error) {
+    EXPECT_EQ(asio::error::make_error_code(asio::error::timed_out), error.code());
+  }
+  try {
+    unanswered.get();
+    ADD_FAILURE() << "Request should have timed out.";
+  } catch (const maidsafe_error& error) {
+    EXPECT_EQ(asio::error::make_error_code(asio::error::timed_out), error.code());
+  }
+  EXPECT_EQ(1U, client->InFlight());
+  server->Close();
+  EXPECT_EQ(std::future_status::ready,
+            server_closed.get_future().wait_for(std::chrono::seconds(10)));
+  EXPECT_EQ(std::future_status::ready,
+            client_closed.get_future().wait_for(std::chrono::seconds(10)));
+  try {
+    aborted.get();
+    ADD_FAILURE() << "Request should have been aborted.";
+  } catch (const maidsafe_error& error) {
+    EXPECT_EQ(asio::error::make_error_code(asio::error::operation_aborted), error.code());
+  }
+  EXPECT_EQ(0U, client->InFlight());
+
+  // Once closed, calls fail immediately.
+  std::error_code call_error;
+  client->Call(kEmpty, std::chrono::seconds(10),
+               [&](std::error_code ec, Message) { call_error = ec; });
+  EXPECT_EQ(asio::error::make_error_code(asio::error::operation_aborted), call_error);
+  timer_wheel->CancelAll();
+}
+
+#ifndef MAIDSAFE_WIN32
+TEST_F(TcpTest, BEH_LocalConnections) {
+  maidsafe::test::TestPath test_path(maidsafe::test::CreateTestPath("MaidSafe_Test_Tcp"));
+  const boost::filesystem::path kSocketPath{*test_path / "socket"};
+  AddRandomMessage(to_client_messages_, 1);
+  AddRandomMessage(to_server_messages_, 1);
+  for (size_t i(2); i < 10; ++i) {
+    AddRandomMessage(to_client_messages_, i * 100000);
+    AddRandomMessage(to_server_messages_, i * 100000);
+  }
+  InitialiseMessagesToClient();
+  InitialiseMessagesToServer();
+
+  std::promise<ConnectionPtr> server_promise;
+  ListenerPtr listener{Listener::MakeShared(
+      server_strand_,
+      [&](ConnectionPtr connection) { server_promise.set_value(std::move(connection)); },
+      kSocketPath)};
+  on_scope_exit stop_listening([listener] { listener->StopListening(); });
+  EXPECT_EQ(0, listener->ListeningPort());
+  EXPECT_TRUE(boost::filesystem::exists(kSocketPath));
+
+  // A path holding anything but a stale socket is left alone.
+  {
+    const boost::filesystem::path kOtherSocketPath{*test_path / "other_socket"};
+    ListenerPtr other_listener{
+        Listener::MakeShared(server_strand_, [](ConnectionPtr) {}, kOtherSocketPath)};
+    EXPECT_THROW(Listener::MakeShared(server_strand_, [](ConnectionPtr) {}, kOtherSocketPath),
+                 maidsafe_error);
+    EXPECT_TRUE(boost::filesystem::exists(kOtherSocketPath));
+    other_listener->StopListening();
+    const boost::filesystem::path kFilePath{*test_path / "file"};
+    ASSERT_TRUE(WriteFile(kFilePath, std::vector<byte>(10, 0)));
+    EXPECT_THROW(Listener::MakeShared(server_strand_, [](ConnectionPtr) {}, kFilePath),
+                 maidsafe_error);
+    EXPECT_TRUE(boost::filesystem::exists(kFilePath));
+  }
+
+  ConnectionPtr client_connection{Connection::MakeShared(client_strand_, kSocketPath)};
+  on_scope_exit close_client([client_connection] { client_connection->Close(); });
+  EXPECT_TRUE(client_connection->IsLocal());
+  std::promise<std::pair<Message, int>> descriptor_promise;
+  client_connection->SetDescriptorReceivedFunctor([&](Message message, int descriptor) {
+    descriptor_promise.set_value(std::make_pair(std::move(message), descriptor));
+  });
+  client_connection->Start(
+      [&](Message message) { messages_received_by_client_->AddMessage(std::move(message)); },
+      [] {});
+
+  ConnectionPtr server_connection{server_promise.get_future().get()};
+  on_scope_exit close_server([server_connection] { server_connection->Close(); });
+  EXPECT_TRUE(server_connection->IsLocal());
+  server_connection->Start(
+      [&](Message message) { messages_received_by_server_->AddMessage(std::move(message)); },
+      [] {});
+
+  // Framing is identical to TCP.
+  for (size_t i(0); i < to_client_messages_.size(); ++i) {
+    server_connection->Send(to_client_messages_[i]);
+    client_connection->Send(to_server_messages_[i]);
+  }
+  EXPECT_EQ(messages_received_by_client_->MessagesMatch(), Messages::Status::kSuccess);
+  EXPECT_EQ(messages_received_by_server_->MessagesMatch(), Messages::Status::kSuccess);
+
+  // Pass the write end of a pipe to the client, which writes into it; the server then reads what
+  // the client wrote from the read end.
+  int pipe_descriptors[2];
+  ASSERT_EQ(0, pipe(pipe_descriptors));
+  on_scope_exit close_pipe([&] {
+    close(pipe_descriptors[0]);
+    close(pipe_descriptors[1]);
+  });
+  const Message kDescriptorMessage{'p', 'i', 'p', 'e'};
+  server_connection->SendWithDescriptor(kDescriptorMessage, pipe_descriptors[1]);
+  auto descriptor_future(descriptor_promise.get_future());
+  ASSERT_EQ(std::future_status::ready, descriptor_future.wait_for(std::chrono::seconds(10)));
+  std::pair<Message, int> received(descriptor_future.get());
+  EXPECT_EQ(kDescriptorMessage, received.first);
+  ASSERT_GE(received.second, 0);
+  EXPECT_NE(pipe_descriptors[1], received.second);
+  const char kWritten[] = "written by client";
+  EXPECT_EQ(static_cast<ssize_t>(sizeof(kWritten)),
+            write(received.second, kWritten, sizeof(kWritten)));
+  close(received.second);
+  char read_back[sizeof(kWritten)] = {};
+  EXPECT_EQ(static_cast<ssize_t>(sizeof(kWritten)),
+            read(pipe_descriptors[0], read_back, sizeof(read_back)));
+  EXPECT_STREQ(kWritten, read_back);
+
+  // Descriptors can't be passed over a TCP connection.
+  std::promise<ConnectionPtr> tcp_server_promise;
+  ListenerAndCloser listener_and_closer{GenerateListener(
+      server_strand_,
+      [&](ConnectionPtr connection) { tcp_server_promise.set_value(std::move(connection)); },
+      Port{7777})};
+  ConnectionAndCloser tcp_client_and_closer{GenerateClientConnection(
+      listener_and_closer.first->ListeningPort(), [](Message) {}, [] {})};
+  EXPECT_FALSE(tcp_client_and_closer.first->IsLocal());
+  EXPECT_THROW(tcp_client_and_closer.first->SendWithDescriptor(kDescriptorMessage,
+                                                               pipe_descriptors[1]),
+               maidsafe_error);
+  tcp_server_promise.get_future().get()->Close();
+
+  server_connection->Close();
+  client_connection->Close();
+  listener->StopListening();
+  EXPECT_FALSE(boost::filesystem::exists(kSocketPath));
+}
+#endif
+
 }  // namespace test
 
 }  // namespace tcp
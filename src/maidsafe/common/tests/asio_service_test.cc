@@ -18,9 +18,14 @@
 
 #include "maidsafe/common/asio_service.h"
 
+#include <algorithm>
+#include <atomic>
 #include <chrono>
 #include <condition_variable>
+#include <functional>
 #include <mutex>
+#include <thread>
+#include <vector>
 
 #include "boost/date_time/posix_time/posix_time.hpp"
 
@@ -74,6 +79,146 @@ TYPED_TEST(AsioServiceTest, BEH_StartAndStop) {
   EXPECT_FALSE(done);
 }
 
+TYPED_TEST(AsioServiceTest, BEH_ServicePerThread) {
+  EXPECT_THROW(IoService<TypeParam>(0, IoServiceMode::kServicePerThread), maidsafe_error);
+
+  IoService<TypeParam> shared_asio_service(3, IoServiceMode::kShared);
+  EXPECT_EQ(shared_asio_service.Mode(), IoServiceMode::kShared);
+  EXPECT_EQ(shared_asio_service.ServiceCount(), 1U);
+  EXPECT_EQ(&shared_asio_service.NextService(), &shared_asio_service.service());
+
+  const size_t kThreadCount(4);
+  IoService<TypeParam> asio_service(kThreadCount, IoServiceMode::kServicePerThread, true);
+  EXPECT_EQ(asio_service.Mode(), IoServiceMode::kServicePerThread);
+  EXPECT_EQ(asio_service.ThreadCount(), kThreadCount);
+  ASSERT_EQ(asio_service.ServiceCount(), kThreadCount);
+  EXPECT_EQ(&asio_service.service(), &asio_service.service(0));
+  EXPECT_EQ(&asio_service.ServiceFor(kThreadCount + 1), &asio_service.service(1));
+
+  // Round-robin selection visits every io_service once per cycle.
+  std::vector<TypeParam*> picked;
+  for (size_t i(0); i != kThreadCount; ++i)
+    picked.push_back(&asio_service.NextService());
+  std::sort(std::begin(picked), std::end(picked));
+  EXPECT_EQ(std::unique(std::begin(picked), std::end(picked)), std::end(picked));
+
+  // Each io_service is run by its own thread.
+  std::mutex mutex;
+  std::condition_variable cond_var;
+  std::vector<std::thread::id> thread_ids;
+  for (size_t i(0); i != kThreadCount; ++i) {
+    asio_service.service(i).post([&] {
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        thread_ids.push_back(std::this_thread::get_id());
+      }
+      cond_var.notify_one();
+    });
+  }
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    ASSERT_TRUE(cond_var.wait_for(lock, std::chrono::seconds(1),
+                                  [&] { return thread_ids.size() == kThreadCount; }));
+  }
+  std::sort(std::begin(thread_ids), std::end(thread_ids));
+  EXPECT_EQ(std::unique(std::begin(thread_ids), std::end(thread_ids)), std::end(thread_ids));
+
+  EXPECT_NO_THROW(asio_service.Stop());
+  EXPECT_EQ(asio_service.ThreadCount(), 0U);
+}
+
+TYPED_TEST(AsioServiceTest, BEH_HandlerInstrumentation) {
+  const size_t kThreadCount(2);
+  IoService<TypeParam> asio_service(kThreadCount, IoServiceMode::kServicePerThread);
+  std::atomic<int> executed_count(0);
+  auto wait_for_count([&](int count) {
+    const auto timeout(std::chrono::steady_clock::now() + std::chrono::seconds(2));
+    while (executed_count != count && std::chrono::steady_clock::now() < timeout)
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    return executed_count == count;
+  });
+
+  // Nothing is recorded while disabled.
+  EXPECT_FALSE(asio_service.InstrumentationEnabled());
+  asio_service.Post([&] { ++executed_count; });
+  ASSERT_TRUE(wait_for_count(1));
+  EXPECT_EQ(asio_service.InstrumentationStatistics().execution.count, 0U);
+
+  const int kHandlerCount(20);
+  static const char* const kSlowHandlerName("slow handler");
+  asio_service.EnableInstrumentation(std::chrono::milliseconds(5));
+  EXPECT_TRUE(asio_service.InstrumentationEnabled());
+  asio_service.Post([&] {
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    ++executed_count;
+  }, kSlowHandlerName);
+  for (int i(1); i != kHandlerCount; ++i)
+    asio_service.Post([&] { ++executed_count; }, "fast handler");
+  ASSERT_TRUE(wait_for_count(kHandlerCount + 1));
+
+  // The statistics are updated just after each handler returns, so allow a little time for that.
+  HandlerStatistics statistics;
+  const auto timeout(std::chrono::steady_clock::now() + std::chrono::seconds(2));
+  do {
+    statistics = asio_service.InstrumentationStatistics();
+  } while (statistics.execution.count != static_cast<uint64_t>(kHandlerCount) &&
+           std::chrono::steady_clock::now() < timeout);
+  EXPECT_EQ(statistics.execution.count, static_cast<uint64_t>(kHandlerCount));
+  EXPECT_EQ(statistics.queue_wait.count, static_cast<uint64_t>(kHandlerCount));
+  EXPECT_EQ(statistics.queue_depth, 0U);
+  EXPECT_GE(statistics.max_queue_depth, 1U);
+  EXPECT_GE(statistics.execution.max, std::chrono::milliseconds(20));
+  EXPECT_GE(statistics.execution.Percentile(100.0), std::chrono::milliseconds(20));
+  EXPECT_LE(statistics.execution.Percentile(50.0), statistics.execution.max);
+  ASSERT_EQ(statistics.slow_handlers.size(), 1U);
+  EXPECT_EQ(statistics.slow_handlers.front().name, kSlowHandlerName);
+  ASSERT_EQ(statistics.threads.size(), kThreadCount);
+  double total_busy_ratio(0.0);
+  for (const auto& thread : statistics.threads) {
+    EXPECT_GE(thread.BusyRatio(), 0.0);
+    EXPECT_LE(thread.BusyRatio(), 1.0);
+    total_busy_ratio += thread.BusyRatio();
+  }
+  EXPECT_GT(total_busy_ratio, 0.0);
+
+  asio_service.DisableInstrumentation();
+  asio_service.Post([&] { ++executed_count; });
+  ASSERT_TRUE(wait_for_count(kHandlerCount + 2));
+  EXPECT_EQ(asio_service.InstrumentationStatistics().execution.count,
+            static_cast<uint64_t>(kHandlerCount));
+
+  // Re-enabling resets the statistics.
+  asio_service.EnableInstrumentation(std::chrono::nanoseconds(0));
+  statistics = asio_service.InstrumentationStatistics();
+  EXPECT_EQ(statistics.execution.count, 0U);
+  EXPECT_TRUE(statistics.slow_handlers.empty());
+
+  // A handler destroyed without running no longer counts towards the queue depth.
+  HandlerInstrumentation instrumentation((std::vector<std::thread::id>()));
+  {
+    InstrumentedHandler<std::function<void()>> handler([] {}, instrumentation, "dropped");
+    InstrumentedHandler<std::function<void()>> copied(handler);
+    InstrumentedHandler<std::function<void()>> moved(std::move(copied));
+    EXPECT_EQ(instrumentation.Statistics().queue_depth, 1U);
+  }
+  EXPECT_EQ(instrumentation.Statistics().queue_depth, 0U);
+  EXPECT_EQ(instrumentation.Statistics().execution.count, 0U);
+
+  // Copying leaves the source usable, and only the first copy to run reports completion.
+  int run_count(0);
+  {
+    InstrumentedHandler<std::function<void()>> handler([&] { ++run_count; }, instrumentation,
+                                                       "copied");
+    InstrumentedHandler<std::function<void()>> copied(handler);
+    EXPECT_EQ(instrumentation.Statistics().queue_depth, 1U);
+    handler();
+    copied();
+  }
+  EXPECT_EQ(run_count, 2);
+  EXPECT_EQ(instrumentation.Statistics().queue_depth, 0U);
+  EXPECT_EQ(instrumentation.Statistics().execution.count, 1U);
+}
+
 }  // namespace test
 
 }  // namespace maidsafe
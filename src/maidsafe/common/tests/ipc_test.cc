@@ -36,6 +36,7 @@ extern "C" char** environ;
 #include "maidsafe/common/config.h"
 #include "maidsafe/common/crypto.h"
 #include "maidsafe/common/encode.h"
+#include "maidsafe/common/error.h"
 #include "maidsafe/common/on_scope_exit.h"
 #include "maidsafe/common/process.h"
 #include "maidsafe/common/test.h"
@@ -141,6 +142,62 @@ TEST(IpcTest, FUNC_IpcFunctionsThreaded) {
   RemoveSharedMemory(kTestName);
 }
 
+TEST(IpcTest, BEH_BinaryItems) {
+  const std::string kTestName(RandomString(8));
+  struct Clean {
+    explicit Clean(std::string test_name) : kTestName(test_name) { RemoveSharedMemory(kTestName); }
+    ~Clean() { RemoveSharedMemory(kTestName); }
+    const std::string kTestName;
+  } cleanup(kTestName);
+
+  // Far more than the 65536 bytes which 'CreateSharedMemory' allows, including empty items and
+  // items holding nulls.
+  std::vector<std::string> items(1, std::string());
+  items.emplace_back(std::string("a\0b\0", 4));
+  std::size_t total_size(4);
+  for (int i(0); i < 100; ++i) {
+    items.emplace_back(RandomString(5000 + i));
+    total_size += items.back().size();
+  }
+  items.emplace_back(RandomString(1024 * 1024));
+  total_size += items.back().size();
+  EXPECT_THROW(AppendSharedMemory(kTestName, items), bi::interprocess_exception);
+  EXPECT_THROW(SharedMemoryReader{kTestName}, bi::interprocess_exception);
+  ASSERT_NO_THROW(WriteSharedMemory(kTestName, items));
+
+  {
+    // The segment is sized to fit the items, and they're stored without encoding.
+    bi::managed_shared_memory segment(bi::open_only, hex::Encode(kTestName).c_str());
+    EXPECT_GE(segment.get_size(), total_size);
+    EXPECT_LT(segment.get_size(), total_size + 100 * items.size() + 4096);
+  }
+
+  {
+    SharedMemoryReader reader(kTestName);
+    ASSERT_EQ(reader.Size(), items.size());
+    const std::vector<boost::string_ref> views(reader.Items());
+    ASSERT_EQ(views.size(), items.size());
+    for (std::size_t i(0); i < items.size(); ++i) {
+      EXPECT_EQ(views[i], items[i]);
+      EXPECT_EQ(reader[i], items[i]);
+      // Both give views of the shared memory itself rather than copies.
+      EXPECT_EQ(reader[i].data(), views[i].data());
+    }
+    EXPECT_THROW(reader[items.size()], maidsafe_error);
+  }
+
+  // Appending grows the segment.
+  std::vector<std::string> more_items;
+  for (int i(0); i < 10; ++i)
+    more_items.emplace_back(RandomString(100000));
+  ASSERT_NO_THROW(AppendSharedMemory(kTestName, more_items));
+  items.insert(items.end(), more_items.begin(), more_items.end());
+  SharedMemoryReader reader(kTestName);
+  ASSERT_EQ(reader.Size(), items.size());
+  for (std::size_t i(0); i < items.size(); ++i)
+    EXPECT_EQ(reader[i], items[i]);
+}
+
 TEST(IpcTest, FUNC_IpcFunctionsUsingBoostProcess) {
   const std::string kTestName(RandomString(8));
   struct Clean {
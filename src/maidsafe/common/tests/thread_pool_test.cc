@@ -0,0 +1,171 @@
+/*  Copyright 2015 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#include "maidsafe/common/thread_pool.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <future>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "asio/dispatch.hpp"
+#include "asio/post.hpp"
+
+#include "maidsafe/common/error.h"
+#include "maidsafe/common/test.h"
+
+namespace maidsafe {
+
+namespace test {
+
+TEST(ThreadPoolTest, BEH_PostAndStop) {
+  EXPECT_THROW(ThreadPool(0), maidsafe_error);
+
+  std::atomic<int> count(0);
+  ThreadPool thread_pool(4);
+  EXPECT_EQ(thread_pool.ThreadCount(), 4U);
+  for (int i(0); i != 1000; ++i)
+    thread_pool.Post([&] { ++count; });
+
+  // Tasks queued before 'Stop()' are run; those posted afterwards are discarded.
+  EXPECT_NO_THROW(thread_pool.Stop());
+  EXPECT_EQ(count, 1000);
+  thread_pool.Post([&] { ++count; });
+  EXPECT_NO_THROW(thread_pool.Stop());
+  EXPECT_EQ(count, 1000);
+}
+
+TEST(ThreadPoolTest, BEH_NestedPosts) {
+  std::atomic<int> count(0);
+  {
+    ThreadPool thread_pool(3);
+    for (int i(0); i != 100; ++i) {
+      thread_pool.Post([&] {
+        for (int j(0); j != 100; ++j)
+          thread_pool.Post([&] { ++count; });
+      });
+    }
+  }
+  EXPECT_EQ(count, 10000);
+}
+
+TEST(ThreadPoolTest, BEH_StopFromPoolThread) {
+  ThreadPool thread_pool(2);
+  std::future<void> result(thread_pool.Async([&] { thread_pool.Stop(); }));
+  EXPECT_THROW(result.get(), maidsafe_error);
+}
+
+TEST(ThreadPoolTest, BEH_IdleWorkersTakeNewTasks) {
+  // Each task waits for the other to start, so they only both finish if they run concurrently.
+  ThreadPool thread_pool(4);
+  std::atomic<bool> first_started(false), second_started(false);
+  const auto wait_for([](const std::atomic<bool>& flag) {
+    const auto deadline(std::chrono::steady_clock::now() + std::chrono::seconds(5));
+    while (!flag && std::chrono::steady_clock::now() < deadline)
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    return flag.load();
+  });
+  std::future<bool> first(thread_pool.Async([&] {
+    first_started = true;
+    return wait_for(second_started);
+  }));
+  ASSERT_TRUE(wait_for(first_started));
+  std::future<bool> second(thread_pool.Async([&] {
+    second_started = true;
+    return wait_for(first_started);
+  }));
+  EXPECT_TRUE(first.get());
+  EXPECT_TRUE(second.get());
+}
+
+TEST(ThreadPoolTest, BEH_Async) {
+  ThreadPool thread_pool(2);
+  std::vector<std::future<int>> results;
+  for (int i(0); i != 100; ++i)
+    results.emplace_back(thread_pool.Async([i] { return i * i; }));
+  for (int i(0); i != 100; ++i)
+    EXPECT_EQ(results[i].get(), i * i);
+
+  std::future<void> failure(thread_pool.Async([] { throw std::runtime_error("Failure"); }));
+  EXPECT_THROW(failure.get(), std::runtime_error);
+
+  // Move-only functors are supported.
+  std::promise<int> promise;
+  std::future<int> future(promise.get_future());
+  thread_pool.Post(std::bind([](std::promise<int>& p) { p.set_value(1); }, std::move(promise)));
+  EXPECT_EQ(future.get(), 1);
+}
+
+TEST(ThreadPoolTest, BEH_AsioExecutor) {
+  ThreadPool thread_pool(2);
+  ThreadPool::executor_type executor(thread_pool.get_executor());
+  EXPECT_TRUE(executor == thread_pool.get_executor());
+  EXPECT_FALSE(executor.running_in_this_thread());
+
+  std::promise<bool> posted;
+  asio::post(executor, [&] { posted.set_value(thread_pool.RunningInThisThread()); });
+  EXPECT_TRUE(posted.get_future().get());
+
+  // 'dispatch' from within the pool runs the handler immediately.
+  std::promise<bool> dispatched;
+  asio::post(executor, [&] {
+    bool ran_inline(false);
+    asio::dispatch(executor, [&] { ran_inline = true; });
+    dispatched.set_value(ran_inline);
+  });
+  EXPECT_TRUE(dispatched.get_future().get());
+}
+
+TEST(ThreadPoolTest, BEH_ParallelFor) {
+  ThreadPool thread_pool(4);
+  const std::size_t kSize(100000);
+  std::vector<std::uint32_t> values(kSize, 0);
+  thread_pool.ParallelFor(0, kSize, [&](std::size_t index) {
+    values[index] = static_cast<std::uint32_t>(index);
+  });
+  for (std::size_t i(0); i != kSize; ++i)
+    ASSERT_EQ(values[i], i);
+
+  // Empty and single-element ranges, and explicit grain sizes.
+  std::atomic<int> count(0);
+  thread_pool.ParallelFor(10, 10, [&](std::size_t) { ++count; });
+  EXPECT_EQ(count, 0);
+  thread_pool.ParallelFor(10, 11, [&](std::size_t) { ++count; });
+  EXPECT_EQ(count, 1);
+  thread_pool.ParallelFor(0, 1000, [&](std::size_t) { ++count; }, 7);
+  EXPECT_EQ(count, 1001);
+
+  // Nested calls from within the pool mustn't deadlock, even if every worker is blocked in one.
+  count = 0;
+  thread_pool.ParallelFor(0, 16, [&](std::size_t) {
+    thread_pool.ParallelFor(0, 100, [&](std::size_t) { ++count; }, 1);
+  }, 1);
+  EXPECT_EQ(count, 1600);
+
+  EXPECT_THROW(thread_pool.ParallelFor(0, 1000, [](std::size_t index) {
+    if (index == 500)
+      throw std::runtime_error("Failure");
+  }), std::runtime_error);
+}
+
+}  // namespace test
+
+}  // namespace maidsafe
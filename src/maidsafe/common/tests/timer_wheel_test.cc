@@ -0,0 +1,202 @@
+/*  Copyright 2015 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#include "maidsafe/common/timer_wheel.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "maidsafe/common/test.h"
+
+namespace maidsafe {
+
+namespace test {
+
+namespace {
+
+typedef std::chrono::steady_clock::time_point TimePoint;
+
+bool WaitFor(const std::function<bool()>& predicate,
+             std::chrono::steady_clock::duration timeout = std::chrono::seconds(5)) {
+  const TimePoint deadline(std::chrono::steady_clock::now() + timeout);
+  while (!predicate()) {
+    if (std::chrono::steady_clock::now() > deadline)
+      return false;
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  return true;
+}
+
+}  // unnamed namespace
+
+TEST(TimerWheelTest, BEH_InvalidTick) {
+  AsioService asio_service(1);
+  EXPECT_THROW(TimerWheel::MakeShared(asio_service, std::chrono::milliseconds(0)),
+               maidsafe_error);
+}
+
+TEST(TimerWheelTest, BEH_ExpiresNoEarlierThanTimeout) {
+  AsioService asio_service(2);
+  const auto tick(std::chrono::milliseconds(5));
+  auto timer_wheel(TimerWheel::MakeShared(asio_service, tick));
+  EXPECT_EQ(timer_wheel->Tick(), tick);
+
+  // Spans several root slots and the first cascade (256 ticks).
+  const std::vector<std::chrono::milliseconds> timeouts{
+      std::chrono::milliseconds(0), std::chrono::milliseconds(1), std::chrono::milliseconds(7),
+      std::chrono::milliseconds(50), std::chrono::milliseconds(600), std::chrono::milliseconds(1400)};
+  std::mutex mutex;
+  std::vector<TimePoint> fired(timeouts.size());
+  std::atomic<std::size_t> fired_count(0);
+  const TimePoint start(std::chrono::steady_clock::now());
+  for (std::size_t i(0); i != timeouts.size(); ++i) {
+    timer_wheel->Schedule(timeouts[i], [&, i] {
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        fired[i] = std::chrono::steady_clock::now();
+      }
+      ++fired_count;
+    });
+  }
+  EXPECT_EQ(timer_wheel->Size(), timeouts.size());
+  ASSERT_TRUE(WaitFor([&] { return fired_count == timeouts.size(); }));
+  EXPECT_EQ(timer_wheel->Size(), 0U);
+  std::lock_guard<std::mutex> lock(mutex);
+  for (std::size_t i(0); i != timeouts.size(); ++i)
+    EXPECT_GE(fired[i] - start, timeouts[i]) << "Timeout " << timeouts[i].count() << " ms";
+}
+
+TEST(TimerWheelTest, BEH_Cancel) {
+  AsioService asio_service(1);
+  auto timer_wheel(TimerWheel::MakeShared(asio_service, std::chrono::milliseconds(1)));
+  std::atomic<int> fired_count(0);
+  EXPECT_FALSE(timer_wheel->Cancel(TimerWheel::TimerId()));
+
+  const TimerWheel::TimerId cancelled(
+      timer_wheel->Schedule(std::chrono::milliseconds(20), [&] { fired_count += 100; }));
+  const TimerWheel::TimerId expiring(
+      timer_wheel->Schedule(std::chrono::milliseconds(10), [&] { ++fired_count; }));
+  EXPECT_NE(cancelled, expiring);
+  EXPECT_TRUE(timer_wheel->Cancel(cancelled));
+  EXPECT_FALSE(timer_wheel->Cancel(cancelled));
+  EXPECT_EQ(timer_wheel->Size(), 1U);
+
+  ASSERT_TRUE(WaitFor([&] { return fired_count == 1; }));
+  EXPECT_FALSE(timer_wheel->Cancel(expiring));
+
+  // A stale id doesn't cancel a new timeout which reuses its storage.
+  const TimerWheel::TimerId reused(
+      timer_wheel->Schedule(std::chrono::milliseconds(10), [&] { ++fired_count; }));
+  EXPECT_FALSE(timer_wheel->Cancel(expiring));
+  EXPECT_FALSE(timer_wheel->Cancel(cancelled));
+  ASSERT_TRUE(WaitFor([&] { return fired_count == 2; }));
+  EXPECT_FALSE(timer_wheel->Cancel(reused));
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  EXPECT_EQ(fired_count, 2);
+}
+
+TEST(TimerWheelTest, BEH_CancelAllAndDestroy) {
+  AsioService asio_service(1);
+  std::atomic<int> fired_count(0);
+  {
+    auto timer_wheel(TimerWheel::MakeShared(asio_service, std::chrono::milliseconds(1)));
+    for (int i(0); i != 1000; ++i)
+      timer_wheel->Schedule(std::chrono::milliseconds(i % 50), [&] { ++fired_count; });
+    timer_wheel->CancelAll();
+    EXPECT_EQ(timer_wheel->Size(), 0U);
+    for (int i(0); i != 1000; ++i)
+      timer_wheel->Schedule(std::chrono::milliseconds(100), [&] { ++fired_count; });
+  }
+  std::this_thread::sleep_for(std::chrono::milliseconds(150));
+  EXPECT_EQ(fired_count, 0);
+}
+
+TEST(TimerWheelTest, BEH_BatchExpirations) {
+  AsioService asio_service(4);
+  auto timer_wheel(TimerWheel::MakeShared(asio_service, std::chrono::milliseconds(2), true));
+  const int kTimerCount(10000);
+  std::atomic<int> fired_count(0);
+  std::mutex mutex;
+  std::vector<std::thread::id> thread_ids;
+  for (int i(0); i != kTimerCount; ++i) {
+    timer_wheel->Schedule(std::chrono::milliseconds(i % 100), [&] {
+      ++fired_count;
+      std::lock_guard<std::mutex> lock(mutex);
+      if (thread_ids.empty() || thread_ids.back() != std::this_thread::get_id())
+        thread_ids.push_back(std::this_thread::get_id());
+    });
+  }
+  ASSERT_TRUE(WaitFor([&] { return fired_count == kTimerCount; }));
+  // Each tick's handlers run back-to-back on one thread, so there are far fewer switches than
+  // handlers.
+  std::lock_guard<std::mutex> lock(mutex);
+  EXPECT_LT(thread_ids.size(), static_cast<std::size_t>(kTimerCount / 10));
+}
+
+TEST(TimerWheelTest, FUNC_CascadesAcrossLevels) {
+  // With a one microsecond tick, these timeouts start out in each of the first four levels.
+  AsioService asio_service(1);
+  auto timer_wheel(TimerWheel::MakeShared(asio_service, std::chrono::microseconds(1)));
+  const std::vector<std::chrono::microseconds> timeouts{
+      std::chrono::microseconds(100), std::chrono::microseconds(10000),
+      std::chrono::microseconds(300000), std::chrono::microseconds(1500000)};
+  std::mutex mutex;
+  std::vector<TimePoint> fired(timeouts.size());
+  std::atomic<std::size_t> fired_count(0);
+  const TimePoint start(std::chrono::steady_clock::now());
+  for (std::size_t i(0); i != timeouts.size(); ++i) {
+    timer_wheel->Schedule(timeouts[i], [&, i] {
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        fired[i] = std::chrono::steady_clock::now();
+      }
+      ++fired_count;
+    });
+  }
+  ASSERT_TRUE(WaitFor([&] { return fired_count == timeouts.size(); }));
+  std::lock_guard<std::mutex> lock(mutex);
+  for (std::size_t i(0); i != timeouts.size(); ++i) {
+    EXPECT_GE(fired[i] - start, timeouts[i]);
+    EXPECT_LT(fired[i] - start, timeouts[i] + std::chrono::milliseconds(500));
+  }
+}
+
+TEST(TimerWheelTest, FUNC_ManyTimeouts) {
+  AsioService asio_service(2);
+  auto timer_wheel(TimerWheel::MakeShared(asio_service, std::chrono::milliseconds(1)));
+  const int kTimerCount(100000);
+  std::atomic<int> fired_count(0);
+  std::vector<TimerWheel::TimerId> ids;
+  for (int i(0); i != kTimerCount; ++i) {
+    ids.push_back(
+        timer_wheel->Schedule(std::chrono::milliseconds(i % 500), [&] { ++fired_count; }));
+  }
+  int cancelled_count(0);
+  for (int i(0); i < kTimerCount; i += 3)
+    cancelled_count += timer_wheel->Cancel(ids[i]) ? 1 : 0;
+  ASSERT_TRUE(WaitFor([&] { return fired_count + cancelled_count == kTimerCount; }));
+  EXPECT_EQ(timer_wheel->Size(), 0U);
+}
+
+}  // namespace test
+
+}  // namespace maidsafe
@@ -0,0 +1,165 @@
+/*  Copyright 2015 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#include "maidsafe/common/thread_pool.h"
+
+#include "maidsafe/common/error.h"
+#include "maidsafe/common/log.h"
+#include "maidsafe/common/make_unique.h"
+
+namespace maidsafe {
+
+ThreadPool::ThreadPool(std::size_t thread_count)
+    : thread_count_(thread_count),
+      workers_(),
+      threads_(),
+      current_worker_(&ThreadPool::NoCleanup),
+      next_worker_(0),
+      pending_(0),
+      idle_(0),
+      stopped_(false),
+      mutex_(),
+      stop_mutex_(),
+      condition_() {
+  if (thread_count == 0)
+    BOOST_THROW_EXCEPTION(MakeError(CommonErrors::invalid_argument));
+  for (std::size_t i(0); i != thread_count; ++i)
+    workers_.emplace_back(maidsafe::make_unique<Worker>(this, i));
+  for (std::size_t i(0); i != thread_count; ++i) {
+    Worker& worker(*workers_[i]);
+    threads_.emplace_back([this, &worker] {
+      try {
+        Run(worker);
+      } catch (...) {
+        LOG(kError) << boost::current_exception_diagnostic_information();
+        // Rethrowing here will cause the application to terminate - so flush the log message first.
+        log::Logging::Instance().Flush();
+        assert(0);
+        throw;
+      }
+    });
+  }
+}
+
+ThreadPool::~ThreadPool() { Stop(); }
+
+void ThreadPool::Stop() {
+  std::lock_guard<std::mutex> stop_lock(stop_mutex_);
+  if (threads_.empty())
+    return;
+  if (RunningInThisThread())
+    BOOST_THROW_EXCEPTION(MakeError(CommonErrors::cannot_invoke_from_this_thread));
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopped_ = true;
+  }
+  condition_.notify_all();
+
+  for (auto& pool_thread : threads_) {
+    try {
+      pool_thread.join();
+    } catch (const std::exception& e) {
+      LOG(kError) << "Exception joining thread pool thread: " << boost::diagnostic_information(e);
+      pool_thread.detach();
+    }
+  }
+  threads_.clear();
+}
+
+void ThreadPool::Push(detail::PoolTask task) {
+  // While stopping, tasks posted by tasks which are already running are still accepted, since the
+  // workers drain their queues before exiting.
+  Worker* worker(current_worker_.get());
+  if (!worker || worker->pool != this) {
+    if (stopped_)
+      return;
+    worker = workers_[next_worker_++ % thread_count_].get();
+  }
+  // Count the task before it is visible, so that 'pending_' never drops below the number queued.
+  ++pending_;
+  {
+    std::lock_guard<std::mutex> lock(worker->mutex);
+    worker->tasks.emplace_back(std::move(task));
+  }
+  // Wake a sleeping worker whenever there is one, since 'pending_' doesn't count tasks already
+  // running, so the awake workers may all be busy.  Both counters are sequentially consistent, so
+  // either the last worker to go idle sees this task before it sleeps, or it is counted as idle
+  // here and woken.
+  if (idle_ != 0) {
+    { std::lock_guard<std::mutex> lock(mutex_); }
+    condition_.notify_one();
+  }
+}
+
+bool ThreadPool::TryPop(Worker& worker, detail::PoolTask& task) {
+  std::lock_guard<std::mutex> lock(worker.mutex);
+  if (worker.tasks.empty())
+    return false;
+  task = std::move(worker.tasks.back());
+  worker.tasks.pop_back();
+  return true;
+}
+
+bool ThreadPool::TrySteal(Worker& thief, detail::PoolTask& task) {
+  // xorshift32 - cheap, and good enough to spread thieves across victims.
+  thief.random_state ^= thief.random_state << 13;
+  thief.random_state ^= thief.random_state >> 17;
+  thief.random_state ^= thief.random_state << 5;
+  const std::size_t first_victim(thief.random_state % thread_count_);
+  for (std::size_t i(0); i != thread_count_; ++i) {
+    Worker& victim(*workers_[(first_victim + i) % thread_count_]);
+    if (&victim == &thief)
+      continue;
+    std::lock_guard<std::mutex> lock(victim.mutex);
+    if (victim.tasks.empty())
+      continue;
+    task = std::move(victim.tasks.front());
+    victim.tasks.pop_front();
+    return true;
+  }
+  return false;
+}
+
+void ThreadPool::Run(Worker& worker) {
+  current_worker_.reset(&worker);
+  for (;;) {
+    detail::PoolTask task;
+    if (TryPop(worker, task) || TrySteal(worker, task)) {
+      --pending_;
+      task();
+      continue;
+    }
+
+    // A task has been counted but not yet pushed, or was taken by another thief mid-search.
+    if (pending_ != 0 && !stopped_) {
+      std::this_thread::yield();
+      continue;
+    }
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    ++idle_;
+    condition_.wait(lock, [&] { return pending_ != 0 || stopped_; });
+    --idle_;
+    if (stopped_ && pending_ == 0)
+      break;
+  }
+  current_worker_.reset();
+}
+
+}  // namespace maidsafe
@@ -0,0 +1,263 @@
+/*  Copyright 2015 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#include "maidsafe/common/timer_wheel.h"
+
+#include <algorithm>
+#include <utility>
+
+#include "maidsafe/common/error.h"
+
+namespace maidsafe {
+
+namespace {
+
+const std::uint32_t kRootSlots(1U << 8);
+const std::uint32_t kLevelSlots(1U << 6);
+
+std::uint32_t SlotIndex(unsigned level, std::uint32_t slot) {
+  return level == 0 ? slot : kRootSlots + (level - 1) * kLevelSlots + slot;
+}
+
+// The number of ticks covered by levels [0, level].
+std::uint64_t LevelSpan(unsigned level) { return std::uint64_t(1) << (8 + 6 * level); }
+
+}  // unnamed namespace
+
+const std::uint32_t TimerWheel::kNoNode;
+const unsigned TimerWheel::kRootBits;
+const unsigned TimerWheel::kLevelBits;
+const unsigned TimerWheel::kLevelCount;
+
+std::shared_ptr<TimerWheel> TimerWheel::MakeShared(AsioService& asio_service,
+                                                   std::chrono::steady_clock::duration tick,
+                                                   bool batch_expirations) {
+  if (tick <= std::chrono::steady_clock::duration::zero())
+    BOOST_THROW_EXCEPTION(MakeError(CommonErrors::invalid_argument));
+  return std::shared_ptr<TimerWheel>(
+      new TimerWheel(asio_service.NextService(), tick, batch_expirations));
+}
+
+TimerWheel::TimerWheel(asio::io_service& io_service, std::chrono::steady_clock::duration tick,
+                       bool batch_expirations)
+    : io_service_(io_service),
+      tick_(tick),
+      batch_expirations_(batch_expirations),
+      start_(std::chrono::steady_clock::now()),
+      mutex_(),
+      timer_(io_service),
+      ticking_(false),
+      next_tick_(0),
+      size_(0),
+      nodes_(),
+      free_list_(kNoNode),
+      slots_(kRootSlots + (kLevelCount - 1) * kLevelSlots, kNoNode) {
+  static_assert(kRootBits == 8 && kLevelBits == 6, "LevelSpan and the slot counts assume this.");
+}
+
+TimerWheel::TimerId TimerWheel::Schedule(std::chrono::steady_clock::duration timeout,
+                                         Handler handler) {
+  const auto elapsed(std::chrono::steady_clock::now() - start_ +
+                     std::max(timeout, std::chrono::steady_clock::duration::zero()));
+  // Round up, so that the handler is never invoked early.
+  const TickCount expiry((elapsed.count() + tick_.count() - 1) / tick_.count());
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (size_ == 0)  // Nothing is pending, so we can skip any idle ticks.
+    next_tick_ = std::max(next_tick_, NowTick());
+  const std::uint32_t index(AllocateNode());
+  Node& node(nodes_[index]);
+  node.handler = std::move(handler);
+  node.expiry = std::max(expiry, next_tick_);
+  Link(index);
+  ++size_;
+  if (!ticking_)
+    StartTicking();
+  return (static_cast<TimerId>(node.generation) << 32) | index;
+}
+
+bool TimerWheel::Cancel(TimerId timer_id) {
+  const std::uint32_t index(static_cast<std::uint32_t>(timer_id));
+  const std::uint32_t generation(static_cast<std::uint32_t>(timer_id >> 32));
+  Handler handler;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (index >= nodes_.size() || nodes_[index].generation != generation ||
+        nodes_[index].slot == kNoNode) {
+      return false;
+    }
+    Unlink(index);
+    // Destroy the handler outside the lock, since it may own objects which use this wheel.
+    handler = std::move(nodes_[index].handler);
+    FreeNode(index);
+    --size_;
+  }
+  return true;
+}
+
+void TimerWheel::CancelAll() {
+  std::vector<Handler> handlers;
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (std::uint32_t index(0); index != nodes_.size(); ++index) {
+    if (nodes_[index].slot != kNoNode) {
+      handlers.emplace_back(std::move(nodes_[index].handler));
+      FreeNode(index);
+    }
+  }
+  std::fill(std::begin(slots_), std::end(slots_), kNoNode);
+  size_ = 0;
+}
+
+std::size_t TimerWheel::Size() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return size_;
+}
+
+TimerWheel::TickCount TimerWheel::NowTick() const {
+  return static_cast<TickCount>((std::chrono::steady_clock::now() - start_) / tick_);
+}
+
+std::uint32_t TimerWheel::AllocateNode() {
+  if (free_list_ == kNoNode) {
+    if (nodes_.size() == kNoNode)
+      BOOST_THROW_EXCEPTION(MakeError(CommonErrors::unable_to_handle_request));
+    nodes_.emplace_back();
+    return static_cast<std::uint32_t>(nodes_.size() - 1);
+  }
+  const std::uint32_t index(free_list_);
+  free_list_ = nodes_[index].next;
+  return index;
+}
+
+void TimerWheel::FreeNode(std::uint32_t index) {
+  Node& node(nodes_[index]);
+  node.handler = nullptr;
+  if (++node.generation == 0)
+    node.generation = 1;
+  node.slot = kNoNode;
+  node.previous = kNoNode;
+  node.next = free_list_;
+  free_list_ = index;
+}
+
+void TimerWheel::Link(std::uint32_t index) {
+  Node& node(nodes_[index]);
+  const TickCount delta(node.expiry - next_tick_);
+  if (delta < LevelSpan(0)) {
+    node.slot = SlotIndex(0, node.expiry & (kRootSlots - 1));
+  } else {
+    // Timeouts beyond the last level's span are parked in its furthest slot and re-linked with
+    // their real expiry as the wheel turns.
+    const TickCount placement(next_tick_ + std::min(delta, LevelSpan(kLevelCount - 1) - 1));
+    unsigned level(1);
+    while (level != kLevelCount - 1 && placement - next_tick_ >= LevelSpan(level))
+      ++level;
+    node.slot = SlotIndex(
+        level,
+        static_cast<std::uint32_t>(placement >> (kRootBits + kLevelBits * (level - 1))) &
+            (kLevelSlots - 1));
+  }
+  std::uint32_t& head(slots_[node.slot]);
+  node.previous = kNoNode;
+  node.next = head;
+  if (head != kNoNode)
+    nodes_[head].previous = index;
+  head = index;
+}
+
+void TimerWheel::Unlink(std::uint32_t index) {
+  Node& node(nodes_[index]);
+  if (node.previous == kNoNode)
+    slots_[node.slot] = node.next;
+  else
+    nodes_[node.previous].next = node.next;
+  if (node.next != kNoNode)
+    nodes_[node.next].previous = node.previous;
+}
+
+bool TimerWheel::Cascade(unsigned level, unsigned slot) {
+  std::uint32_t index(slots_[SlotIndex(level, slot)]);
+  slots_[SlotIndex(level, slot)] = kNoNode;
+  while (index != kNoNode) {
+    const std::uint32_t next(nodes_[index].next);
+    Link(index);
+    index = next;
+  }
+  return slot == 0;
+}
+
+void TimerWheel::Advance(std::vector<Handler>& expired) {
+  const std::uint32_t root_slot(next_tick_ & (kRootSlots - 1));
+  if (root_slot == 0) {
+    for (unsigned level(1); level != kLevelCount; ++level) {
+      const unsigned slot(
+          static_cast<unsigned>(next_tick_ >> (kRootBits + kLevelBits * (level - 1))) &
+          (kLevelSlots - 1));
+      if (!Cascade(level, slot))
+        break;
+    }
+  }
+  std::uint32_t index(slots_[root_slot]);
+  slots_[root_slot] = kNoNode;
+  while (index != kNoNode) {
+    const std::uint32_t next(nodes_[index].next);
+    expired.emplace_back(std::move(nodes_[index].handler));
+    FreeNode(index);
+    --size_;
+    index = next;
+  }
+  ++next_tick_;
+}
+
+void TimerWheel::StartTicking() {
+  ticking_ = true;
+  timer_.expires_at(start_ + tick_ * next_tick_);
+  std::weak_ptr<TimerWheel> weak_this(shared_from_this());
+  timer_.async_wait([weak_this](const std::error_code& ec) {
+    if (std::shared_ptr<TimerWheel> timer_wheel = weak_this.lock())
+      timer_wheel->HandleTick(ec);
+  });
+}
+
+void TimerWheel::HandleTick(const std::error_code& ec) {
+  if (ec == asio::error::operation_aborted) {
+    // Let the next Schedule restart the timer.
+    std::lock_guard<std::mutex> lock(mutex_);
+    ticking_ = false;
+    return;
+  }
+  std::vector<Handler> expired;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    const TickCount now_tick(NowTick());
+    while (next_tick_ <= now_tick && size_ != 0)
+      Advance(expired);
+    ticking_ = false;
+    if (size_ != 0)
+      StartTicking();
+  }
+  if (batch_expirations_) {
+    for (auto& handler : expired)
+      handler();
+  } else {
+    for (auto& handler : expired)
+      io_service_.post(std::move(handler));
+  }
+}
+
+}  // namespace maidsafe
@@ -26,7 +26,13 @@
 #include "maidsafe/common/menu_item.h"
 #include "maidsafe/common/utils.h"
 
+#include "maidsafe/common/tools/ipc_benchmark.h"
+#include "maidsafe/common/tools/serialisation_benchmark.h"
+#include "maidsafe/common/tools/siphash_benchmark.h"
 #include "maidsafe/common/tools/sqlite3_wrapper_benchmark.h"
+#include "maidsafe/common/tools/tcp_benchmark.h"
+#include "maidsafe/common/tools/thread_pool_benchmark.h"
+#include "maidsafe/common/tools/timer_wheel_benchmark.h"
 
 int main(int argc, char* argv[]) {
   maidsafe::log::Logging::Instance().Initialise(argc, argv);
@@ -49,11 +55,41 @@ int main(int argc, char* argv[]) {
   });
 
   maidsafe::MenuItem* qa_dev_bench_item{qa_dev_item->AddChildItem("Benchmark Suite")};
+  qa_dev_bench_item->AddChildItem("ipc benchmark", [] {
+    TLOG(kGreen) << "Running ipc benchmark test\n";
+    maidsafe::benchmark::IpcBenchmark ipc_benchmark_test;
+    ipc_benchmark_test.Run();
+  });
+  qa_dev_bench_item->AddChildItem("serialisation benchmark", [] {
+    TLOG(kGreen) << "Running serialisation benchmark test\n";
+    maidsafe::benchmark::SerialisationBenchmark serialisation_benchmark_test;
+    serialisation_benchmark_test.Run();
+  });
+  qa_dev_bench_item->AddChildItem("siphash benchmark", [] {
+    TLOG(kGreen) << "Running siphash benchmark test\n";
+    maidsafe::benchmark::SipHashBenchmark siphash_benchmark_test;
+    siphash_benchmark_test.Run();
+  });
   qa_dev_bench_item->AddChildItem("sqlite_wrapper benchmark", [] {
     TLOG(kGreen) << "Running sqlite_wrapper benchmark test\n";
     maidsafe::benchmark::Sqlite3WrapperBenchmark sqlite_wrapper_benchmark_test;
     sqlite_wrapper_benchmark_test.Run();
   });
+  qa_dev_bench_item->AddChildItem("tcp benchmark", [] {
+    TLOG(kGreen) << "Running tcp benchmark test\n";
+    maidsafe::benchmark::TcpBenchmark tcp_benchmark_test;
+    tcp_benchmark_test.Run();
+  });
+  qa_dev_bench_item->AddChildItem("thread_pool benchmark", [] {
+    TLOG(kGreen) << "Running thread_pool benchmark test\n";
+    maidsafe::benchmark::ThreadPoolBenchmark thread_pool_benchmark_test;
+    thread_pool_benchmark_test.Run();
+  });
+  qa_dev_bench_item->AddChildItem("timer_wheel benchmark", [] {
+    TLOG(kGreen) << "Running timer_wheel benchmark test\n";
+    maidsafe::benchmark::TimerWheelBenchmark timer_wheel_benchmark_test;
+    timer_wheel_benchmark_test.Run();
+  });
   qa_dev_bench_item->AddChildItem("Benchmark 2", [] {
     TLOG(kGreen) << "Running benchmark 2.\n";
     std::this_thread::sleep_for(std::chrono::seconds(2));
@@ -0,0 +1,88 @@
+/*  Copyright 2015 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <string>
+#include <vector>
+
+#include "boost/program_options/options_description.hpp"
+#include "boost/program_options/parsers.hpp"
+#include "boost/program_options/variables_map.hpp"
+
+#include "maidsafe/common/log.h"
+
+#include "maidsafe/common/tools/serialisation_benchmark.h"
+
+namespace po = boost::program_options;
+
+namespace {
+
+std::atomic<std::uint64_t> g_allocation_count(0);
+
+}  // unnamed namespace
+
+// Counts every allocation so that the benchmark can report allocations per call.
+void* operator new(std::size_t size) {
+  ++g_allocation_count;
+  if (void* allocated = std::malloc(size == 0 ? 1 : size))
+    return allocated;
+  throw std::bad_alloc();
+}
+
+void operator delete(void* allocated) noexcept { std::free(allocated); }
+
+int main(int argc, char* argv[]) {
+  auto unuseds(maidsafe::log::Logging::Instance().Initialise(argc, argv));
+  std::vector<std::string> unused_options;
+  // skip the first arg which is the path to this tool
+  for (std::size_t i(1); i < unuseds.size(); ++i)
+    unused_options.emplace_back(&unuseds[i][0]);
+
+  po::options_description options("Serialisation benchmark options");
+  options.add_options()("help,h", "Show this help message.")(
+      "json",
+      "Run the fixed suite of types and write one line of JSON per type to stdout, rather than "
+      "running the full benchmark.");
+
+  po::variables_map variables_map;
+  try {
+    po::store(po::command_line_parser(unused_options).options(options).run(), variables_map);
+    po::notify(variables_map);
+  } catch (const std::exception& e) {
+    TLOG(kRed) << "Parser error:\n " << e.what() << "\nRun with -h to see all options.\n";
+    return -1;
+  }
+  if (variables_map.count("help")) {
+    std::cout << options << '\n';
+    return 0;
+  }
+
+  maidsafe::benchmark::SerialisationBenchmark::allocation_counter = &g_allocation_count;
+  maidsafe::benchmark::SerialisationBenchmark serialisation_benchmark_test;
+  if (variables_map.count("json")) {
+    serialisation_benchmark_test.RunSuite(std::cout);
+    return 0;
+  }
+  TLOG(kGreen) << "Running serialisation benchmark test\n";
+  serialisation_benchmark_test.Run();
+  return 0;
+}
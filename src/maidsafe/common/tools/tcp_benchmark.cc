@@ -0,0 +1,102 @@
+/*  Copyright 2015 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <string>
+#include <vector>
+
+#include "boost/program_options/options_description.hpp"
+#include "boost/program_options/parsers.hpp"
+#include "boost/program_options/variables_map.hpp"
+
+#include "maidsafe/common/log.h"
+
+#include "maidsafe/common/tools/tcp_benchmark.h"
+
+namespace po = boost::program_options;
+
+namespace {
+
+std::atomic<std::uint64_t> g_allocation_count(0);
+
+}  // unnamed namespace
+
+// Counts every allocation so that the benchmark can report allocations per message.
+void* operator new(std::size_t size) {
+  ++g_allocation_count;
+  if (void* allocated = std::malloc(size == 0 ? 1 : size))
+    return allocated;
+  throw std::bad_alloc();
+}
+
+void operator delete(void* allocated) noexcept { std::free(allocated); }
+
+int main(int argc, char* argv[]) {
+  auto unuseds(maidsafe::log::Logging::Instance().Initialise(argc, argv));
+  std::vector<std::string> unused_options;
+  // skip the first arg which is the path to this tool
+  for (std::size_t i(1); i < unuseds.size(); ++i)
+    unused_options.emplace_back(&unuseds[i][0]);
+
+  maidsafe::benchmark::TcpBenchmark::LoadConfig config;
+  po::options_description load_options(
+      "Load options (if any are given, a single load run is made and its results written to "
+      "stdout as JSON, rather than running the full benchmark suite)");
+  load_options.add_options()("help,h", "Show this help message.")(
+      "message_size", po::value<std::size_t>(&config.message_size),
+      "Bytes per message (at least 8).")(
+      "connections", po::value<std::size_t>(&config.connection_count),
+      "Number of client connections.")(
+      "in_flight", po::value<std::size_t>(&config.in_flight),
+      "Messages kept outstanding per connection.")(
+      "threads", po::value<std::size_t>(&config.thread_count), "AsioService thread count.")(
+      "round_trips", po::value<std::size_t>(&config.round_trips),
+      "Round trips made by each connection.");
+
+  po::variables_map variables_map;
+  try {
+    po::store(po::command_line_parser(unused_options).options(load_options).run(), variables_map);
+    po::notify(variables_map);
+  } catch (const std::exception& e) {
+    TLOG(kRed) << "Parser error:\n " << e.what() << "\nRun with -h to see all options.\n";
+    return -1;
+  }
+  if (variables_map.count("help")) {
+    std::cout << load_options << '\n';
+    return 0;
+  }
+
+  maidsafe::benchmark::TcpBenchmark::allocation_counter = &g_allocation_count;
+  maidsafe::benchmark::TcpBenchmark tcp_benchmark_test;
+  if (variables_map.empty()) {
+    TLOG(kGreen) << "Running tcp benchmark test\n";
+    tcp_benchmark_test.Run();
+    return 0;
+  }
+  try {
+    tcp_benchmark_test.RunLoad(config, std::cout);
+  } catch (const std::exception& e) {
+    TLOG(kRed) << "Failed: " << e.what() << '\n';
+    return -2;
+  }
+  return 0;
+}
@@ -0,0 +1,194 @@
+/*  Copyright 2015 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#include "maidsafe/common/tools/ipc_benchmark.h"
+
+#include <functional>
+#include <future>
+#include <memory>
+#include <vector>
+
+#include "maidsafe/common/asio_service.h"
+#include "maidsafe/common/log.h"
+#include "maidsafe/common/utils.h"
+#include "maidsafe/common/ipc/channel.h"
+#include "maidsafe/common/tcp/connection.h"
+#include "maidsafe/common/tcp/listener.h"
+
+namespace maidsafe {
+
+namespace benchmark {
+
+namespace {
+
+const std::size_t kChannelCapacity = 4 * 1024 * 1024;
+
+// Waits for a listener's first connection, then starts it with the given handler.
+tcp::ConnectionPtr Accept(std::future<tcp::ConnectionPtr> accepted,
+                          std::function<void(tcp::ConnectionPtr, tcp::Message)> on_message) {
+  tcp::ConnectionPtr connection{accepted.get()};
+  std::weak_ptr<tcp::Connection> weak_connection{connection};
+  connection->Start(
+      [weak_connection, on_message](tcp::Message message) {
+        if (tcp::ConnectionPtr connection = weak_connection.lock())
+          on_message(connection, std::move(message));
+      },
+      [] {});
+  return connection;
+}
+
+}  // unnamed namespace
+
+IpcBenchmark::IpcBenchmark() : message_count_(1000000), round_trips_(100000) {}
+
+void IpcBenchmark::Run() {
+  for (const std::size_t message_size : {64, 1024, 16384}) {
+    const std::size_t message_count(message_count_ / (1 + message_size / 1024));
+    TLOG(kGreen) << "\nStreaming " << message_count << " messages of " << message_size
+                 << " bytes\n";
+    Report("ipc::Channel", message_count, message_size, ChannelStream(message_size, message_count));
+    Report("tcp::Connection", message_count, message_size, TcpStream(message_size, message_count));
+  }
+  for (const std::size_t message_size : {64, 4096}) {
+    TLOG(kGreen) << "\nEchoing " << round_trips_ << " messages of " << message_size
+                 << " bytes, one at a time\n";
+    Report("ipc::Channel", round_trips_, message_size, ChannelEcho(message_size, round_trips_));
+    Report("tcp::Connection", round_trips_, message_size, TcpEcho(message_size, round_trips_));
+  }
+}
+
+std::chrono::steady_clock::duration IpcBenchmark::ChannelStream(std::size_t message_size,
+                                                                std::size_t message_count) {
+  const std::string name(RandomAlphaNumericString(16));
+  ipc::Channel sender(name, kChannelCapacity);
+  const auto start(std::chrono::steady_clock::now());
+  auto receiver(std::async(std::launch::async, [&] {
+    ipc::Channel channel(name);
+    std::vector<byte> message;
+    for (std::size_t i(0); i != message_count; ++i)
+      channel.Receive(message);
+  }));
+  const std::vector<byte> message(message_size, 'A');
+  for (std::size_t i(0); i != message_count; ++i)
+    sender.Send(message.data(), message.size());
+  receiver.get();
+  return std::chrono::steady_clock::now() - start;
+}
+
+std::chrono::steady_clock::duration IpcBenchmark::TcpStream(std::size_t message_size,
+                                                            std::size_t message_count) {
+  AsioService asio_service(2);
+  asio::io_service::strand client_strand(asio_service.service()),
+      server_strand(asio_service.service());
+  std::promise<tcp::ConnectionPtr> accepted;
+  tcp::ListenerPtr listener{tcp::Listener::MakeShared(
+      server_strand, [&](tcp::ConnectionPtr connection) { accepted.set_value(connection); },
+      tcp::Port{7777})};
+  tcp::ConnectionPtr client{tcp::Connection::MakeShared(client_strand, listener->ListeningPort())};
+  client->Start([](tcp::Message) {}, [] {});
+
+  std::size_t received_count(0);
+  std::promise<void> all_received;
+  const auto start(std::chrono::steady_clock::now());
+  tcp::ConnectionPtr server{Accept(accepted.get_future(), [&](tcp::ConnectionPtr, tcp::Message) {
+    if (++received_count == message_count)
+      all_received.set_value();
+  })};
+  for (std::size_t i(0); i != message_count; ++i)
+    client->Send(tcp::Message(message_size, 'A'));
+  all_received.get_future().get();
+  const auto duration(std::chrono::steady_clock::now() - start);
+  client->Close();
+  server->Close();
+  listener->StopListening();
+  asio_service.Stop();
+  return duration;
+}
+
+std::chrono::steady_clock::duration IpcBenchmark::ChannelEcho(std::size_t message_size,
+                                                              std::size_t round_trips) {
+  const std::string request_name(RandomAlphaNumericString(16)),
+      response_name(RandomAlphaNumericString(16));
+  ipc::Channel requests(request_name, kChannelCapacity), responses(response_name,
+                                                                   kChannelCapacity);
+  auto server(std::async(std::launch::async, [&] {
+    ipc::Channel server_requests(request_name), server_responses(response_name);
+    std::vector<byte> message;
+    while (server_requests.Receive(message))
+      server_responses.Send(message.data(), message.size());
+  }));
+  std::vector<byte> message(message_size, 'A');
+  const auto start(std::chrono::steady_clock::now());
+  for (std::size_t i(0); i != round_trips; ++i) {
+    requests.Send(message.data(), message.size());
+    responses.Receive(message);
+  }
+  const auto duration(std::chrono::steady_clock::now() - start);
+  requests.Close();
+  server.get();
+  return duration;
+}
+
+std::chrono::steady_clock::duration IpcBenchmark::TcpEcho(std::size_t message_size,
+                                                          std::size_t round_trips) {
+  AsioService asio_service(2);
+  asio::io_service::strand client_strand(asio_service.service()),
+      server_strand(asio_service.service());
+  std::promise<tcp::ConnectionPtr> accepted;
+  tcp::ListenerPtr listener{tcp::Listener::MakeShared(
+      server_strand, [&](tcp::ConnectionPtr connection) { accepted.set_value(connection); },
+      tcp::Port{7777})};
+  tcp::ConnectionPtr client{tcp::Connection::MakeShared(client_strand, listener->ListeningPort())};
+  std::size_t done_count(0);
+  std::promise<void> done;
+  client->Start(
+      [&](tcp::Message message) {
+        if (++done_count == round_trips)
+          return done.set_value();
+        client->Send(std::move(message));
+      },
+      [] {});
+  tcp::ConnectionPtr server{Accept(accepted.get_future(), [](tcp::ConnectionPtr connection,
+                                                              tcp::Message message) {
+    connection->Send(std::move(message));
+  })};
+
+  const auto start(std::chrono::steady_clock::now());
+  client->Send(tcp::Message(message_size, 'A'));
+  done.get_future().get();
+  const auto duration(std::chrono::steady_clock::now() - start);
+  client->Close();
+  server->Close();
+  listener->StopListening();
+  asio_service.Stop();
+  return duration;
+}
+
+void IpcBenchmark::Report(const std::string& name, std::size_t message_count,
+                          std::size_t message_size,
+                          std::chrono::steady_clock::duration duration) const {
+  const double seconds(std::chrono::duration<double>(duration).count());
+  TLOG(kGreen) << name << ": " << static_cast<std::uint64_t>(message_count / seconds)
+               << " messages/s, " << static_cast<std::uint64_t>(
+                                         message_count * message_size / seconds / 1000000)
+               << " MB/s, " << seconds * 1000000 / message_count << " us per message\n";
+}
+
+}  // namespace benchmark
+
+}  // namespace maidsafe
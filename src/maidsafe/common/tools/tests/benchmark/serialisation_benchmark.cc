@@ -0,0 +1,326 @@
+/*  Copyright 2015 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#include "maidsafe/common/tools/serialisation_benchmark.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "maidsafe/common/identity.h"
+#include "maidsafe/common/log.h"
+#include "maidsafe/common/rsa.h"
+#include "maidsafe/common/utils.h"
+#include "maidsafe/common/data_types/data.h"
+#include "maidsafe/common/data_types/immutable_data.h"
+#include "maidsafe/common/data_types/mutable_data.h"
+#include "maidsafe/common/data_types/structured_data_versions.h"
+#include "maidsafe/common/data_types/structured_data_versions_cereal.h"
+#include "maidsafe/common/serialisation/serialisation.h"
+
+namespace maidsafe {
+
+namespace benchmark {
+
+namespace {
+
+const std::size_t kBytesPerRun(256 * 1024 * 1024);
+const std::size_t kMaxIterations(100000);
+
+template <typename Functor>
+std::chrono::steady_clock::duration Time(std::size_t iterations, Functor functor) {
+  const auto start(std::chrono::steady_clock::now());
+  for (std::size_t i(0); i != iterations; ++i)
+    functor();
+  return std::chrono::steady_clock::now() - start;
+}
+
+std::uint64_t AllocationCount() {
+  const auto counter(SerialisationBenchmark::allocation_counter);
+  return counter ? counter->load() : 0;
+}
+
+// One operation's results from 'Measure' as a JSON object.
+std::string ToJson(std::size_t iterations, std::size_t serialised_size,
+                   std::chrono::steady_clock::duration duration, std::uint64_t allocations) {
+  const double seconds(std::chrono::duration<double>(duration).count());
+  std::ostringstream json;
+  json << std::fixed << std::setprecision(3) << "{\"iterations\":" << iterations
+       << ",\"ns_per_call\":" << seconds * 1e9 / iterations
+       << ",\"mb_per_second\":" << iterations * serialised_size / seconds / 1e6
+       << ",\"allocations_per_call\":";
+  if (SerialisationBenchmark::allocation_counter)
+    json << static_cast<double>(allocations) / iterations;
+  else
+    json << "null";
+  json << '}';
+  return json.str();
+}
+
+// Adds 99 versions in 10 branches.
+void AddVersions(StructuredDataVersions& versions) {
+  using VersionName = StructuredDataVersions::VersionName;
+  VersionName parent;
+  for (VersionName::Index index(0); index != 90; ++index) {
+    const VersionName version(index, MakeIdentity());
+    versions.Put(parent, version);
+    if (index % 10 == 9)  // start a new branch
+      versions.Put(parent, VersionName(index, MakeIdentity()));
+    parent = version;
+  }
+}
+
+}  // unnamed namespace
+
+std::atomic<std::uint64_t>* SerialisationBenchmark::allocation_counter(nullptr);
+
+SerialisationBenchmark::SerialisationBenchmark() : checksum_(0) {}
+
+void SerialisationBenchmark::Run() {
+  ImmutableDataRoundTrips();
+  StructuredDataVersionsRoundTrips();
+  ContiguousPayloads();
+  CompactArchives();
+  LOG(kVerbose) << "Checksum " << checksum_;
+}
+
+void SerialisationBenchmark::RunSuite(std::ostream& output) {
+  Measure("Identity", MakeIdentity(), kMaxIterations, output);
+  Measure("Data::NameAndTypeId", Data::NameAndTypeId(MakeIdentity(), DataTypeId(RandomUint32())),
+          kMaxIterations, output);
+  Measure("ImmutableData (1 KiB)", ImmutableData(NonEmptyString(RandomBytes(1024))),
+          kMaxIterations / 10, output);
+  Measure("ImmutableData (1 MiB)", ImmutableData(NonEmptyString(RandomBytes(1024 * 1024))), 100,
+          output);
+  Measure("MutableData (1 KiB)", MutableData(MakeIdentity(), NonEmptyString(RandomBytes(1024))),
+          kMaxIterations / 10, output);
+
+  StructuredDataVersions versions(100, 10);
+  AddVersions(versions);
+  Measure("StructuredDataVersions",
+          Parse<detail::StructuredDataVersionsCereal>(versions.Serialise()->string()),
+          kMaxIterations / 10, output);
+
+  Measure("asymm::Keys", asymm::GenerateKeyPair(), kMaxIterations / 100, output);
+
+  std::map<std::string, std::vector<std::uint32_t>> map_of_vectors;
+  for (int i(0); i != 100; ++i)
+    map_of_vectors.emplace(RandomAlphaNumericString(16), std::vector<std::uint32_t>(10, i));
+  Measure("std::map<std::string, std::vector<uint32_t>>", map_of_vectors, kMaxIterations / 10,
+          output);
+
+  const std::vector<std::vector<std::string>> nested_strings(
+      10, std::vector<std::string>(10, RandomAlphaNumericString(20)));
+  Measure("std::vector<std::vector<std::string>>", nested_strings, kMaxIterations / 10, output);
+  LOG(kVerbose) << "Checksum " << checksum_;
+}
+
+void SerialisationBenchmark::ImmutableDataRoundTrips() {
+  for (const std::size_t value_size : {1024, 64 * 1024, 1024 * 1024}) {
+    const ImmutableData data(NonEmptyString(RandomBytes(value_size)));
+    const std::size_t iterations(std::min(kMaxIterations, kBytesPerRun / value_size));
+    TLOG(kGreen) << "\nImmutableData with " << value_size << " byte value, " << iterations
+                 << " iterations\n";
+    RoundTrips(data, iterations);
+  }
+}
+
+void SerialisationBenchmark::StructuredDataVersionsRoundTrips() {
+  StructuredDataVersions versions(100, 10);
+  AddVersions(versions);
+  const std::size_t iterations(kMaxIterations / 10);
+  TLOG(kGreen) << "\nStructuredDataVersions with 99 versions in " << versions.Get().size()
+               << " branches, " << iterations << " iterations\n";
+  RoundTrips(Parse<detail::StructuredDataVersionsCereal>(versions.Serialise()->string()),
+             iterations);
+
+  const auto duration(Time(iterations, [&] {
+    StructuredDataVersions parsed(versions.Serialise());
+    checksum_ += parsed.max_versions();
+  }));
+  Report("StructuredDataVersions API", iterations, versions.Serialise()->string().size(),
+         duration);
+}
+
+void SerialisationBenchmark::ContiguousPayloads() {
+  for (const std::size_t payload_size : {1024, 16 * 1024, 256 * 1024, 1024 * 1024}) {
+    const std::size_t iterations(std::min(kMaxIterations, kBytesPerRun / payload_size));
+    const std::vector<byte> bytes(RandomBytes(payload_size));
+    TLOG(kGreen) << "\nstd::vector<byte> of " << payload_size << " bytes, " << iterations
+                 << " iterations\n";
+    RoundTrips(bytes, iterations);
+
+    const std::vector<std::uint64_t> numbers(payload_size / sizeof(std::uint64_t), RandomUint32());
+    TLOG(kGreen) << "\nstd::vector<uint64_t> of " << payload_size << " bytes, " << iterations
+                 << " iterations\n";
+    RoundTrips(numbers, iterations);
+  }
+}
+
+void SerialisationBenchmark::CompactArchives() {
+  const Data::NameAndTypeId name_and_type_id(MakeIdentity(), DataTypeId(RandomUint32() % 100));
+  CompareArchives("Data::NameAndTypeId", name_and_type_id, kMaxIterations);
+
+  std::map<std::uint32_t, std::uint64_t> counts;
+  for (std::uint32_t i(0); i != 100; ++i)
+    counts.emplace(i * 7, RandomUint32() % 1000);
+  CompareArchives("std::map<uint32_t, uint64_t> of 100 small counts", counts, kMaxIterations / 10);
+
+  StructuredDataVersions versions(100, 10);
+  AddVersions(versions);
+  CompareArchives("StructuredDataVersions",
+                  Parse<detail::StructuredDataVersionsCereal>(versions.Serialise()->string()),
+                  kMaxIterations / 10);
+}
+
+template <typename T>
+void SerialisationBenchmark::RoundTrips(const T& object, std::size_t iterations) {
+  const std::size_t serialised_size(SerialisedSize(object));
+
+  Report("new OutputVectorStream", iterations, serialised_size, Time(iterations, [&] {
+    OutputVectorStream binary_output_stream;
+    checksum_ += ConvertToVectorStream(binary_output_stream, object).vector().size();
+  }));
+
+  Report("Serialise", iterations, serialised_size,
+         Time(iterations, [&] { checksum_ += Serialise(object).size(); }));
+
+  SerialisedData buffer;
+  Report("SerialiseInto reused buffer", iterations, serialised_size, Time(iterations, [&] {
+    SerialiseInto(buffer, object);
+    checksum_ += buffer.size();
+  }));
+
+  Report("Parse via InputVectorStream", iterations, serialised_size, Time(iterations, [&] {
+    InputVectorStream binary_input_stream{buffer};
+    T parsed(Parse<T>(binary_input_stream));
+    checksum_ += sizeof(parsed);
+  }));
+
+  Report("Parse in place", iterations, serialised_size, Time(iterations, [&] {
+    T parsed(Parse<T>(buffer.data(), buffer.size()));
+    checksum_ += sizeof(parsed);
+  }));
+
+  Report("ConvertToString via stream", iterations, serialised_size, Time(iterations, [&] {
+    std::stringstream str_stream;
+    checksum_ += ConvertToString(str_stream, object).size();
+  }));
+
+  Report("ConvertToString", iterations, serialised_size,
+         Time(iterations, [&] { checksum_ += ConvertToString(object).size(); }));
+
+  const std::string serialised(ConvertToString(object));
+  Report("ConvertFromStream", iterations, serialised_size, Time(iterations, [&] {
+    std::stringstream str_stream{serialised};
+    T parsed(ConvertFromStream<T>(str_stream));
+    checksum_ += sizeof(parsed);
+  }));
+
+  Report("ConvertFromString", iterations, serialised_size, Time(iterations, [&] {
+    T parsed(ConvertFromString<T>(serialised));
+    checksum_ += sizeof(parsed);
+  }));
+}
+
+template <typename T>
+void SerialisationBenchmark::CompareArchives(const std::string& type_name, const T& object,
+                                             std::size_t iterations) {
+  SerialisedData binary_buffer, compact_buffer;
+  SerialiseInto(binary_buffer, object);
+  const std::size_t binary_size(binary_buffer.size()),
+      compact_size(SerialiseCompact(object).size());
+  TLOG(kGreen) << "\n" << type_name << ", " << iterations << " iterations: " << binary_size
+               << " bytes binary, " << compact_size << " bytes compact ("
+               << 100 - compact_size * 100 / binary_size << "% smaller)\n";
+
+  Report("Binary serialise", iterations, binary_size, Time(iterations, [&] {
+    SerialiseInto(binary_buffer, object);
+    checksum_ += binary_buffer.size();
+  }));
+
+  Report("Binary parse", iterations, binary_size, Time(iterations, [&] {
+    T parsed(Parse<T>(binary_buffer.data(), binary_buffer.size()));
+    checksum_ += sizeof(parsed);
+  }));
+
+  Report("Compact serialise", iterations, compact_size, Time(iterations, [&] {
+    compact_buffer.clear();
+    CompactOutputArchive compact_output_archive(compact_buffer);
+    compact_output_archive(object);
+    checksum_ += compact_buffer.size();
+  }));
+
+  Report("Compact parse", iterations, compact_size, Time(iterations, [&] {
+    T parsed(ParseCompact<T>(compact_buffer.data(), compact_buffer.size()));
+    checksum_ += sizeof(parsed);
+  }));
+}
+
+template <typename T>
+void SerialisationBenchmark::Measure(const std::string& type_name, const T& object,
+                                     std::size_t iterations, std::ostream& output) {
+  SerialisedData buffer;
+  SerialiseInto(buffer, object);
+  const std::size_t serialised_size(buffer.size());
+
+  std::uint64_t allocations(AllocationCount());
+  const auto serialise_duration(
+      Time(iterations, [&] { checksum_ += Serialise(object).size(); }));
+  const std::uint64_t serialise_allocations(AllocationCount() - allocations);
+
+  allocations = AllocationCount();
+  const auto serialise_into_duration(Time(iterations, [&] {
+    SerialiseInto(buffer, object);
+    checksum_ += buffer.size();
+  }));
+  const std::uint64_t serialise_into_allocations(AllocationCount() - allocations);
+
+  allocations = AllocationCount();
+  const auto parse_duration(Time(iterations, [&] {
+    T parsed(Parse<T>(buffer.data(), buffer.size()));
+    checksum_ += sizeof(parsed);
+  }));
+  const std::uint64_t parse_allocations(AllocationCount() - allocations);
+
+  output << "{\"type\":\"" << type_name << "\",\"serialised_bytes\":" << serialised_size
+         << ",\"serialise\":"
+         << ToJson(iterations, serialised_size, serialise_duration, serialise_allocations)
+         << ",\"serialise_into\":"
+         << ToJson(iterations, serialised_size, serialise_into_duration, serialise_into_allocations)
+         << ",\"parse\":" << ToJson(iterations, serialised_size, parse_duration, parse_allocations)
+         << "}" << std::endl;
+}
+
+void SerialisationBenchmark::Report(const std::string& name, std::size_t iterations,
+                                    std::size_t serialised_size,
+                                    std::chrono::steady_clock::duration duration) const {
+  const double seconds(std::chrono::duration<double>(duration).count());
+  TLOG(kGreen) << std::setw(28) << std::left << name << ": " << std::setw(10) << std::right
+               << std::fixed << std::setprecision(3) << seconds * 1000000 / iterations
+               << " us per call, " << std::setw(6)
+               << static_cast<std::uint64_t>(iterations * serialised_size / seconds / 1000000)
+               << " MB/s\n";
+}
+
+}  // namespace benchmark
+
+}  // namespace maidsafe
@@ -0,0 +1,104 @@
+/*  Copyright 2015 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#include "maidsafe/common/tools/siphash_benchmark.h"
+
+#include <algorithm>
+#include <array>
+#include <iomanip>
+
+#include "maidsafe/common/log.h"
+#include "maidsafe/common/types.h"
+#include "maidsafe/common/utils.h"
+#include "maidsafe/common/hash/algorithms/siphash.h"
+
+namespace maidsafe {
+
+namespace benchmark {
+
+namespace {
+
+const std::size_t kBytesPerRun(64 * 1024 * 1024);
+
+template <typename Functor>
+std::chrono::steady_clock::duration Time(std::size_t iterations, Functor functor) {
+  const auto start(std::chrono::steady_clock::now());
+  for (std::size_t i(0); i != iterations; ++i)
+    functor();
+  return std::chrono::steady_clock::now() - start;
+}
+
+}  // unnamed namespace
+
+SipHashBenchmark::SipHashBenchmark() : checksum_(0) {}
+
+void SipHashBenchmark::Run() {
+  std::array<byte, 16> seed;
+  const std::string seed_string(RandomString(seed.size()));
+  std::copy(seed_string.begin(), seed_string.end(), seed.begin());
+
+  for (const std::size_t input_size : {8, 64, 512, 4 * 1024, 64 * 1024}) {
+    // One extra byte so that each lane of SipHash::Hash reads from a different alignment.
+    const std::string input_string(RandomString(SipHash::kLanes * input_size + 1));
+    const byte* const input(reinterpret_cast<const byte*>(input_string.data()));
+    const std::size_t hash_count(kBytesPerRun / input_size);
+    TLOG(kGreen) << "\nHashing " << hash_count << " inputs of " << input_size << " bytes\n";
+
+    Report("SipHash::Update", input_size, hash_count, Time(hash_count, [&] {
+      SipHash hash(seed);
+      hash.Update(input, input_size);
+      checksum_ += hash.Finalize();
+    }));
+
+    Report("SipHash::Update (8 B each)", input_size, hash_count, Time(hash_count, [&] {
+      SipHash hash(seed);
+      for (std::size_t offset(0); offset != input_size; offset += 8)
+        hash.Update(input + offset, 8);
+      checksum_ += hash.Finalize();
+    }));
+
+    std::array<const byte*, SipHash::kLanes> lanes;
+    std::array<std::uint64_t, SipHash::kLanes> lane_sizes;
+    for (std::size_t lane(0); lane != SipHash::kLanes; ++lane) {
+      lanes[lane] = input + lane * input_size + (lane % 2);
+      lane_sizes[lane] = input_size;
+    }
+    std::array<std::uint64_t, SipHash::kLanes> out;
+    Report("SipHash::Hash (4 inputs)", input_size, hash_count,
+           Time(hash_count / SipHash::kLanes, [&] {
+             SipHash::Hash(seed, lanes, lane_sizes, out);
+             checksum_ += out[0] ^ out[SipHash::kLanes - 1];
+           }));
+  }
+  LOG(kVerbose) << "Checksum " << checksum_;
+}
+
+void SipHashBenchmark::Report(const std::string& name, std::size_t input_size,
+                              std::size_t hash_count,
+                              std::chrono::steady_clock::duration duration) const {
+  const double seconds(std::chrono::duration<double>(duration).count());
+  TLOG(kGreen) << std::setw(28) << std::left << name << ": " << std::setw(10) << std::right
+               << std::fixed << std::setprecision(1) << seconds * 1000000000 / hash_count
+               << " ns per input, " << std::setw(6)
+               << static_cast<std::uint64_t>(hash_count * input_size / seconds / 1000000)
+               << " MB/s\n";
+}
+
+}  // namespace benchmark
+
+}  // namespace maidsafe
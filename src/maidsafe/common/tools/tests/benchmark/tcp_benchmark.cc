@@ -0,0 +1,701 @@
+/*  Copyright 2015 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#include "maidsafe/common/tools/tcp_benchmark.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <functional>
+#include <future>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "asio/coroutine.hpp"
+#include "asio/ip/tcp.hpp"
+#include "asio/strand.hpp"
+#include "boost/filesystem/operations.hpp"
+#include "boost/filesystem/path.hpp"
+
+#include "maidsafe/common/error.h"
+#include "maidsafe/common/log.h"
+#include "maidsafe/common/make_unique.h"
+#include "maidsafe/common/tcp/connection.h"
+#include "maidsafe/common/tcp/listener.h"
+#include "maidsafe/common/tcp/rpc_channel.h"
+#include "maidsafe/common/timer_wheel.h"
+
+namespace maidsafe {
+
+namespace benchmark {
+
+namespace {
+
+boost::filesystem::path UniqueSocketPath() {
+  return boost::filesystem::temp_directory_path() /
+         boost::filesystem::unique_path("maidsafe_tcp_benchmark_%%%%-%%%%-%%%%.sock");
+}
+
+typedef std::chrono::steady_clock::rep Timestamp;
+
+// Keeps up to 'in_flight' timestamped messages outstanding to an echo server.  Since the server
+// echoes each message back unchanged, the round trip time of each is read from its own payload.
+// Handlers run on the connection's strand, so no locking is needed.
+class LoadClient {
+ public:
+  LoadClient(tcp::ConnectionPtr connection, std::size_t message_size, std::size_t in_flight,
+             std::size_t round_trips, std::function<void()> on_done)
+      : connection_(std::move(connection)),
+        message_size_(message_size),
+        in_flight_(std::min(in_flight, round_trips)),
+        round_trips_(round_trips),
+        on_done_(std::move(on_done)),
+        sent_count_(0),
+        latencies_() {
+    latencies_.reserve(round_trips_);
+  }
+
+  // The first messages are queued before reading starts, so that 'HandleEcho' can't yet run.
+  void Start() {
+    for (; sent_count_ != in_flight_; ++sent_count_)
+      SendStamped(tcp::Message(message_size_, 'A'));
+    connection_->Start([this](tcp::Message message) { HandleEcho(std::move(message)); }, [] {});
+  }
+
+  void Close() { connection_->Close(); }
+  const std::vector<Timestamp>& Latencies() const { return latencies_; }
+
+ private:
+  void SendStamped(tcp::Message message) {
+    const Timestamp now(std::chrono::steady_clock::now().time_since_epoch().count());
+    std::memcpy(message.data(), &now, sizeof(now));
+    connection_->Send(std::move(message));
+  }
+
+  void HandleEcho(tcp::Message message) {
+    Timestamp sent;
+    std::memcpy(&sent, message.data(), sizeof(sent));
+    latencies_.push_back(std::chrono::steady_clock::now().time_since_epoch().count() - sent);
+    if (sent_count_ != round_trips_) {
+      ++sent_count_;
+      SendStamped(std::move(message));
+    }
+    if (latencies_.size() == round_trips_)
+      on_done_();
+  }
+
+  tcp::ConnectionPtr connection_;
+  const std::size_t message_size_, in_flight_, round_trips_;
+  std::function<void()> on_done_;
+  std::size_t sent_count_;
+  std::vector<Timestamp> latencies_;
+};
+
+double Percentile(std::vector<Timestamp>& values, double fraction) {
+  if (values.empty())
+    return 0.0;
+  auto nth(std::begin(values) +
+           std::min(values.size() - 1, static_cast<std::size_t>(fraction * values.size())));
+  std::nth_element(std::begin(values), nth, std::end(values));
+  return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::duration(*nth))
+      .count();
+}
+
+#include "asio/yield.hpp"
+
+class EchoClient : public asio::coroutine {
+ public:
+  EchoClient(tcp::ConnectionPtr connection, std::size_t message_size, std::size_t round_trips,
+             std::function<void()> on_done)
+      : connection_(std::move(connection)),
+        message_size_(message_size),
+        round_trips_(round_trips),
+        on_done_(std::move(on_done)),
+        done_count_(0) {}
+
+  void operator()(std::error_code ec = std::error_code(), tcp::Message message = tcp::Message()) {
+    if (ec)
+      return;
+    reenter(this) {
+      message.assign(message_size_, 'A');
+      for (done_count_ = 0; done_count_ != round_trips_; ++done_count_) {
+        yield connection_->Send(std::move(message), *this);
+        yield connection_->Receive(*this);
+      }
+      on_done_();
+    }
+  }
+
+ private:
+  tcp::ConnectionPtr connection_;
+  std::size_t message_size_, round_trips_;
+  std::function<void()> on_done_;
+  std::size_t done_count_;
+};
+
+#include "asio/unyield.hpp"
+
+}  // unnamed namespace
+
+std::atomic<std::uint64_t>* TcpBenchmark::allocation_counter(nullptr);
+
+TcpBenchmark::LoadConfig::LoadConfig()
+    : message_size(64),
+      connection_count(1),
+      in_flight(1),
+      thread_count(std::max(2U, std::thread::hardware_concurrency())),
+      round_trips(100000) {}
+
+TcpBenchmark::TcpBenchmark()
+    : thread_count_(std::max(2U, std::thread::hardware_concurrency())) {}
+
+void TcpBenchmark::Run() {
+  CompareServiceModes();
+  CompareCallbacksAndCoroutines();
+  CompareWriteCoalescing();
+  MeasureLargeMessageThroughput();
+  MeasureReadBatching();
+  CompareAcceptors();
+  CompareTransports();
+  MeasureRpcPipelining();
+}
+
+void TcpBenchmark::RunLoad(const LoadConfig& config, std::ostream& output) const {
+  if (config.message_size < sizeof(Timestamp) ||
+      config.message_size > tcp::Connection::MaxMessageSize() || config.connection_count == 0 ||
+      config.in_flight == 0 || config.round_trips == 0 || config.thread_count == 0) {
+    LOG(kError) << "Invalid load config.";
+    BOOST_THROW_EXCEPTION(MakeError(CommonErrors::invalid_argument));
+  }
+  AsioService asio_service(config.thread_count);
+  std::vector<std::unique_ptr<asio::io_service::strand>> strands;
+  for (std::size_t i(0); i != config.thread_count; ++i)
+    strands.emplace_back(maidsafe::make_unique<asio::io_service::strand>(asio_service.service()));
+  std::atomic<std::size_t> next_strand(0);
+  auto pick_strand([&]() -> asio::io_service::strand& {
+    return *strands[next_strand++ % strands.size()];
+  });
+
+  std::mutex mutex;
+  std::vector<tcp::ConnectionPtr> server_connections;
+  tcp::ListenerPtr listener{tcp::Listener::MakeShared(
+      *strands.front(),
+      [&](tcp::ConnectionPtr connection) {
+        std::weak_ptr<tcp::Connection> weak_connection(connection);
+        connection->Start([weak_connection](tcp::Message message) {
+                            if (tcp::ConnectionPtr echoer = weak_connection.lock())
+                              echoer->Send(std::move(message));
+                          },
+                          [] {});
+        std::lock_guard<std::mutex> lock(mutex);
+        server_connections.push_back(connection);
+      },
+      tcp::Port{7777}, pick_strand)};
+
+  std::atomic<std::size_t> remaining_clients(config.connection_count);
+  std::promise<void> all_done;
+  std::vector<std::unique_ptr<LoadClient>> clients;
+  for (std::size_t i(0); i != config.connection_count; ++i) {
+    clients.emplace_back(maidsafe::make_unique<LoadClient>(
+        tcp::Connection::MakeShared(pick_strand(), listener->ListeningPort()),
+        config.message_size, config.in_flight, config.round_trips, [&] {
+          if (--remaining_clients == 0)
+            all_done.set_value();
+        }));
+  }
+
+  const auto start(std::chrono::steady_clock::now());
+  for (auto& client : clients)
+    client->Start();
+  all_done.get_future().wait();
+  const double seconds(
+      std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+
+  for (auto& client : clients)
+    client->Close();
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (auto& server_connection : server_connections)
+      server_connection->Close();
+  }
+  listener->StopListening();
+  asio_service.Stop();
+
+  std::vector<Timestamp> latencies;
+  latencies.reserve(config.connection_count * config.round_trips);
+  for (const auto& client : clients) {
+    latencies.insert(std::end(latencies), std::begin(client->Latencies()),
+                     std::end(client->Latencies()));
+  }
+  const double round_trips(static_cast<double>(latencies.size()));
+  output << std::fixed << std::setprecision(3) << "{\"message_size\":" << config.message_size
+         << ",\"connections\":" << config.connection_count
+         << ",\"in_flight\":" << config.in_flight << ",\"threads\":" << config.thread_count
+         << ",\"round_trips\":" << latencies.size() << ",\"seconds\":" << seconds
+         << ",\"messages_per_second\":" << round_trips / seconds
+         << ",\"mb_per_second\":" << round_trips * 2 * config.message_size / seconds / 1e6
+         << ",\"latency_us\":{\"p50\":" << Percentile(latencies, 0.5)
+         << ",\"p99\":" << Percentile(latencies, 0.99)
+         << ",\"p999\":" << Percentile(latencies, 0.999) << "}}\n";
+}
+
+void TcpBenchmark::CompareServiceModes() {
+  const std::size_t kMessageSize(64), kTotalRoundTrips(200000);
+  for (std::size_t connection_count : {1U, 8U, 64U}) {
+    TLOG(kGreen) << "\nEcho of " << kMessageSize << " byte messages over " << connection_count
+                 << " connection(s) with " << thread_count_ << " threads\n";
+    const std::size_t round_trips(kTotalRoundTrips / connection_count);
+    {
+      AsioService asio_service(thread_count_, IoServiceMode::kShared);
+      Report("Shared io_service", connection_count * round_trips,
+             Echo(asio_service, connection_count, kMessageSize, round_trips));
+    }
+    {
+      AsioService asio_service(thread_count_, IoServiceMode::kServicePerThread);
+      Report("io_service per thread", connection_count * round_trips,
+             Echo(asio_service, connection_count, kMessageSize, round_trips));
+    }
+    {
+      AsioService asio_service(thread_count_, IoServiceMode::kServicePerThread, true);
+      Report("io_service per pinned thread", connection_count * round_trips,
+             Echo(asio_service, connection_count, kMessageSize, round_trips));
+    }
+  }
+}
+
+void TcpBenchmark::CompareCallbacksAndCoroutines() {
+  const std::size_t kMessageSize(64), kTotalRoundTrips(200000);
+  for (std::size_t connection_count : {1U, 64U}) {
+    TLOG(kGreen) << "\nEcho of " << kMessageSize << " byte messages over " << connection_count
+                 << " connection(s) with " << thread_count_ << " threads\n";
+    const std::size_t round_trips(kTotalRoundTrips / connection_count);
+    {
+      AsioService asio_service(thread_count_);
+      Report("Callback clients", connection_count * round_trips,
+             Echo(asio_service, connection_count, kMessageSize, round_trips, false));
+    }
+    {
+      AsioService asio_service(thread_count_);
+      Report("Coroutine clients", connection_count * round_trips,
+             Echo(asio_service, connection_count, kMessageSize, round_trips, true));
+    }
+  }
+}
+
+void TcpBenchmark::CompareWriteCoalescing() {
+  const std::size_t kMessageCount(500000);
+  for (std::size_t message_size : {16U, 64U, 256U, 1024U}) {
+    TLOG(kGreen) << "\nStream of " << kMessageCount << " messages of " << message_size
+                 << " bytes with " << thread_count_ << " threads\n";
+    {
+      AsioService asio_service(thread_count_);
+      Report("One message per write", kMessageCount,
+             Stream(asio_service, message_size, kMessageCount, 1), "messages");
+    }
+    {
+      AsioService asio_service(thread_count_);
+      Report("Coalesced writes", kMessageCount,
+             Stream(asio_service, message_size, kMessageCount,
+                    tcp::Connection::kDefaultMaxCoalescedMessages),
+             "messages");
+    }
+  }
+}
+
+void TcpBenchmark::MeasureLargeMessageThroughput() {
+  const std::size_t kMessageSize(tcp::Connection::MaxMessageSize()), kMessageCount(2000);
+  TLOG(kGreen) << "\nStream of " << kMessageCount << " messages of " << kMessageSize
+               << " bytes with " << thread_count_ << " threads\n";
+  AsioService asio_service(thread_count_);
+  const auto duration(Stream(asio_service, kMessageSize, kMessageCount,
+                             tcp::Connection::kDefaultMaxCoalescedMessages));
+  const double seconds(std::chrono::duration<double>(duration).count());
+  TLOG(kGreen) << "Large messages: "
+               << static_cast<std::uint64_t>(kMessageCount * kMessageSize / seconds / (1024 * 1024))
+               << " MiB/s\n";
+
+  // Echoing reuses each received buffer for the reply, and each sent buffer for a later receive,
+  // so once the first few messages have filled the connections' pools nothing should allocate.
+  const std::size_t kRoundTrips(kMessageCount / 2);
+  TLOG(kGreen) << "\nEcho of " << kRoundTrips << " round trips of " << kMessageSize
+               << " bytes with " << thread_count_ << " threads\n";
+  AsioService echo_service(thread_count_);
+  std::uint64_t allocations(0);
+  const auto echo_duration(Echo(echo_service, 1, kMessageSize, kRoundTrips, false,
+                                Transport::kTcp, &allocations));
+  const double echo_seconds(std::chrono::duration<double>(echo_duration).count());
+  TLOG(kGreen) << "Large message echo: "
+               << static_cast<std::uint64_t>(2 * kRoundTrips * kMessageSize / echo_seconds /
+                                             (1024 * 1024))
+               << " MiB/s\n";
+  if (allocation_counter) {
+    TLOG(kGreen) << "Allocations: " << allocations << " ("
+                 << static_cast<double>(allocations) / (2 * kRoundTrips) << " per message)\n";
+  }
+}
+
+void TcpBenchmark::MeasureReadBatching() {
+  const std::size_t kMessageCount(500000);
+  for (std::size_t message_size : {16U, 256U, 4096U}) {
+    TLOG(kGreen) << "\nStream of " << kMessageCount << " messages of " << message_size
+                 << " bytes with " << thread_count_ << " threads\n";
+    AsioService asio_service(thread_count_);
+    std::uint64_t read_operations(0);
+    Stream(asio_service, message_size, kMessageCount,
+           tcp::Connection::kDefaultMaxCoalescedMessages, &read_operations);
+    TLOG(kGreen) << "Reads per message: "
+                 << static_cast<double>(read_operations) / kMessageCount << '\n';
+  }
+
+  // With many connections busy, each client's round trip time is its share of the total.
+  const std::size_t kMessageSize(64), kConnectionCount(64), kRoundTrips(5000);
+  TLOG(kGreen) << "\nEcho of " << kMessageSize << " byte messages over " << kConnectionCount
+               << " connections with " << thread_count_ << " threads\n";
+  AsioService asio_service(thread_count_);
+  const auto duration(Echo(asio_service, kConnectionCount, kMessageSize, kRoundTrips));
+  Report("Loaded echo", kConnectionCount * kRoundTrips, duration);
+  TLOG(kGreen) << "Mean round trip latency: "
+               << std::chrono::duration_cast<std::chrono::microseconds>(duration).count() /
+                      kRoundTrips << " us\n";
+}
+
+void TcpBenchmark::CompareAcceptors() {
+  const std::size_t kClientThreadCount(4), kConnectionsPerThread(2500);
+  TLOG(kGreen) << "\nConnection storm of " << kClientThreadCount * kConnectionsPerThread
+               << " connections from " << kClientThreadCount << " threads\n";
+  Report("Single acceptor", kClientThreadCount * kConnectionsPerThread,
+         ConnectionStorm(1, kClientThreadCount, kConnectionsPerThread), "accepts");
+  Report(std::to_string(thread_count_) + " SO_REUSEPORT acceptors",
+         kClientThreadCount * kConnectionsPerThread,
+         ConnectionStorm(thread_count_, kClientThreadCount, kConnectionsPerThread), "accepts");
+}
+
+void TcpBenchmark::CompareTransports() {
+#ifdef MAIDSAFE_WIN32
+  TLOG(kYellow) << "\nUnix domain sockets aren't supported on this platform.\n";
+#else
+  const std::size_t kEchoMessageSize(64), kRoundTrips(20000);
+  TLOG(kGreen) << "\nEcho of " << kEchoMessageSize << " byte messages over 1 connection\n";
+  for (const auto& transport : {Transport::kTcp, Transport::kLocal}) {
+    AsioService asio_service(1);
+    const auto duration(
+        Echo(asio_service, 1, kEchoMessageSize, kRoundTrips, false, transport));
+    Report(transport == Transport::kTcp ? "Loopback TCP" : "Unix domain socket", kRoundTrips,
+           duration);
+    TLOG(kGreen) << "Mean round trip latency: "
+                 << std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count() /
+                        kRoundTrips << " ns\n";
+  }
+
+  for (const auto& message_size : {std::size_t(64), std::size_t(1024 * 1024)}) {
+    const std::size_t message_count(message_size == 64 ? 200000 : 2000);
+    TLOG(kGreen) << "\nStream of " << message_count << " x " << message_size
+                 << " byte messages\n";
+    for (const auto& transport : {Transport::kTcp, Transport::kLocal}) {
+      AsioService asio_service(thread_count_);
+      const auto duration(Stream(asio_service, message_size, message_count,
+                                 tcp::Connection::kDefaultMaxCoalescedMessages, nullptr,
+                                 transport));
+      const std::string name(transport == Transport::kTcp ? "Loopback TCP" : "Unix domain socket");
+      Report(name, message_count, duration, "messages");
+      const double seconds(std::chrono::duration<double>(duration).count());
+      TLOG(kGreen) << name << ": "
+                   << static_cast<std::uint64_t>(message_size * message_count / seconds /
+                                                 (1024 * 1024)) << " MiB/s\n";
+    }
+  }
+#endif
+}
+
+void TcpBenchmark::MeasureRpcPipelining() {
+  const std::size_t kMessageSize(64), kRequestCount(100000);
+  TLOG(kGreen) << "\n" << kRequestCount << " RPCs of " << kMessageSize
+               << " bytes over 1 connection with " << thread_count_ << " threads\n";
+  for (const auto& in_flight : {std::size_t(1), std::size_t(16), std::size_t(256)}) {
+    AsioService asio_service(thread_count_);
+    Report(std::to_string(in_flight) + " in flight", kRequestCount,
+           RpcRoundTrips(asio_service, in_flight, kMessageSize, kRequestCount), "requests");
+  }
+}
+
+std::chrono::steady_clock::duration TcpBenchmark::ConnectionStorm(
+    std::size_t acceptor_count, std::size_t client_thread_count,
+    std::size_t connections_per_thread) {
+  AsioService asio_service(thread_count_, IoServiceMode::kServicePerThread);
+  std::vector<std::unique_ptr<asio::io_service::strand>> strands;
+  tcp::Listener::AcceptorStrands acceptor_strands;
+  for (std::size_t i(0); i != acceptor_count; ++i) {
+    strands.emplace_back(
+        maidsafe::make_unique<asio::io_service::strand>(asio_service.NextService()));
+    acceptor_strands.emplace_back(*strands.back());
+  }
+  const std::size_t total(client_thread_count * connections_per_thread);
+  std::atomic<std::size_t> accepted_count(0);
+  std::promise<void> all_accepted;
+  tcp::ListenerPtr listener{tcp::Listener::MakeShared(acceptor_strands,
+                                                      [&](tcp::ConnectionPtr) {
+                                                        if (++accepted_count == total)
+                                                          all_accepted.set_value();
+                                                      },
+                                                      tcp::Port{7777})};
+  const tcp::Port port(listener->ListeningPort());
+
+  const auto start(std::chrono::steady_clock::now());
+  std::vector<std::thread> clients;
+  for (std::size_t i(0); i != client_thread_count; ++i) {
+    clients.emplace_back([&] {
+      asio::io_service io_service;
+      for (std::size_t j(0); j != connections_per_thread; ++j) {
+        asio::ip::tcp::socket socket(io_service);
+        std::error_code ec;
+        socket.connect(asio::ip::tcp::endpoint(asio::ip::address_v6::loopback(), port), ec);
+        if (ec)
+          socket.connect(asio::ip::tcp::endpoint(asio::ip::address_v4::loopback(), port), ec);
+        // Reset rather than close gracefully, so the client ports don't linger in TIME_WAIT.
+        socket.set_option(asio::socket_base::linger(true, 0), ec);
+      }
+    });
+  }
+  for (auto& client : clients)
+    client.join();
+  all_accepted.get_future().wait();
+  const auto duration(std::chrono::steady_clock::now() - start);
+
+  listener->StopListening();
+  asio_service.Stop();
+  return duration;
+}
+
+std::chrono::steady_clock::duration TcpBenchmark::Stream(AsioService& asio_service,
+                                                         std::size_t message_size,
+                                                         std::size_t message_count,
+                                                         std::size_t max_coalesced_messages,
+                                                         std::uint64_t* server_read_operations,
+                                                         Transport transport) {
+  asio::io_service::strand client_strand(asio_service.service()),
+      server_strand(asio_service.service());
+  std::size_t received_count(0);
+  std::promise<void> all_received;
+  std::promise<tcp::ConnectionPtr> accepted;
+  auto on_new_connection([&](tcp::ConnectionPtr connection) { accepted.set_value(connection); });
+  tcp::ListenerPtr listener;
+  tcp::ConnectionPtr client;
+#ifndef MAIDSAFE_WIN32
+  const boost::filesystem::path socket_path(UniqueSocketPath());
+  if (transport == Transport::kLocal) {
+    listener = tcp::Listener::MakeShared(server_strand, on_new_connection, socket_path);
+    client = tcp::Connection::MakeShared(client_strand, socket_path);
+  }
+#endif
+  if (!listener) {
+    listener = tcp::Listener::MakeShared(server_strand, on_new_connection, tcp::Port{7777});
+    client = tcp::Connection::MakeShared(client_strand, listener->ListeningPort());
+  }
+  tcp::ConnectionPtr server_connection(accepted.get_future().get());
+  // The handler is invoked on the connection's strand, so 'received_count' needs no lock.
+  server_connection->Start([&](tcp::Message) {
+                             if (++received_count == message_count)
+                               all_received.set_value();
+                           },
+                           [] {});
+  client->Start([](tcp::Message) {}, [] {});
+  client->SetWriteCoalescingLimits(max_coalesced_messages,
+                                   tcp::Connection::kDefaultMaxCoalescedBytes);
+
+  const tcp::Message message(message_size, 'A');
+  const auto start(std::chrono::steady_clock::now());
+  for (std::size_t i(0); i != message_count; ++i)
+    client->Send(message);
+  all_received.get_future().wait();
+  const auto duration(std::chrono::steady_clock::now() - start);
+  if (server_read_operations)
+    *server_read_operations = server_connection->ReadOperationCount();
+
+  client->Close();
+  server_connection->Close();
+  listener->StopListening();
+  asio_service.Stop();
+  return duration;
+}
+
+std::chrono::steady_clock::duration TcpBenchmark::Echo(AsioService& asio_service,
+                                                       std::size_t connection_count,
+                                                       std::size_t message_size,
+                                                       std::size_t round_trips,
+                                                       bool use_coroutines,
+                                                       Transport transport,
+                                                       std::uint64_t* allocations) {
+  std::vector<std::unique_ptr<asio::io_service::strand>> strands;
+  for (std::size_t i(0); i != asio_service.ServiceCount(); ++i)
+    strands.emplace_back(maidsafe::make_unique<asio::io_service::strand>(asio_service.service(i)));
+  std::atomic<std::size_t> next_strand(0);
+  auto pick_strand([&]() -> asio::io_service::strand& {
+    return *strands[next_strand++ % strands.size()];
+  });
+
+  std::mutex mutex;
+  std::vector<tcp::ConnectionPtr> server_connections;
+  std::promise<void> all_accepted;
+  auto on_new_connection([&](tcp::ConnectionPtr connection) {
+    std::weak_ptr<tcp::Connection> weak_connection(connection);
+    connection->Start([weak_connection](tcp::Message message) {
+                        if (tcp::ConnectionPtr echoer = weak_connection.lock())
+                          echoer->Send(std::move(message));
+                      },
+                      [] {});
+    std::lock_guard<std::mutex> lock(mutex);
+    server_connections.push_back(connection);
+    if (server_connections.size() == connection_count)
+      all_accepted.set_value();
+  });
+  tcp::ListenerPtr listener;
+#ifndef MAIDSAFE_WIN32
+  const boost::filesystem::path socket_path(UniqueSocketPath());
+  if (transport == Transport::kLocal)
+    listener = tcp::Listener::MakeShared(*strands.front(), on_new_connection, socket_path);
+#endif
+  if (!listener) {
+    listener = tcp::Listener::MakeShared(*strands.front(), on_new_connection, tcp::Port{7777},
+                                         pick_strand);
+  }
+
+  const tcp::Message message(message_size, 'A');
+  std::atomic<std::size_t> remaining_clients(connection_count);
+  std::promise<void> all_done;
+  std::vector<tcp::ConnectionPtr> clients;
+  std::vector<std::unique_ptr<std::atomic<std::size_t>>> round_trips_done;
+  for (std::size_t i(0); i != connection_count; ++i) {
+#ifndef MAIDSAFE_WIN32
+    if (transport == Transport::kLocal)
+      clients.emplace_back(tcp::Connection::MakeShared(pick_strand(), socket_path));
+#endif
+    if (clients.size() == i)
+      clients.emplace_back(tcp::Connection::MakeShared(pick_strand(), listener->ListeningPort()));
+    if (use_coroutines)
+      continue;
+    round_trips_done.emplace_back(maidsafe::make_unique<std::atomic<std::size_t>>(0));
+    std::weak_ptr<tcp::Connection> weak_client(clients.back());
+    std::atomic<std::size_t>& done_count(*round_trips_done.back());
+    clients.back()->Start([&, weak_client](tcp::Message received) {
+                            if (++done_count == round_trips) {
+                              if (--remaining_clients == 0)
+                                all_done.set_value();
+                            } else if (tcp::ConnectionPtr client = weak_client.lock()) {
+                              client->Send(std::move(received));
+                            }
+                          },
+                          [] {});
+  }
+  all_accepted.get_future().wait();
+
+  const std::uint64_t allocations_before(allocation_counter ? allocation_counter->load() : 0);
+  const auto start(std::chrono::steady_clock::now());
+  for (auto& client : clients) {
+    if (use_coroutines) {
+      asio_service.Spawn(EchoClient(client, message_size, round_trips, [&] {
+        if (--remaining_clients == 0)
+          all_done.set_value();
+      }));
+    } else {
+      client->Send(message);
+    }
+  }
+  all_done.get_future().wait();
+  const auto duration(std::chrono::steady_clock::now() - start);
+  if (allocations && allocation_counter)
+    *allocations = allocation_counter->load() - allocations_before;
+
+  for (auto& client : clients)
+    client->Close();
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (auto& server_connection : server_connections)
+      server_connection->Close();
+  }
+  listener->StopListening();
+  asio_service.Stop();
+  return duration;
+}
+
+std::chrono::steady_clock::duration TcpBenchmark::RpcRoundTrips(AsioService& asio_service,
+                                                                std::size_t in_flight,
+                                                                std::size_t message_size,
+                                                                std::size_t request_count) {
+  asio::io_service::strand client_strand(asio_service.service()),
+      server_strand(asio_service.service());
+  std::shared_ptr<TimerWheel> timer_wheel{TimerWheel::MakeShared(asio_service)};
+  std::promise<tcp::RpcChannelPtr> accepted;
+  tcp::ListenerPtr listener{tcp::Listener::MakeShared(
+      server_strand,
+      [&](tcp::ConnectionPtr connection) {
+        accepted.set_value(tcp::RpcChannel::MakeShared(
+            connection, timer_wheel,
+            [](tcp::Message request, tcp::RpcChannel::Responder respond) {
+              respond(std::move(request));
+            },
+            [] {}));
+      },
+      tcp::Port{7777})};
+  tcp::RpcChannelPtr client{tcp::RpcChannel::MakeShared(
+      tcp::Connection::MakeShared(client_strand, listener->ListeningPort()), timer_wheel, nullptr,
+      [] {})};
+  tcp::RpcChannelPtr server{accepted.get_future().get()};
+
+  // Each response issues the next request, keeping 'in_flight' outstanding.
+  std::atomic<std::size_t> issued(0), answered(0);
+  std::promise<void> all_answered;
+  std::function<void(std::error_code, tcp::Message)> on_response;
+  on_response = [&](std::error_code ec, tcp::Message response) {
+    if (ec)
+      LOG(kError) << "RPC failed: " << ec.message();
+    if (++answered == request_count)
+      return all_answered.set_value();
+    if (issued++ < request_count)
+      client->Call(std::move(response), std::chrono::seconds(10), on_response);
+  };
+
+  const tcp::Message message(message_size, 'A');
+  const auto start(std::chrono::steady_clock::now());
+  for (std::size_t i(0); i != in_flight && issued++ < request_count; ++i)
+    client->Call(message, std::chrono::seconds(10), on_response);
+  all_answered.get_future().wait();
+  const auto duration(std::chrono::steady_clock::now() - start);
+
+  client->Close();
+  server->Close();
+  listener->StopListening();
+  timer_wheel->CancelAll();
+  asio_service.Stop();
+  return duration;
+}
+
+void TcpBenchmark::Report(const std::string& name, std::size_t message_count,
+                          std::chrono::steady_clock::duration duration,
+                          const std::string& unit) const {
+  const double seconds(std::chrono::duration<double>(duration).count());
+  TLOG(kGreen) << name << ": " << static_cast<std::uint64_t>(message_count / seconds) << ' '
+               << unit << "/s\n";
+}
+
+}  // namespace benchmark
+
+}  // namespace maidsafe
@@ -0,0 +1,133 @@
+/*  Copyright 2015 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#include "maidsafe/common/tools/thread_pool_benchmark.h"
+
+#include <algorithm>
+#include <atomic>
+#include <future>
+#include <thread>
+
+#include "maidsafe/common/asio_service.h"
+#include "maidsafe/common/log.h"
+#include "maidsafe/common/thread_pool.h"
+
+namespace maidsafe {
+
+namespace benchmark {
+
+namespace {
+
+const std::size_t kTaskCount(1000000);
+const unsigned kWorkIterations(64);
+
+// Roughly the cost of hashing a small buffer.
+std::uint64_t Work(std::uint64_t value) {
+  for (unsigned i(0); i != kWorkIterations; ++i) {
+    value ^= value << 13;
+    value ^= value >> 7;
+    value ^= value << 17;
+  }
+  return value;
+}
+
+std::vector<std::size_t> ThreadCounts() {
+  std::vector<std::size_t> thread_counts;
+  const std::size_t max_threads(std::max(2U, std::thread::hardware_concurrency()));
+  for (std::size_t count(1); count < max_threads; count *= 2)
+    thread_counts.push_back(count);
+  thread_counts.push_back(max_threads);
+  return thread_counts;
+}
+
+}  // unnamed namespace
+
+ThreadPoolBenchmark::ThreadPoolBenchmark() : results_(kTaskCount, 0) {}
+
+void ThreadPoolBenchmark::Run() {
+  TLOG(kGreen) << "\nRunning " << kTaskCount << " tasks of " << kWorkIterations
+               << " iterations each\n";
+  std::chrono::steady_clock::duration asio_base{}, pool_base{}, parallel_for_base{};
+  for (std::size_t thread_count : ThreadCounts()) {
+    const auto asio_duration(AsioServicePost(thread_count));
+    const auto pool_duration(ThreadPoolPost(thread_count));
+    const auto parallel_for_duration(ThreadPoolParallelFor(thread_count));
+    if (thread_count == 1) {
+      asio_base = asio_duration;
+      pool_base = pool_duration;
+      parallel_for_base = parallel_for_duration;
+    }
+    Report("AsioService post", thread_count, asio_duration, asio_base);
+    Report("ThreadPool Post", thread_count, pool_duration, pool_base);
+    Report("ThreadPool ParallelFor", thread_count, parallel_for_duration, parallel_for_base);
+  }
+}
+
+std::chrono::steady_clock::duration ThreadPoolBenchmark::AsioServicePost(
+    std::size_t thread_count) {
+  AsioService asio_service(thread_count);
+  std::atomic<std::size_t> remaining(kTaskCount);
+  std::promise<void> done;
+  const auto start(std::chrono::steady_clock::now());
+  for (std::size_t i(0); i != kTaskCount; ++i) {
+    asio_service.service().post([&, i] {
+      results_[i] = Work(i);
+      if (--remaining == 0)
+        done.set_value();
+    });
+  }
+  done.get_future().wait();
+  return std::chrono::steady_clock::now() - start;
+}
+
+std::chrono::steady_clock::duration ThreadPoolBenchmark::ThreadPoolPost(std::size_t thread_count) {
+  ThreadPool thread_pool(thread_count);
+  std::atomic<std::size_t> remaining(kTaskCount);
+  std::promise<void> done;
+  const auto start(std::chrono::steady_clock::now());
+  for (std::size_t i(0); i != kTaskCount; ++i) {
+    thread_pool.Post([&, i] {
+      results_[i] = Work(i);
+      if (--remaining == 0)
+        done.set_value();
+    });
+  }
+  done.get_future().wait();
+  return std::chrono::steady_clock::now() - start;
+}
+
+std::chrono::steady_clock::duration ThreadPoolBenchmark::ThreadPoolParallelFor(
+    std::size_t thread_count) {
+  ThreadPool thread_pool(thread_count);
+  const auto start(std::chrono::steady_clock::now());
+  thread_pool.ParallelFor(0, kTaskCount, [&](std::size_t i) { results_[i] = Work(i); });
+  return std::chrono::steady_clock::now() - start;
+}
+
+void ThreadPoolBenchmark::Report(const std::string& name, std::size_t thread_count,
+                                 std::chrono::steady_clock::duration duration,
+                                 std::chrono::steady_clock::duration single_thread_duration) const {
+  const double seconds(std::chrono::duration<double>(duration).count());
+  TLOG(kGreen) << name << " with " << thread_count << " thread(s): "
+               << static_cast<std::uint64_t>(kTaskCount / seconds) << " tasks/s, speed-up x"
+               << std::chrono::duration<double>(single_thread_duration).count() / seconds << '\n';
+}
+
+}  // namespace benchmark
+
+}  // namespace maidsafe
@@ -0,0 +1,150 @@
+/*  Copyright 2015 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#include "maidsafe/common/tools/timer_wheel_benchmark.h"
+
+#include <algorithm>
+#include <atomic>
+#include <future>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "asio/steady_timer.hpp"
+
+#include "maidsafe/common/asio_service.h"
+#include "maidsafe/common/log.h"
+#include "maidsafe/common/timer_wheel.h"
+
+namespace maidsafe {
+
+namespace benchmark {
+
+namespace {
+
+// Long enough that no timeout expires before it is cancelled.
+const std::chrono::seconds kCancelledTimeout(60);
+const std::chrono::milliseconds kExpiringTimeout(20);
+const std::chrono::milliseconds kTick(10);
+
+// Counts down and signals when all timeouts have been handled.
+class Countdown {
+ public:
+  explicit Countdown(std::size_t count) : remaining_(count), done_() {}
+  void Decrement() {
+    if (--remaining_ == 0)
+      done_.set_value();
+  }
+  void Wait() { done_.get_future().wait(); }
+
+ private:
+  std::atomic<std::size_t> remaining_;
+  std::promise<void> done_;
+};
+
+}  // unnamed namespace
+
+TimerWheelBenchmark::TimerWheelBenchmark()
+    : timer_count_(1000000), thread_count_(std::max(2U, std::thread::hardware_concurrency())) {}
+
+void TimerWheelBenchmark::Run() {
+  TLOG(kGreen) << "\nScheduling and cancelling " << timer_count_ << " timeouts using "
+               << thread_count_ << " threads\n";
+  Report("asio::steady_timer", AsioTimersScheduleAndCancel());
+  Report("TimerWheel", TimerWheelScheduleAndCancel());
+  TLOG(kGreen) << "\nScheduling " << timer_count_ << " timeouts of " << kExpiringTimeout.count()
+               << " ms and waiting for them to expire\n";
+  Report("asio::steady_timer", AsioTimersExpire());
+  Report("TimerWheel", TimerWheelExpire(false));
+  Report("TimerWheel (batched expirations)", TimerWheelExpire(true));
+}
+
+std::chrono::steady_clock::duration TimerWheelBenchmark::AsioTimersScheduleAndCancel() {
+  AsioService asio_service(thread_count_);
+  Countdown countdown(timer_count_);
+  std::vector<std::unique_ptr<asio::steady_timer>> timers;
+  timers.reserve(timer_count_);
+  const auto start(std::chrono::steady_clock::now());
+  for (std::size_t i(0); i != timer_count_; ++i) {
+    timers.emplace_back(new asio::steady_timer(asio_service.service()));
+    timers.back()->expires_from_now(kCancelledTimeout);
+    timers.back()->async_wait([&](const std::error_code&) { countdown.Decrement(); });
+  }
+  for (auto& timer : timers)
+    timer->cancel();
+  // As for TimerWheelScheduleAndCancel, only the scheduling and cancelling calls are timed; the
+  // aborted handlers are run afterwards.
+  const auto duration(std::chrono::steady_clock::now() - start);
+  countdown.Wait();
+  return duration;
+}
+
+std::chrono::steady_clock::duration TimerWheelBenchmark::TimerWheelScheduleAndCancel() {
+  AsioService asio_service(thread_count_);
+  auto timer_wheel(TimerWheel::MakeShared(asio_service, kTick));
+  std::vector<TimerWheel::TimerId> timer_ids;
+  timer_ids.reserve(timer_count_);
+  std::atomic<std::size_t> fired_count(0);
+  const auto start(std::chrono::steady_clock::now());
+  for (std::size_t i(0); i != timer_count_; ++i)
+    timer_ids.push_back(timer_wheel->Schedule(kCancelledTimeout, [&] { ++fired_count; }));
+  for (auto timer_id : timer_ids)
+    timer_wheel->Cancel(timer_id);
+  const auto duration(std::chrono::steady_clock::now() - start);
+  if (fired_count != 0)
+    LOG(kError) << fired_count << " cancelled timeouts fired.";
+  return duration;
+}
+
+std::chrono::steady_clock::duration TimerWheelBenchmark::AsioTimersExpire() {
+  AsioService asio_service(thread_count_);
+  Countdown countdown(timer_count_);
+  std::vector<std::unique_ptr<asio::steady_timer>> timers;
+  timers.reserve(timer_count_);
+  const auto start(std::chrono::steady_clock::now());
+  for (std::size_t i(0); i != timer_count_; ++i) {
+    timers.emplace_back(new asio::steady_timer(asio_service.service()));
+    timers.back()->expires_from_now(kExpiringTimeout);
+    timers.back()->async_wait([&](const std::error_code&) { countdown.Decrement(); });
+  }
+  countdown.Wait();
+  return std::chrono::steady_clock::now() - start;
+}
+
+std::chrono::steady_clock::duration TimerWheelBenchmark::TimerWheelExpire(bool batch_expirations) {
+  AsioService asio_service(thread_count_);
+  auto timer_wheel(TimerWheel::MakeShared(asio_service, kTick, batch_expirations));
+  Countdown countdown(timer_count_);
+  const auto start(std::chrono::steady_clock::now());
+  for (std::size_t i(0); i != timer_count_; ++i)
+    timer_wheel->Schedule(kExpiringTimeout, [&] { countdown.Decrement(); });
+  countdown.Wait();
+  return std::chrono::steady_clock::now() - start;
+}
+
+void TimerWheelBenchmark::Report(const std::string& name,
+                                 std::chrono::steady_clock::duration duration) const {
+  const double seconds(std::chrono::duration<double>(duration).count());
+  TLOG(kGreen) << name << ": "
+               << std::chrono::duration_cast<std::chrono::milliseconds>(duration).count() << " ms, "
+               << static_cast<std::uint64_t>(timer_count_ / seconds) << " timeouts/s\n";
+}
+
+}  // namespace benchmark
+
+}  // namespace maidsafe